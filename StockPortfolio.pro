@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT += core gui network charts printsupport
+QT += core gui network charts printsupport concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -43,15 +43,31 @@ CONFIG += c++17
 
 
 SOURCES += \
+        aggregation.cpp \
         calculation.cpp \
+        calendargrid.cpp \
         callout.cpp \
+        correlationheatmap.cpp \
+        costbasis.cpp \
+        covariance.cpp \
         customcsvimportform.cpp \
         database.cpp \
         degiro.cpp \
         downloadmanager.cpp \
         filterform.cpp \
+        fxservice.cpp \
+        htmlscanner.cpp \
+        httpcache.cpp \
         main.cpp \
         mainwindow.cpp \
+        navseries.cpp \
+        networkfixture.cpp \
+        pagetemplate.cpp \
+        portfoliostate.cpp \
+        prefetchscheduler.cpp \
+        refreshengine.cpp \
+        returns.cpp \
+        riskmetrics.cpp \
         screener.cpp \
         screenerform.cpp \
         screenertab.cpp \
@@ -60,15 +76,31 @@ SOURCES += \
         tastyworks.cpp
 
 HEADERS += \
+        aggregation.h \
         calculation.h \
+        calendargrid.h \
         callout.h \
+        correlationheatmap.h \
+        costbasis.h \
+        covariance.h \
         customcsvimportform.h \
         database.h \
         degiro.h \
         downloadmanager.h \
         filterform.h \
+        fxservice.h \
+        htmlscanner.h \
+        httpcache.h \
         global.h \
         mainwindow.h \
+        navseries.h \
+        networkfixture.h \
+        pagetemplate.h \
+        portfoliostate.h \
+        prefetchscheduler.h \
+        refreshengine.h \
+        returns.h \
+        riskmetrics.h \
         screener.h \
         screenerform.h \
         screenertab.h \
@@ -0,0 +1,242 @@
+#include "aggregation.h"
+
+#include <QDebug>
+
+AggregationCube::AggregationCube() : bucket(NOBUCKET), groupCount(0), bucketCount(0)
+{
+
+}
+
+AggregationCube::AggregationCube(const QVector<eGROUPDIMENSION> &dimensions, const QVector<QStringList> &dictionaries,
+                                 const eTIMEBUCKET &bucket, const QDate &firstBucket, const int &bucketCount) :
+    dimensions(dimensions), dictionaries(dictionaries), bucket(bucket), firstBucket(firstBucket), groupCount(1), bucketCount(bucketCount)
+{
+    // The last dimension changes the fastest
+    strides = QVector<int>(dimensions.count(), 1);
+
+    for(int dimension = dimensions.count() - 1; dimension >= 0; --dimension)
+    {
+        strides[dimension] = groupCount;
+        groupCount *= dictionaries.at(dimension).count();
+    }
+
+    cells = QVector<double>(groupCount*bucketCount*MEASURECOUNT, 0.0);
+}
+
+int AggregationCube::getGroup(const QVector<int> &codes) const
+{
+    int group = 0;
+
+    for(int dimension = 0; dimension < strides.count(); ++dimension)
+    {
+        group += codes.at(dimension)*strides.at(dimension);
+    }
+
+    return group;
+}
+
+int AggregationCube::getCode(const int &group, const int &dimension) const
+{
+    return (group/strides.at(dimension)) % dictionaries.at(dimension).count();
+}
+
+QString AggregationCube::getGroupLabel(const int &group, const QString &separator) const
+{
+    QStringList labels;
+
+    for(int dimension = 0; dimension < dimensions.count(); ++dimension)
+    {
+        labels << dictionaries.at(dimension).at(getCode(group, dimension));
+    }
+
+    return labels.join(separator);
+}
+
+QDate AggregationCube::getBucketDate(const int &index) const
+{
+    switch(bucket)
+    {
+        case MONTHBUCKET: return firstBucket.addMonths(index);
+        case YEARBUCKET: return firstBucket.addYears(index);
+        case NOBUCKET: break;
+    }
+
+    return firstBucket;
+}
+
+int AggregationCube::getBucketIndex(const QDate &date) const
+{
+    int index = 0;
+
+    switch(bucket)
+    {
+        case MONTHBUCKET: index = (date.year() - firstBucket.year())*12 + date.month() - firstBucket.month(); break;
+        case YEARBUCKET: index = date.year() - firstBucket.year(); break;
+        case NOBUCKET: break;
+    }
+
+    return (index >= 0 && index < bucketCount) ? index : -1;
+}
+
+QVector<double> AggregationCube::getGroupTotals(const eMEASURE &measure) const
+{
+    QVector<double> totals(groupCount, 0.0);
+
+    for(int group = 0; group < groupCount; ++group)
+    {
+        for(int index = 0; index < bucketCount; ++index)
+        {
+            totals[group] += getValue(group, index, measure);
+        }
+    }
+
+    return totals;
+}
+
+QVector<double> AggregationCube::getBucketTotals(const eMEASURE &measure) const
+{
+    QVector<double> totals(bucketCount, 0.0);
+
+    for(int group = 0; group < groupCount; ++group)
+    {
+        for(int index = 0; index < bucketCount; ++index)
+        {
+            totals[index] += getValue(group, index, measure);
+        }
+    }
+
+    return totals;
+}
+
+Aggregation::Aggregation(QObject *parent) : QObject(parent)
+{
+
+}
+
+bool Aggregation::getCached(const QString &key, const sAGGREGATIONSOURCE &source, AggregationCube *cube)
+{
+    QMutexLocker locker(&mutex);
+
+    auto it = cache.constFind(key);
+
+    if(it != cache.cend() && it->source.generation == source.generation && it->source.version == source.version && it->source.fingerprint == source.fingerprint)
+    {
+        cacheOrder.removeOne(key);
+        cacheOrder.push_back(key);
+
+        *cube = it->cube;
+        return true;
+    }
+
+    return false;
+}
+
+void Aggregation::setCached(const QString &key, const sAGGREGATIONSOURCE &source, const AggregationCube &cube)
+{
+    QMutexLocker locker(&mutex);
+
+    sCACHEDCUBE cached;
+    cached.source = source;
+    cached.cube = cube;
+
+    if(!cache.contains(key) && cacheOrder.count() >= CACHEDCUBES)
+    {
+        cache.remove(cacheOrder.takeFirst());
+    }
+
+    cacheOrder.removeOne(key);
+    cacheOrder.push_back(key);
+
+    cache.insert(key, cached);
+}
+
+AggregationCube Aggregation::build(const QVector<sSECURITYATTRIBUTES> &securities, const QVector<sAGGREGATIONFACT> &facts,
+                                   const QVector<eGROUPDIMENSION> &dimensions, const eTIMEBUCKET &bucket, const QDate &from, const QDate &to)
+{
+    const int dimensionCount = dimensions.count();
+
+    // Dictionary codes of the grouped attributes, in the order of the first occurrence
+    QVector<QStringList> dictionaries(dimensionCount);
+    QVector<QHash<QString, int>> codeMaps(dimensionCount);
+    QVector<int> codes(securities.count()*dimensionCount);
+
+    for(int security = 0; security < securities.count(); ++security)
+    {
+        for(int dimension = 0; dimension < dimensionCount; ++dimension)
+        {
+            QString value = securities.at(security).values[dimensions.at(dimension)];
+
+            if(value.isEmpty())
+            {
+                value = "Unknown";
+            }
+
+            auto it = codeMaps[dimension].constFind(value);
+
+            if(it == codeMaps[dimension].cend())
+            {
+                it = codeMaps[dimension].insert(value, dictionaries.at(dimension).count());
+                dictionaries[dimension] << value;
+            }
+
+            codes[security*dimensionCount + dimension] = it.value();
+        }
+    }
+
+    QDate firstBucket = from;
+    int bucketCount = 1;
+
+    switch(bucket)
+    {
+        case MONTHBUCKET:
+        {
+            firstBucket = QDate(from.year(), from.month(), 1);
+            bucketCount = (to.year() - from.year())*12 + to.month() - from.month() + 1;
+        }
+        break;
+
+        case YEARBUCKET:
+        {
+            firstBucket = QDate(from.year(), 1, 1);
+            bucketCount = to.year() - from.year() + 1;
+        }
+        break;
+
+        case NOBUCKET:
+        break;
+    }
+
+    qint64 cellCount = bucketCount*MEASURECOUNT;
+
+    for(const QStringList &dictionary : qAsConst(dictionaries))
+    {
+        cellCount *= dictionary.count();
+    }
+
+    if(bucketCount <= 0 || cellCount > 16*1024*1024)
+    {
+        qWarning() << "Aggregation cube is too large";
+        return AggregationCube();
+    }
+
+    AggregationCube cube(dimensions, dictionaries, bucket, firstBucket, bucketCount);
+
+    // Group of each security is resolved once, the facts are only summed
+    QVector<int> groups(securities.count());
+
+    for(int security = 0; security < securities.count(); ++security)
+    {
+        groups[security] = cube.getGroup(codes.mid(security*dimensionCount, dimensionCount));
+    }
+
+    for(const sAGGREGATIONFACT &fact : facts)
+    {
+        const int index = cube.getBucketIndex(fact.date);
+
+        if(index < 0) continue;
+
+        cube.add(groups.at(fact.security), index, fact.measure, fact.value);
+    }
+
+    return cube;
+}
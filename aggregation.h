@@ -0,0 +1,140 @@
+#ifndef AGGREGATION_H
+#define AGGREGATION_H
+
+#include <QObject>
+#include <QDate>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+
+#include "global.h"
+
+/**
+ * @brief The AggregationCube class - measures grouped by the security attributes and the time buckets
+ * The group is the combination of the dictionary codes of the grouped dimensions, all combinations are stored
+ * in one contiguous array (group, then bucket, then measure), so a pie, a bar chart or a pivot table
+ * is only a read of the array.
+ */
+class AggregationCube
+{
+public:
+    AggregationCube();
+    AggregationCube(const QVector<eGROUPDIMENSION> &dimensions, const QVector<QStringList> &dictionaries,
+                    const eTIMEBUCKET &bucket, const QDate &firstBucket, const int &bucketCount);
+
+    inline void add(const int &group, const int &bucket, const eMEASURE &measure, const double &value)
+    {
+        cells[(group*bucketCount + bucket)*MEASURECOUNT + measure] += value;
+    }
+
+    bool isEmpty() const { return cells.isEmpty(); }
+
+    int getGroupCount() const { return groupCount; }
+    int getBucketCount() const { return bucketCount; }
+    eTIMEBUCKET getBucket() const { return bucket; }
+    QVector<eGROUPDIMENSION> getDimensions() const { return dimensions; }
+
+    /**
+     * @brief getDictionary - labels of the codes of the n-th grouped dimension
+     */
+    QStringList getDictionary(const int &dimension) const { return dictionaries.at(dimension); }
+
+    /**
+     * @brief getGroup - group of the codes, one code per grouped dimension
+     */
+    int getGroup(const QVector<int> &codes) const;
+
+    /**
+     * @brief getCode - code of the n-th grouped dimension within the group
+     */
+    int getCode(const int &group, const int &dimension) const;
+
+    /**
+     * @brief getGroupLabel - labels of the group codes joined by the separator
+     */
+    QString getGroupLabel(const int &group, const QString &separator = " / ") const;
+
+    /**
+     * @brief getBucketDate - first day of the bucket
+     */
+    QDate getBucketDate(const int &bucket) const;
+
+    /**
+     * @brief getBucketIndex - bucket of the date, -1 if the date is out of the cube
+     */
+    int getBucketIndex(const QDate &date) const;
+
+    double getValue(const int &group, const int &bucket, const eMEASURE &measure) const
+    {
+        return cells.at((group*bucketCount + bucket)*MEASURECOUNT + measure);
+    }
+
+    /**
+     * @brief getGroupTotals - measure of each group summed over all buckets
+     */
+    QVector<double> getGroupTotals(const eMEASURE &measure) const;
+
+    /**
+     * @brief getBucketTotals - measure of each bucket summed over all groups
+     */
+    QVector<double> getBucketTotals(const eMEASURE &measure) const;
+
+private:
+    QVector<eGROUPDIMENSION> dimensions;
+    QVector<QStringList> dictionaries;      // per grouped dimension, code -> label
+    QVector<int> strides;                   // per grouped dimension, mixed radix of the group
+    eTIMEBUCKET bucket;
+    QDate firstBucket;
+    int groupCount;
+    int bucketCount;
+    QVector<double> cells;                  // group, then bucket, then measure
+};
+
+/**
+ * @brief The sAGGREGATIONSOURCE struct - identity of the data the cube was built from
+ */
+struct sAGGREGATIONSOURCE
+{
+    quint64 generation;             // StockData publish generation of the transactions
+    quint64 version;                // sCALCULATIONCONTEXT version
+    uint fingerprint;               // security attributes and prices
+};
+
+class Aggregation : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Aggregation(QObject *parent = nullptr);
+
+    /**
+     * @brief getCached - cube of the key if it was built from the same source
+     */
+    bool getCached(const QString &key, const sAGGREGATIONSOURCE &source, AggregationCube *cube);
+    void setCached(const QString &key, const sAGGREGATIONSOURCE &source, const AggregationCube &cube);
+
+    /**
+     * @brief build - dictionary encode the grouped attributes of the securities and sum the facts in one pass
+     * @return empty cube if the cube would be too large
+     */
+    static AggregationCube build(const QVector<sSECURITYATTRIBUTES> &securities, const QVector<sAGGREGATIONFACT> &facts,
+                                 const QVector<eGROUPDIMENSION> &dimensions, const eTIMEBUCKET &bucket, const QDate &from, const QDate &to);
+
+private:
+    enum
+    {
+        CACHEDCUBES = 16            // cubes kept for the recently used keys
+    };
+
+    struct sCACHEDCUBE
+    {
+        sAGGREGATIONSOURCE source;
+        AggregationCube cube;
+    };
+
+    QHash<QString, sCACHEDCUBE> cache;
+    QStringList cacheOrder;         // keys, the least recently used first
+    QMutex mutex;
+};
+
+#endif // AGGREGATION_H
@@ -0,0 +1,34 @@
+#include "allocations.h"
+
+#include <atomic>
+#include <cstdlib>
+
+namespace
+{
+    std::atomic<quint64> allocations(0);
+}
+
+#if defined(__GLIBC__)
+// The malloc of the executable takes precedence over the one of the libc, also for the calls from the Qt libraries
+extern "C" void *__libc_malloc(size_t size);
+
+extern "C" void *malloc(size_t size) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+#endif
+
+quint64 getAllocations()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+bool isAllocationCounted()
+{
+#if defined(__GLIBC__)
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,14 @@
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+#include <QtGlobal>
+
+/**
+ * @brief getAllocations - malloc calls of the process so far, operator new and the Qt containers included
+ * The calls are counted on glibc only, see isAllocationCounted
+ */
+quint64 getAllocations();
+
+bool isAllocationCounted();
+
+#endif // ALLOCATIONS_H
@@ -0,0 +1,71 @@
+#-------------------------------------------------
+#
+# Benchmarks of the calculation, the parsers and the refresh
+# Run "spmbench --help" for the list of the benchmarks
+#
+#-------------------------------------------------
+
+QT += core gui widgets charts concurrent network
+
+TARGET = spmbench
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
+DEFINES += QT_NO_FOREACH
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        allocations.cpp \
+        legacyparsers.cpp \
+        main.cpp \
+        ../aggregation.cpp \
+        ../calculation.cpp \
+        ../calendargrid.cpp \
+        ../callout.cpp \
+        ../costbasis.cpp \
+        ../covariance.cpp \
+        ../database.cpp \
+        ../downloadmanager.cpp \
+        ../htmlscanner.cpp \
+        ../httpcache.cpp \
+        ../navseries.cpp \
+        ../networkfixture.cpp \
+        ../pagetemplate.cpp \
+        ../portfoliostate.cpp \
+        ../refreshengine.cpp \
+        ../returns.cpp \
+        ../riskmetrics.cpp \
+        ../screener.cpp \
+        ../stockdata.cpp
+
+HEADERS += \
+        allocations.h \
+        legacyparsers.h \
+        ../aggregation.h \
+        ../calculation.h \
+        ../calendargrid.h \
+        ../callout.h \
+        ../costbasis.h \
+        ../covariance.h \
+        ../database.h \
+        ../downloadmanager.h \
+        ../global.h \
+        ../htmlscanner.h \
+        ../httpcache.h \
+        ../navseries.h \
+        ../networkfixture.h \
+        ../pagetemplate.h \
+        ../portfoliostate.h \
+        ../refreshengine.h \
+        ../returns.h \
+        ../riskmetrics.h \
+        ../screener.h \
+        ../stockdata.h
+
+RESOURCES += \
+        bench.qrc
@@ -0,0 +1,19 @@
+#ifndef LEGACYPARSERS_H
+#define LEGACYPARSERS_H
+
+#include <QString>
+
+#include "global.h"
+
+/**
+ * @brief The LegacyParsers class - finvizParse and yahooParse of the Screener before the forward scan of the raw reply
+ * Kept unchanged for the comparison in the parse benchmark, the page is decoded into a QString and split into the rows
+ */
+class LegacyParsers
+{
+public:
+    static sONLINEDATA finvizParse(QString data);
+    static sONLINEDATA yahooParse(QString data);
+};
+
+#endif // LEGACYPARSERS_H
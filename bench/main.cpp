@@ -0,0 +1,542 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QUrl>
+#include <QUrlQuery>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include "allocations.h"
+#include "calculation.h"
+#include "database.h"
+#include "downloadmanager.h"
+#include "legacyparsers.h"
+#include "networkfixture.h"
+#include "refreshengine.h"
+#include "screener.h"
+#include "stockdata.h"
+
+namespace
+{
+    QTextStream out(stdout);
+
+    /**
+     * @brief getMedian - median of the run times of the function, the first run is a warm-up and is not counted
+     * @param function - gets the index of the run, so the runs can use different inputs
+     */
+    double getMedian(const int &runs, const std::function<void(int)> &function)
+    {
+        QVector<double> times;
+
+        function(0);
+
+        for (int run = 1; run <= runs; ++run)
+        {
+            QElapsedTimer timer;
+            timer.start();
+
+            function(run);
+
+            times.push_back(timer.nsecsElapsed() / 1e6);
+        }
+
+        std::sort(times.begin(), times.end());
+
+        return times.at(times.count() / 2);
+    }
+
+    /**
+     * @brief generatePortfolio - synthetic transactions, the same seed gives the same portfolio
+     * Each security has its first buy and then random buys, sells, dividends, taxes and fees over 20 years
+     */
+    StockDataType generatePortfolio(const int &securities, const int &events)
+    {
+        QRandomGenerator random(42);
+        StockDataType stockList;
+
+        const QDate first(2000, 1, 1);
+        const int days = static_cast<int>(first.daysTo(QDate(2020, 1, 1)));
+        const int perSecurity = qMax(1, events / qMax(1, securities));
+
+        for (int security = 0; security < securities; ++security)
+        {
+            const QString ISIN = QString("XS%1").arg(security, 10, 10, QChar('0'));
+            const QString ticker = QString("T%1").arg(security);
+            const QString stockName = QString("Security %1").arg(security);
+            const eCURRENCY currency = static_cast<eCURRENCY>(security % (CAD + 1));
+
+            QVector<int> eventDays;
+            eventDays.reserve(perSecurity);
+
+            for (int event = 0; event < perSecurity; ++event)
+            {
+                eventDays.push_back(static_cast<int>(random.bounded(days)));
+            }
+
+            std::sort(eventDays.begin(), eventDays.end());
+
+            QVector<sSTOCKDATA> vector;
+            vector.reserve(perSecurity);
+
+            int held = 0;
+
+            for (int event = 0; event < perSecurity; ++event)
+            {
+                sSTOCKDATA stock;
+                stock.dateTime = QDateTime(first.addDays(eventDays.at(event)), QTime(10, 0, 0));
+                stock.ticker = ticker;
+                stock.ISIN = ISIN;
+                stock.stockName = stockName;
+                stock.currency = currency;
+                stock.count = 0;
+                stock.price = 10.0 + random.bounded(1000) / 10.0;
+                stock.balance = 0.0;
+                stock.fee = 0.0;
+                stock.source = MANUALLY;
+
+                const int kind = (event == 0) ? 0 : static_cast<int>(random.bounded(100));
+
+                if (kind < 40 || held == 0)
+                {
+                    stock.type = BUY;
+                    stock.count = 1 + static_cast<int>(random.bounded(20));
+                    stock.fee = 1.0;
+                    held += stock.count;
+                }
+                else if (kind < 55)
+                {
+                    stock.type = SELL;
+                    stock.count = 1 + static_cast<int>(random.bounded(static_cast<quint32>(held)));
+                    stock.fee = 1.0;
+                    held -= stock.count;
+                }
+                else if (kind < 80)
+                {
+                    stock.type = DIVIDEND;
+                    stock.price = held * 0.1;
+                    stock.fee = stock.price * 0.15;
+                }
+                else if (kind < 90)
+                {
+                    stock.type = TAX;
+                    stock.price = held * 0.01;
+                }
+                else
+                {
+                    stock.type = FEE;
+                    stock.price = 0.5;
+                }
+
+                vector.push_back(stock);
+            }
+
+            stockList.insert(ISIN, vector);
+        }
+
+        return stockList;
+    }
+
+    bool isSame(const QVector<sOVERVIEWTABLE> &a, const QVector<sOVERVIEWTABLE> &b)
+    {
+        if (a.count() != b.count()) return false;
+
+        for (int i = 0; i < a.count(); ++i)
+        {
+            const sOVERVIEWTABLE &x = a.at(i);
+            const sOVERVIEWTABLE &y = b.at(i);
+
+            const double xValues[] = {x.percentage, x.averageBuyPrice, x.totalStockPrice, x.totalFee, x.dividend, x.realized, x.unrealized, x.XIRR};
+            const double yValues[] = {y.percentage, y.averageBuyPrice, y.totalStockPrice, y.totalFee, y.dividend, y.realized, y.unrealized, y.XIRR};
+
+            // Bit for bit, NaN included
+            if (x.ISIN != y.ISIN || x.totalCount != y.totalCount || std::memcmp(xValues, yValues, sizeof(xValues)) != 0) return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief benchOverview - Calculation::getOverviewTable with 1 to N threads of the global pool
+     * Each thread count has its own Calculation, so nothing is cached by the previous count; within the count each run has
+     * another end of the range, so the XIRRs are computed again (the cost-basis lots and the checkpoints are built by the warm-up run).
+     * The compared table has a range none of the runs used, so it is computed by the measured thread count too.
+     */
+    void benchOverview(const int &securities, const int &events, const int &runs, const QVector<int> &threads)
+    {
+        out << QString("Generating %1 securities, %2 events... ").arg(securities).arg(events) << Qt::flush;
+
+        const StockDataType portfolio = generatePortfolio(securities, events);
+
+        out << "done" << Qt::endl;
+
+        const QDate from(2000, 1, 1);
+        const QDate to(2020, 1, 1);
+
+        QVector<sOVERVIEWTABLE> reference;
+        double single = 0.0;
+
+        for (const int &count : threads)
+        {
+            Database database;
+            StockData stockData;
+            Calculation calculation(&database, &stockData);
+
+            stockData.setStockData(portfolio);
+
+            QThreadPool::globalInstance()->setMaxThreadCount(count);
+
+            const double median = getMedian(runs, [&calculation, &from, &to](int run) { calculation.getOverviewTable(from, to.addDays(-run)); });
+            const QVector<sOVERVIEWTABLE> table = calculation.getOverviewTable(from, to.addDays(-runs - 1));
+
+            if (reference.isEmpty())
+            {
+                reference = table;
+                single = median;
+            }
+
+            out << QString("getOverviewTable  threads %1  %2 ms  speedup %3  %4")
+                   .arg(count, 2).arg(median, 9, 'f', 1).arg(single / median, 5, 'f', 2)
+                   .arg(isSame(reference, table) ? "bit-identical" : "DIFFERENT") << Qt::endl;
+        }
+    }
+
+    bool isSame(const sONLINEDATA &a, const sONLINEDATA &b)
+    {
+        return a.row == b.row && a.info.stockName == b.info.stockName && a.info.sector == b.info.sector
+               && a.info.industry == b.info.industry && a.info.country == b.info.country;
+    }
+
+    /**
+     * @brief benchParse - the old (QString) and the new (forward scan) finvizParse and yahooParse on the pages of a fixture
+     * The old way includes the decoding of the page, the callers did it before each parse
+     */
+    void benchParse(const QString &path, const int &runs)
+    {
+        if (path.isEmpty())
+        {
+            out << "The parse benchmark needs the --fixture of the recorded pages" << Qt::endl;
+            return;
+        }
+
+        const NetworkFixture fixture(path, REPLAYFIXTURE);
+
+        QVector<QByteArray> finvizPages;
+        QVector<QByteArray> yahooPages;
+
+        const QStringList urls = fixture.getUrls();
+
+        for (const QString &url : urls)
+        {
+            sFIXTURERESPONSE response;
+
+            if (!fixture.find(QUrl(url), &response) || response.errorType != NODOWNLOADERROR || response.body.isEmpty()) continue;
+
+            const QString host = QUrl(url).host();
+
+            if (host.endsWith("finviz.com"))
+            {
+                finvizPages.push_back(response.body);
+            }
+            else if (host.endsWith("finance.yahoo.com"))
+            {
+                yahooPages.push_back(response.body);
+            }
+        }
+
+        const auto measure = [&](const QString &name, const QVector<QByteArray> &pages, const auto &parse)
+        {
+            if (pages.isEmpty()) return;
+
+            const double median = getMedian(runs, [&](int)
+                                            {
+                                                for (const QByteArray &page : pages)
+                                                {
+                                                    parse(page);
+                                                }
+                                            }
+                                            );
+
+            const quint64 allocations = getAllocations();
+
+            for (const QByteArray &page : pages)
+            {
+                parse(page);
+            }
+
+            const QString perPage = isAllocationCounted() ? QString::number(double(getAllocations() - allocations) / pages.count(), 'f', 0)
+                                                          : QString("n/a");
+
+            out << QString("%1  %2 pages  %3 ms  %4 us/page  %5 allocations/page")
+                   .arg(name, -11).arg(pages.count(), 5).arg(median, 9, 'f', 1).arg(median * 1e3 / pages.count(), 8, 'f', 1)
+                   .arg(perPage, 7) << Qt::endl;
+        };
+
+        measure("finviz old", finvizPages, [](const QByteArray &page) { return LegacyParsers::finvizParse(QString::fromUtf8(page)); });
+        measure("finviz new", finvizPages, [](const QByteArray &page) { return Screener::finvizParse(page); });
+        measure("yahoo old", yahooPages, [](const QByteArray &page) { return LegacyParsers::yahooParse(QString::fromUtf8(page)); });
+        measure("yahoo new", yahooPages, [](const QByteArray &page) { return Screener::yahooParse(page); });
+
+        int different = 0;
+
+        for (const QByteArray &page : qAsConst(finvizPages))
+        {
+            if (!isSame(LegacyParsers::finvizParse(QString::fromUtf8(page)), Screener::finvizParse(page))) ++different;
+        }
+
+        for (const QByteArray &page : qAsConst(yahooPages))
+        {
+            if (!isSame(LegacyParsers::yahooParse(QString::fromUtf8(page)), Screener::yahooParse(page))) ++different;
+        }
+
+        out << QString("%1 of %2 pages parsed differently").arg(different).arg(finvizPages.count() + yahooPages.count()) << Qt::endl;
+    }
+
+    /**
+     * @brief getTickers - tickers of the finviz and Yahoo pages of the fixture, sorted
+     */
+    QStringList getTickers(const NetworkFixture &fixture)
+    {
+        QSet<QString> tickers;
+
+        const QStringList urls = fixture.getUrls();
+
+        for (const QString &url : urls)
+        {
+            const QUrl page(url);
+
+            if (page.host().endsWith("finviz.com"))
+            {
+                tickers.insert(QUrlQuery(page).queryItemValue("t"));
+            }
+            else if (page.host().endsWith("finance.yahoo.com"))
+            {
+                tickers.insert(page.path().section('/', 2, 2));
+            }
+        }
+
+        tickers.remove(QString());
+
+        QStringList list = tickers.values();
+        list.sort();
+
+        return list;
+    }
+
+    /**
+     * @brief benchRefresh - the RefreshEngine over all tickers of a fixture, the responses are replayed with the latency and the errors
+     * With the default host limits the rate of the hosts is measured, unlimited measures the engine and the parsing
+     */
+    void benchRefresh(const QString &path, const int &latency, const int &jitter, const double &errors, const bool &unlimited)
+    {
+        if (path.isEmpty())
+        {
+            out << "The refresh benchmark needs the --fixture of the recorded pages" << Qt::endl;
+            return;
+        }
+
+        DownloadManager downloadManager;
+        downloadManager.setFixture(REPLAYFIXTURE, path);
+
+        NetworkFixture *fixture = downloadManager.getFixture();
+        fixture->setLatency(latency, jitter);
+        fixture->setErrorRate(errors);
+
+        const QStringList tickers = getTickers(*fixture);
+
+        if (tickers.isEmpty())
+        {
+            out << QString("The fixture %1 has no finviz or Yahoo page").arg(path) << Qt::endl;
+            return;
+        }
+
+        RefreshEngine engine(&downloadManager);
+
+        if (unlimited)
+        {
+            engine.setHostLimit("finviz.com", DownloadManager::DEFAULTCONCURRENCY, 1e6, 1000000);
+            engine.setHostLimit("finance.yahoo.com", DownloadManager::DEFAULTCONCURRENCY, 1e6, 1000000);
+        }
+
+        int failed = 0;
+        QEventLoop loop;
+
+        QObject::connect(&engine, &RefreshEngine::finished, &loop, [&failed, &loop](int count)
+                         {
+                             failed = count;
+                             loop.quit();
+                         }
+                         );
+
+        QElapsedTimer timer;
+        timer.start();
+
+        engine.start(tickers);
+        loop.exec();
+
+        const double seconds = timer.nsecsElapsed() / 1e9;
+
+        out << QString("refresh  %1 tickers  %2 failed  %3 s  %4 tickers/s  latency %5+%6 ms  errors %7%8")
+               .arg(tickers.count()).arg(failed).arg(seconds, 0, 'f', 2).arg(tickers.count() / seconds, 0, 'f', 1)
+               .arg(latency).arg(jitter).arg(errors, 0, 'f', 2).arg(unlimited ? "  unlimited hosts" : "") << Qt::endl;
+    }
+
+    /**
+     * @brief benchRates - conversion of the prices to the selected currency
+     * The way before the calculation context (the settings and the functions map copied for each record, a QString key for each
+     * lookup), Database::getExchangePrice alone and the rate matrix of the context
+     */
+    void benchRates(const int &conversions, const int &runs)
+    {
+        Database database;
+        const sCALCULATIONCONTEXT context = database.getCalculationContext();
+
+        QRandomGenerator random(42);
+        QVector<eCURRENCY> currencies;
+        QVector<double> prices;
+
+        currencies.reserve(conversions);
+        prices.reserve(conversions);
+
+        for (int i = 0; i < conversions; ++i)
+        {
+            currencies.push_back(static_cast<eCURRENCY>(random.bounded(CAD + 1)));
+            prices.push_back(random.bounded(100000) / 100.0);
+        }
+
+        const auto measure = [&](const QString &name, const auto &convert)
+        {
+            double sum = 0.0;
+
+            const double median = getMedian(runs, [&](int)
+                                            {
+                                                sum = 0.0;
+
+                                                for (int i = 0; i < conversions; ++i)
+                                                {
+                                                    sum += convert(currencies.at(i), prices.at(i));
+                                                }
+                                            }
+                                            );
+
+            const quint64 allocations = getAllocations();
+
+            for (int i = 0; i < conversions; ++i)
+            {
+                convert(currencies.at(i), prices.at(i));
+            }
+
+            const QString perConversion = isAllocationCounted() ? QString::number(double(getAllocations() - allocations) / qMax(1, conversions), 'f', 2)
+                                                                : QString("n/a");
+
+            out << QString("%1  %2 ms  %3 ns/conversion  %4 allocations/conversion  sum %5")
+                   .arg(name, -16).arg(median, 9, 'f', 1).arg(median * 1e6 / qMax(1, conversions), 7, 'f', 1)
+                   .arg(perConversion, 5).arg(sum, 0, 'f', 2) << Qt::endl;
+        };
+
+        measure("settings copy", [&database](const eCURRENCY &currency, const double &price)
+                {
+                    const sSETTINGS setting = database.getSetting();
+                    const ExchangeRatesFunctions exchangeRates = database.getExchangeRatesFuncMap();
+                    const QString key = database.getCurrencyText(currency) + "2" + database.getCurrencyText(setting.currency);
+
+                    auto it = exchangeRates.constFind(key);
+
+                    return (it == exchangeRates.constEnd()) ? price : it.value()(price);
+                }
+                );
+
+        measure("getExchangePrice", [&database](const eCURRENCY &currency, const double &price)
+                {
+                    return database.getExchangePrice(currency, price);
+                }
+                );
+
+        measure("context matrix", [&context](const eCURRENCY &currency, const double &price)
+                {
+                    return context.toSelected(currency, price);
+                }
+                );
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("SPMBench");
+
+    // The Database and the StockData write their files, not into the data of the application
+    QStandardPaths::setTestMode(true);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("SPM benchmarks\n"
+                                     "  overview - getOverviewTable on a synthetic portfolio with 1 to N threads\n"
+                                     "  rates    - conversion of the prices to the selected currency\n"
+                                     "  parse    - old and new finvizParse and yahooParse on the pages of a fixture\n"
+                                     "  refresh  - RefreshEngine over the tickers of a fixture with the replay latency and errors");
+    parser.addHelpOption();
+    parser.addPositionalArgument("benchmark", "overview, rates, parse, refresh");
+    parser.addOption({"securities", "Securities of the synthetic portfolio.", "count", "5000"});
+    parser.addOption({"events", "Transactions of the synthetic portfolio.", "count", "1000000"});
+    parser.addOption({"conversions", "Conversions of the rates benchmark.", "count", "1000000"});
+    parser.addOption({"fixture", "Network fixture with the recorded pages (SPM_RECORD).", "path"});
+    parser.addOption({"latency", "Replay latency of the refresh benchmark.", "ms", "100"});
+    parser.addOption({"jitter", "Replay jitter of the refresh benchmark.", "ms", "50"});
+    parser.addOption({"errors", "Injected error rate (0 - 1) of the refresh benchmark.", "rate", "0"});
+    parser.addOption({"unlimited", "No host limits in the refresh benchmark."});
+    parser.addOption({"runs", "Measured runs, the median is reported.", "count", "5"});
+    parser.addOption({"threads", "Thread counts of the overview benchmark.", "list", "1,2,4,8"});
+    parser.process(app);
+
+    const QStringList benchmarks = parser.positionalArguments();
+
+    if (benchmarks.isEmpty())
+    {
+        parser.showHelp(1);
+    }
+
+    const int runs = qMax(1, parser.value("runs").toInt());
+
+    QVector<int> threads;
+    const QStringList threadList = parser.value("threads").split(',', Qt::SkipEmptyParts);
+
+    for (const QString &count : threadList)
+    {
+        threads.push_back(qMax(1, count.toInt()));
+    }
+
+    for (const QString &benchmark : benchmarks)
+    {
+        if (benchmark == "overview")
+        {
+            benchOverview(parser.value("securities").toInt(), parser.value("events").toInt(), runs, threads);
+        }
+        else if (benchmark == "rates")
+        {
+            benchRates(parser.value("conversions").toInt(), runs);
+        }
+        else if (benchmark == "parse")
+        {
+            benchParse(parser.value("fixture"), runs);
+        }
+        else if (benchmark == "refresh")
+        {
+            benchRefresh(parser.value("fixture"), parser.value("latency").toInt(), parser.value("jitter").toInt(),
+                         parser.value("errors").toDouble(), parser.isSet("unlimited"));
+        }
+        else
+        {
+            out << QString("Unknown benchmark %1").arg(benchmark) << Qt::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -1,54 +1,102 @@
 #include "calculation.h"
 
+#include <QtConcurrent>
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+
 Calculation::Calculation(Database *db, StockData *sd, QObject *parent) : QObject(parent), database(db), stockData(sd)
 {
+    // At most one job per overview view (table, info) is in flight, newer requests supersede the older ones
+    pool.setMaxThreadCount(2);
+}
+
+QFuture<QVector<sOVERVIEWTABLE>> Calculation::getOverviewTableAsync(const QDate &from, const QDate &to)
+{
+    return QtConcurrent::run(&pool, [this, from, to]()
+                             {
+                                 return getOverviewTable(from, to);
+                             }
+                             );
+}
 
+QFuture<sOVERVIEWINFO> Calculation::getOverviewInfoAsync(const QDate &from, const QDate &to)
+{
+    return QtConcurrent::run(&pool, [this, from, to]()
+                             {
+                                 return getOverviewInfo(from, to);
+                             }
+                             );
 }
 
 double Calculation::getPortfolioValue(const QDate &from, const QDate &to)
 {
-    Q_ASSERT(stockData);
     Q_ASSERT(database);
 
-    StockDataType stockList = stockData->getStockData();
+    return getPortfolioValue(database->getCalculationContext(), from, to);
+}
 
-    QList<QString> keys = stockList.keys();
+double Calculation::getPortfolioValue(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to)
+{
+    Q_ASSERT(stockData);
 
+    const StockDataSnapshot snapshot = stockData->getSnapshot();
+    const StockDataType &stockList = *snapshot;
 
-    double portfolioValue = 0.0;
+    const QList<QString> keys = stockList.keys();
+    const bool showSoldPositions = context.showSoldPositions;
 
-    for(const QString &key : keys)
+    portfolioState.update(stockList);
+    const QHash<QString, int> counts = portfolioState.getCounts(from, to);
+
+    // Value of each ISIN is calculated in parallel, the sum is done in the keys order to get the same result as the serial loop
+    struct sVALUEJOB
     {
-        if( key.isEmpty() || stockList.value(key).count() == 0 ) continue;
+        QString key;
+        double price;       // cached online price, NaN if not available
+        double value;
+    };
 
-        sSTOCKDATA stock = stockList.value(key).first();
+    const QVector<double> prices = stockData->getPrices(keys);
 
-        if(stock.stockName.toLower().contains("fundshare") ) continue;
+    QVector<sVALUEJOB> values;
+    values.reserve(keys.count());
 
-        int totalCount = stockData->getTotalCount(stock.ISIN, from, to);
+    for(int i = 0; i < keys.count(); ++i)
+    {
+        values.push_back({keys.at(i), prices.at(i), 0.0});
+    }
 
-        if(totalCount <= 0 && !database->getSetting().showSoldPositions) continue;
+    QtConcurrent::blockingMap(values, [&context, &stockList, &counts, showSoldPositions](sVALUEJOB &value)
+                              {
+                                  const QString &key = value.key;
 
+                                  if( key.isEmpty() || stockList.value(key).count() == 0 ) return;
 
-        QString cachedPrice = stockData->getCachedISINParam(stock.ISIN, "Price");
+                                  const sSTOCKDATA stock = stockList.value(key).first();
 
-        if(cachedPrice.isEmpty())
-        {
-            // ToDo the return price might be in EUR or USD or whatever
-            cachedPrice = stockData->getCachedISINParam(stock.ISIN, "Previous Close");
-        }
+                                  if(stock.flags & EXCLUDEDFLAG) return;
 
-        double onlineStockPrice = 0.0;
-        double totalOnlinePrice = 0.0;
+                                  int totalCount = counts.value(stock.ISIN);
 
-        if(!cachedPrice.isEmpty())
-        {
-            onlineStockPrice = database->getExchangePrice(USD, cachedPrice.toDouble());
-            totalOnlinePrice = onlineStockPrice*totalCount;
-        }
+                                  if(totalCount <= 0 && !showSoldPositions) return;
+
+
+                                  if(!std::isnan(value.price))
+                                  {
+                                      double onlineStockPrice = context.toSelected(USD, value.price);
+                                      value.value = onlineStockPrice*totalCount;
+                                  }
+                              }
+                              );
 
 
-        portfolioValue += (totalOnlinePrice);
+    double portfolioValue = 0.0;
+
+    for(const sVALUEJOB &value : qAsConst(values))
+    {
+        portfolioValue += value.value;
     }
 
     return portfolioValue;
@@ -56,94 +104,172 @@ double Calculation::getPortfolioValue(const QDate &from, const QDate &to)
 
 sOVERVIEWINFO Calculation::getOverviewInfo(const QDate &from, const QDate &to)
 {
-    Q_ASSERT(stockData);
     Q_ASSERT(database);
 
-    StockDataType stockList = stockData->getStockData();
+    return getOverviewInfo(database->getCalculationContext(), from, to);
+}
+
+sOVERVIEWINFO Calculation::getOverviewInfo(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to)
+{
+    Q_ASSERT(stockData);
+
+    const StockDataSnapshot snapshot = stockData->getSnapshot();
+    const StockDataType &stockList = *snapshot;
 
     if(stockList.isEmpty())
     {
-        return sOVERVIEWINFO();
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+
+        sOVERVIEWINFO info = sOVERVIEWINFO();
+        info.TWR = nan;
+        info.XIRR = nan;
+        info.risk = {nan, 0.0, nan, nan};
+        info.beta = nan;
+
+        return info;
     }
 
-    double deposit = 0.0;
-    double withdrawal = 0.0;
-    double invested = 0.0;
-    double transFees = 0.0;
-    double sell = 0.0;
-    double dividends = 0.0;
-    double divTax = 0.0;
-    double fees = 0.0;
-    QList<QString> isinList = stockList.keys();
+    // Each ISIN is processed in parallel, the partial terms are summed afterwards in the ISIN order,
+    // one by one, so the totals are bit-identical to the serial loop
+    enum eTERM { DEPOSITTERM = 0, WITHDRAWALTERM, TRANSFEETERM, SELLTERM, DIVIDENDTERM, DIVTAXTERM, FEETERM, INVESTEDTERM, TERMCOUNT };
 
-    double balance = 0.0;
-    QDateTime lastDate = stockList.values().first().first().dateTime;
+    struct sISINPART
+    {
+        QString ISIN;
+        QVector<QPair<eTERM, double>> terms;
+        bool hasBalance = false;
+        double balance = 0.0;
+        QDateTime lastDate;
+        QVector<sCASHFLOW> flows;                   // deposits and withdrawals, investor view
+        QVector<QPair<QDate, double>> trades;       // money moved into the holdings
+    };
+
+    const QList<QString> isinList = stockList.keys();
+    const QDateTime firstDate = stockList.cbegin().value().first().dateTime;
+    const bool showSoldPositions = context.showSoldPositions;
+
+    portfolioState.update(stockList);
+    const QHash<QString, int> counts = portfolioState.getCounts(from, to);
+
+    QVector<sISINPART> parts;
+    parts.reserve(isinList.count());
 
     for(const QString &ISIN : isinList)
     {
-        for(const sSTOCKDATA &stock : stockList.value(ISIN))
-        {
-            if( !(stock.dateTime.date() >= from && stock.dateTime.date() <= to) ) continue;
+        sISINPART part;
+        part.ISIN = ISIN;
+        part.lastDate = firstDate;
+        parts.push_back(part);
+    }
 
-            if(stock.currency == EUR && stock.dateTime >= lastDate)
-            {
-                balance = stock.balance;
-                lastDate = stock.dateTime;
-            }
+    QtConcurrent::blockingMap(parts, [this, &context, &stockList, &from, &to, showSoldPositions, &counts](sISINPART &part)
+                              {
+                                  for(const sSTOCKDATA &stock : stockList.value(part.ISIN))
+                                  {
+                                      if( !(stock.dateTime.date() >= from && stock.dateTime.date() <= to) ) continue;
 
-            if( stock.stockName.toLower().contains("fundshare") ) continue;
+                                      if(stock.currency == EUR && stock.dateTime >= part.lastDate)
+                                      {
+                                          part.hasBalance = true;
+                                          part.balance = stock.balance;
+                                          part.lastDate = stock.dateTime;
+                                      }
 
-            switch(stock.type)
-            {
-                case DEPOSIT:
-                {
-                    deposit += database->getExchangePrice(stock.currency, stock.price);
-                }
-                break;
+                                      if( stock.flags & EXCLUDEDFLAG ) continue;
 
-                case WITHDRAWAL:
-                {
-                    withdrawal += database->getExchangePrice(stock.currency, stock.price);
-                }
-                break;
+                                      switch(stock.type)
+                                      {
+                                          case DEPOSIT:
+                                          {
+                                              const double value = context.toSelected(stock.currency, stock.price);
+                                              part.terms.push_back(qMakePair(DEPOSITTERM, value));
+                                              part.flows.push_back({stock.dateTime.date(), -value});
+                                          }
+                                          break;
 
-                case BUY:
-                {
-                    transFees += database->getExchangePrice(stock.currency, stock.fee);
-                }
-                break;
+                                          case WITHDRAWAL:
+                                          {
+                                              const double value = context.toSelected(stock.currency, stock.price);
+                                              part.terms.push_back(qMakePair(WITHDRAWALTERM, value));
+                                              part.flows.push_back({stock.dateTime.date(), -value});
+                                          }
+                                          break;
 
-                case SELL:
-                {
-                    sell += database->getExchangePrice(stock.currency, stock.price) * stock.count;
-                    transFees += database->getExchangePrice(stock.currency, stock.fee);
-                }
-                break;
+                                          case BUY:
+                                          {
+                                              part.terms.push_back(qMakePair(TRANSFEETERM, context.toSelected(stock.currency, stock.fee)));
+                                              part.trades.push_back(qMakePair(stock.dateTime.date(), context.toSelected(stock.currency, std::abs(stock.price) * stock.count)));
+                                          }
+                                          break;
 
-                case DIVIDEND:
-                {
-                    dividends += database->getExchangePrice(stock.currency, stock.price);
-                    divTax += database->getExchangePrice(stock.currency, stock.fee);
-                }
-                break;
+                                          case SELL:
+                                          {
+                                              part.terms.push_back(qMakePair(SELLTERM, context.toSelected(stock.currency, stock.price) * stock.count));
+                                              part.terms.push_back(qMakePair(TRANSFEETERM, context.toSelected(stock.currency, stock.fee)));
+                                              part.trades.push_back(qMakePair(stock.dateTime.date(), -context.toSelected(stock.currency, std::abs(stock.price) * stock.count)));
+                                          }
+                                          break;
 
-                case FEE:
-                {
-                    fees += database->getExchangePrice(stock.currency, stock.price);
-                }
-                break;
-            }
+                                          case DIVIDEND:
+                                          {
+                                              part.terms.push_back(qMakePair(DIVIDENDTERM, context.toSelected(stock.currency, stock.price)));
+                                              part.terms.push_back(qMakePair(DIVTAXTERM, context.toSelected(stock.currency, stock.fee)));
+                                          }
+                                          break;
+
+                                          case FEE:
+                                          {
+                                              part.terms.push_back(qMakePair(FEETERM, context.toSelected(stock.currency, stock.price)));
+                                          }
+                                          break;
+                                      }
+                                  }
+
+                                  int totalCount = counts.value(part.ISIN);
+
+                                  if(totalCount > 0 || showSoldPositions)
+                                  {
+                                      part.terms.push_back(qMakePair(INVESTEDTERM, StockData::getTotalPrice(stockList, part.ISIN, from, to, context)));
+                                  }
+                              }
+                              );
+
+    double sums[TERMCOUNT] = {};
+    double balance = 0.0;
+    QDateTime lastDate = firstDate;
+    QVector<sCASHFLOW> flows;
+    QMap<QDate, double> tradeFlows;
+
+    for(const sISINPART &part : qAsConst(parts))
+    {
+        if(part.hasBalance && part.lastDate >= lastDate)
+        {
+            balance = part.balance;
+            lastDate = part.lastDate;
+        }
+
+        for(const QPair<eTERM, double> &term : part.terms)
+        {
+            sums[term.first] += term.second;
         }
 
-        int totalCount = stockData->getTotalCount(ISIN, from, to);
+        flows.append(part.flows);
 
-        if(totalCount > 0 || database->getSetting().showSoldPositions)
+        for(const QPair<QDate, double> &trade : part.trades)
         {
-            double tmp = stockData->getTotalPrice(ISIN, from, to, database->getSetting().currency, database->getExchangeRatesFuncMap());
-            invested += tmp;
+            tradeFlows[trade.first] += trade.second;
         }
     }
 
+    double deposit = sums[DEPOSITTERM];
+    double withdrawal = sums[WITHDRAWALTERM];
+    double invested = sums[INVESTEDTERM];
+    double transFees = sums[TRANSFEETERM];
+    double sell = sums[SELLTERM];
+    double dividends = sums[DIVIDENDTERM];
+    double divTax = sums[DIVTAXTERM];
+    double fees = sums[FEETERM];
+
     sOVERVIEWINFO info;
     info.deposit = deposit;
     info.withdrawal = withdrawal;
@@ -170,8 +296,8 @@ sOVERVIEWINFO Calculation::getOverviewInfo(const QDate &from, const QDate &to)
     }
 
     //info.account = (deposit + sell + dividends - divTax - invested - fees - transFees - withdrawal);
-    info.account = database->getExchangePrice(EUR, balance);
-    info.portfolio = getPortfolioValue(from, to);
+    info.account = context.toSelected(EUR, balance);
+    info.portfolio = getPortfolioValue(context, from, to);
 
     if(!qFuzzyIsNull(deposit))
     {
@@ -182,17 +308,86 @@ sOVERVIEWINFO Calculation::getOverviewInfo(const QDate &from, const QDate &to)
         info.performance = 0.0;
     }
 
+    getReturns(context, from, to, stockList, flows, tradeFlows, info);
+    info.beta = getBeta(context, stockList, from, to);
+
     return info;
 }
 
+void Calculation::getReturns(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, const StockDataType &stockList, QVector<sCASHFLOW> flows, const QMap<QDate, double> &tradeFlows, sOVERVIEWINFO &info)
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    info.TWR = nan;
+    info.XIRR = nan;
+    info.risk = {nan, 0.0, nan, nan};
+
+    updateNavSeries(context, stockList);
+
+    // The day before the range is the opening value
+    quint64 generation;
+    const QVector<QPair<QDate, double>> values = navSeries.getSeries(from.addDays(-1), to, &generation);
+
+    if(values.isEmpty())
+    {
+        return;
+    }
+
+    // One cache slot per measure, the ranges replace each other
+    info.TWR = returns.getTWR("portfolio|TWR", values, tradeFlows);
+
+    // Only the days after the last update of the range are added to its risk accumulators
+    const std::shared_ptr<RiskMetrics> metrics = getRiskMetrics(from, to);
+    metrics->update(generation, values, tradeFlows);
+    info.risk = metrics->getMetrics();
+
+    // XIRR of the whole account: opening value, deposits and withdrawals, closing value; cash included
+    const QVector<double> rates = getRates(context);
+
+    auto getCash = [&rates](const sPORTFOLIOSTATE &state)
+    {
+        double cash = 0.0;
+
+        for(int currency = 0; currency < state.cash.count(); ++currency)
+        {
+            cash += state.cash.at(currency) * rates.value(currency, 1.0);
+        }
+
+        return cash;
+    };
+
+    if(values.first().first < from)
+    {
+        const double opening = values.first().second + getCash(portfolioState.getState(values.first().first));
+
+        if(opening > 0.0)
+        {
+            flows.push_front({from, -opening});
+        }
+    }
+
+    const QDate last = values.last().first;
+    flows.push_back({last, values.last().second + getCash(portfolioState.getState(last))});
+
+    info.XIRR = returns.getXIRR("portfolio|XIRR", flows);
+}
+
 QVector<sOVERVIEWTABLE> Calculation::getOverviewTable(const QDate &from, const QDate &to)
+{
+    Q_ASSERT(database);
+
+    return getOverviewTable(database->getCalculationContext(), from, to);
+}
+
+QVector<sOVERVIEWTABLE> Calculation::getOverviewTable(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to)
 {
     Q_ASSERT(stockData);
     Q_ASSERT(database);
 
     QVector<sOVERVIEWTABLE> table;
 
-    StockDataType stockList = stockData->getStockData();
+    const StockDataSnapshot snapshot = stockData->getSnapshot();
+    const StockDataType &stockList = *snapshot;
 
     if(stockList.isEmpty())
     {
@@ -207,83 +402,181 @@ QVector<sOVERVIEWTABLE> Calculation::getOverviewTable(const QDate &from, const Q
               }
               );
 
-    for(const QString &ISIN : isinList)
+    // Rows are calculated in parallel and collected in the sorted ISIN order
+    struct sROWJOB
     {
-        if( ISIN.isEmpty() || stockList.value(ISIN).count() == 0 ) continue;
+        QString ISIN;
+        double price;       // cached online price, NaN if not available
+        double beta;        // cached online beta, NaN if not available
+        bool valid = false;
+        sOVERVIEWTABLE row;
+    };
 
-        //sSTOCKDATA stock = stockList.value(key).first();
-        auto values = stockList.value(ISIN);
-        auto stock = std::find_if(values.begin(), values.end(), [](sSTOCKDATA data)
-                     {
-                         return data.type == BUY;
-                     });
+    const bool showSoldPositions = context.showSoldPositions;
+
+    // Bring the open lots up to date, only the changed ISINs are processed
+    costBasis.setMethod(context.costBasisMethod);
+    costBasis.update(stockList);
+
+    portfolioState.update(stockList);
+    const QHash<QString, int> counts = portfolioState.getCounts(from, to);
+
+    const QVector<double> prices = stockData->getPrices(isinList);
+    const QVector<double> betas = stockData->getQuotes(isinList, BETAQUOTE);
+
+    QVector<sROWJOB> jobs;
+    jobs.reserve(isinList.count());
+
+    for(int i = 0; i < isinList.count(); ++i)
+    {
+        const QString &ISIN = isinList.at(i);
+
+        sROWJOB job;
+        job.ISIN = ISIN;
+        job.price = prices.at(i);
+        job.beta = betas.at(i);
+
+        // Find sector
+        auto isinData = context.isins.constFind(ISIN);
 
-        if(stock == values.end())
+        if(isinData != context.isins.cend())
         {
-            continue;
+            job.row.sector = isinData->sector;
         }
 
-        if(stock->stockName.toLower().contains("fundshare") ) continue;
+        jobs.push_back(job);
+    }
 
-        sOVERVIEWTABLE row;
+    QtConcurrent::blockingMap(jobs, [this, &context, &stockList, &from, &to, showSoldPositions, &counts](sROWJOB &job)
+                              {
+                                  const QString &ISIN = job.ISIN;
 
-        // Check the total count
-        int totalCount = stockData->getTotalCount(ISIN, from, to);
+                                  if( ISIN.isEmpty() || stockList.value(ISIN).count() == 0 ) return;
 
-        if(totalCount <= 0 && !database->getSetting().showSoldPositions) continue;
+                                  //sSTOCKDATA stock = stockList.value(key).first();
+                                  const QVector<sSTOCKDATA> values = stockList.value(ISIN);
+                                  auto stock = std::find_if(values.cbegin(), values.cend(), [](const sSTOCKDATA &data)
+                                               {
+                                                   return data.type == BUY;
+                                               });
 
-        row.totalCount = totalCount;
+                                  if(stock == values.cend())
+                                  {
+                                      return;
+                                  }
 
-        row.ISIN = ISIN;
-        row.ticker = stock->ticker;
-        row.stockName = stock->stockName;
+                                  if(stock->flags & EXCLUDEDFLAG) return;
 
-        // Find sector
-        const QVector<sISINDATA> isinList = database->getIsinList();
+                                  sOVERVIEWTABLE &row = job.row;
 
-        auto it = std::find_if(isinList.begin(), isinList.end(), [&ISIN](sISINDATA a)
-                               {
-                                   return ISIN == a.ISIN;
-                               }
-                               );
+                                  // Check the total count
+                                  int totalCount = counts.value(ISIN);
 
-        if(it != isinList.end())
-        {
-            row.sector = it->sector;
-        }
+                                  if(totalCount <= 0 && !showSoldPositions) return;
 
-        // Get cached price and calculate total online price
-        QString cachedPrice = stockData->getCachedISINParam(ISIN, "Price");
+                                  row.totalCount = totalCount;
 
-        if(cachedPrice.isEmpty())
-        {
-            // ToDo the return price might be in EUR or USD or whatever
-            cachedPrice = stockData->getCachedISINParam(ISIN, "Previous Close");
-        }
+                                  row.ISIN = ISIN;
+                                  row.ticker = stock->ticker;
+                                  row.stockName = stock->stockName;
+                                  row.beta = job.beta;
 
-        if(!cachedPrice.isEmpty())
-        {
-            //row.onlineStockPrice = database->getExchangePrice(USD, cachedPrice.toDouble());
-            row.onlineStockPrice = database->getExchangePrice(stock->currency, cachedPrice.toDouble());
-            row.totalOnlinePrice = row.onlineStockPrice*totalCount;
-        }
-        else
-        {
-            row.onlineStockPrice = 0.0;
-            row.totalOnlinePrice = 0.0;
-        }
+                                  // Cached price and total online price
+                                  const bool hasPrice = !std::isnan(job.price);
+
+                                  if(hasPrice)
+                                  {
+                                      row.onlineStockPrice = context.toSelected(stock->currency, job.price);
+                                      row.totalOnlinePrice = row.onlineStockPrice*totalCount;
+                                  }
+                                  else
+                                  {
+                                      row.onlineStockPrice = 0.0;
+                                      row.totalOnlinePrice = 0.0;
+                                  }
 
-        row.totalStockPrice = stockData->getTotalPrice(ISIN, from, to, database->getSetting().currency, database->getExchangeRatesFuncMap());
-        row.averageBuyPrice = row.totalStockPrice/totalCount;
+                                  row.totalStockPrice = StockData::getTotalPrice(stockList, ISIN, from, to, context);
 
-        row.totalFee = stockData->getTotalFee(ISIN, from, to, database->getSetting().currency, database->getExchangeRatesFuncMap());
-        row.dividend = stockData->getReceivedDividend(ISIN, from, to, database->getSetting().currency, database->getExchangeRatesFuncMap());
+                                  // Average price and gains come from the open lots
+                                  const sCOSTBASISSTATE state = costBasis.getState(ISIN, to);
+                                  row.realized = context.toSelected(stock->currency, costBasis.getRealized(ISIN, from, to));
 
+                                  if(state.openCount > 0)
+                                  {
+                                      const double openCost = context.toSelected(stock->currency, state.openCost);
 
-        table.push_back(row);
+                                      row.averageBuyPrice = openCost/state.openCount;
+                                      row.unrealized = hasPrice ? row.onlineStockPrice*state.openCount - openCost : 0.0;
+                                  }
+                                  else
+                                  {
+                                      row.averageBuyPrice = row.totalStockPrice/totalCount;
+                                      row.unrealized = 0.0;
+                                  }
+
+                                  row.totalFee = StockData::getTotalFee(stockList, ISIN, from, to, context);
+                                  row.dividend = StockData::getReceivedDividend(stockList, ISIN, from, to, context);
+
+                                  // Money-weighted return of the position: opening cost, trades and dividends, current value
+                                  QVector<sCASHFLOW> flows;
+                                  const sCOSTBASISSTATE opening = costBasis.getState(ISIN, from.addDays(-1));
+
+                                  if(opening.openCount > 0)
+                                  {
+                                      flows.push_back({from, -context.toSelected(stock->currency, opening.openCost)});
+                                  }
+
+                                  for(const sSTOCKDATA &data : values)
+                                  {
+                                      const QDate date = data.dateTime.date();
+
+                                      if( !(date >= from && date <= to) ) continue;
+
+                                      switch(data.type)
+                                      {
+                                          case BUY:
+                                          {
+                                              flows.push_back({date, context.toSelected(data.currency, -std::abs(data.price) * data.count + data.fee)});
+                                          }
+                                          break;
+
+                                          case SELL:
+                                          {
+                                              flows.push_back({date, context.toSelected(data.currency, std::abs(data.price) * data.count + data.fee)});
+                                          }
+                                          break;
+
+                                          case DIVIDEND:
+                                          {
+                                              flows.push_back({date, context.toSelected(data.currency, data.price) + context.toSelected(data.currency, data.fee)});
+                                          }
+                                          break;
+
+                                          default:
+                                          break;
+                                      }
+                                  }
+
+                                  if(state.openCount > 0 && hasPrice)
+                                  {
+                                      flows.push_back({qMin(to, QDate::currentDate()), row.onlineStockPrice*state.openCount});
+                                  }
+
+                                  row.XIRR = returns.getXIRR(ISIN, flows);
+
+                                  job.valid = true;
+                              }
+                              );
+
+    for(const sROWJOB &job : qAsConst(jobs))
+    {
+        if(job.valid)
+        {
+            table.push_back(job.row);
+        }
     }
 
-    double portfolioValue = getPortfolioValue(from, to);
+    double portfolioValue = getPortfolioValue(context, from, to);
 
     QMutableVectorIterator it(table);
 
@@ -298,131 +591,121 @@ QVector<sOVERVIEWTABLE> Calculation::getOverviewTable(const QDate &from, const Q
     return table;
 }
 
-MonthDividendDataType Calculation::getMonthDividendData(const QDate &from, const QDate &to)
+QVector<QVector<sCASHEVENT>> Calculation::getCashEvents(const sCALCULATIONCONTEXT &context, const StockDataType &stockList, const QList<QString> &keys, const eSTOCKEVENTTYPE &type, const QDate &from, const QDate &to)
 {
-    Q_ASSERT(stockData);
-    Q_ASSERT(database);
-
-    //    year              month  price
-    MonthDividendDataType dividends;
-
-    StockDataType stockList = stockData->getStockData();
+    QVector<QVector<sCASHEVENT>> events(keys.count());
 
-    if(stockList.isEmpty())
-    {
-        return dividends;
-    }
+    QVector<int> indexes(keys.count());
+    std::iota(indexes.begin(), indexes.end(), 0);
 
-    QList<QString> keys = stockList.keys();
+    QtConcurrent::blockingMap(indexes, [&context, &stockList, &keys, type, &from, &to, &events](const int &index)
+                              {
+                                  QVector<sCASHEVENT> &isinEvents = events[index];
 
-    for(const QString &key : keys)
-    {
-        for(const sSTOCKDATA &stock : stockList.value(key))
-        {
-            if( !(stock.dateTime.date() >= from && stock.dateTime.date() <= to) ) continue;
+                                  for(const sSTOCKDATA &stock : stockList.value(keys.at(index)))
+                                  {
+                                      if( !(stock.dateTime.date() >= from && stock.dateTime.date() <= to) ) continue;
 
-            if( stock.stockName.toLower().contains("fundshare") ) continue;
+                                      if( stock.flags & EXCLUDEDFLAG ) continue;
 
-            if(stock.type == DIVIDEND)
-            {
-                QString rates;
+                                      if(stock.type == type)
+                                      {
+                                          sCASHEVENT event;
+                                          event.ticker = stock.ticker;
+                                          event.date = stock.dateTime.date();
+                                          event.price = context.toSelected(stock.currency, stock.price);
 
-                double price = 0.0;
+                                          isinEvents.push_back(event);
+                                      }
+                                  }
+                              }
+                              );
 
-                price = database->getExchangePrice(stock.currency, stock.price);
+    return events;
+}
 
-                QDate date = stock.dateTime.date();
+CalendarGrid Calculation::getCalendar(const QVector<QVector<sCASHEVENT>> &events, QStringList *tickers)
+{
+    // The first pass finds the years and the layers, the second one only adds to the buckets
+    int firstYear = 0;
+    int lastYear = 0;
+    bool found = false;
+    QHash<QString, int> layers;
 
-                QVector<QPair<int, double>> vector = dividends.value(date.year());
-                auto found = std::find_if(vector.begin(), vector.end(), [date] (QPair<int, double> &a)
-                                          {
-                                              return date.month() == a.first;
-                                          }
-                                          );
+    for(const QVector<sCASHEVENT> &isinEvents : events)
+    {
+        for(const sCASHEVENT &event : isinEvents)
+        {
+            const int year = event.date.year();
 
-                if(found != vector.end())
-                {
-                    found->second += price;
-                }
-                else
-                {
-                    vector.push_back(qMakePair(date.month(), price));
-                }
+            firstYear = found ? qMin(firstYear, year) : year;
+            lastYear = found ? qMax(lastYear, year) : year;
+            found = true;
 
-                dividends.insert(date.year(), vector);
+            if(tickers != nullptr && !layers.contains(event.ticker))
+            {
+                layers.insert(event.ticker, layers.count());
+                tickers->push_back(event.ticker);
             }
         }
     }
 
-
-    // Sort from min to max and find the min and max
-    QList<int> divKeys = dividends.keys();
-
-    if(divKeys.count() == 0)
+    if(!found)
     {
-        return dividends;
+        return CalendarGrid();
     }
 
-    for (const int &key : divKeys)
-    {
-        QVector<QPair<int, double>> vector = dividends.value(key);
-
-        std::sort(vector.begin(), vector.end(),
-                  [] (QPair<int, double> &a, QPair<int, double> &b)
-                  {
-                      return a.first < b.first;
-                  }
-                  );
+    CalendarGrid grid(firstYear, lastYear, (tickers != nullptr) ? layers.count() : 1);
 
-        dividends[key] = vector;
+    for(const QVector<sCASHEVENT> &isinEvents : events)
+    {
+        for(const sCASHEVENT &event : isinEvents)
+        {
+            grid.add(event.date, event.price, (tickers != nullptr) ? layers.value(event.ticker) : 0);
+        }
     }
 
-    // Fill empty places between dates
-    QMutableMapIterator it(dividends);
+    return grid;
+}
 
-    while(it.hasNext())
-    {
-        it.next();
+MonthDividendDataType Calculation::getMonthDividendData(const QDate &from, const QDate &to)
+{
+    Q_ASSERT(stockData);
+    Q_ASSERT(database);
 
-        QVector<QPair<int, double>> vector = it.value();
+    const sCALCULATIONCONTEXT context = database->getCalculationContext();
 
-        for(quint8 m = 1; m<13; ++m)
-        {
-            auto found = std::find_if(vector.begin(), vector.end(), [m] (QPair<int, double> &a)
-                                      {
-                                          return m == a.first;
-                                      }
-                                      );
+    //    year              month  price
+    MonthDividendDataType dividends;
 
-            if(found == vector.end())
-            {
-                vector.insert(m-1, qMakePair(m, 0.0));
-            }
-        }
+    StockDataType stockList = stockData->getStockData();
 
-        it.value() = vector;
+    if(stockList.isEmpty())
+    {
+        return dividends;
     }
 
-    // Sort from min to max
-    divKeys = dividends.keys();
+    const CalendarGrid grid = getCalendar(getCashEvents(context, stockList, stockList.keys(), DIVIDEND, from, to));
 
-    if(divKeys.count() == 0)
+    if(grid.isEmpty())
     {
         return dividends;
     }
 
-    for (const int &key : divKeys)
+    for(int year = grid.getFirstYear(); year <= grid.getLastYear(); ++year)
     {
-        QVector<QPair<int, double>> vector = dividends.value(key);
+        if(!grid.isYearUsed(year)) continue;
+
+        const int base = (year - grid.getFirstYear())*12;
+        QVector<QPair<int, double>> vector;
+        vector.reserve(12);
 
-        std::sort(vector.begin(), vector.end(),
-                  [] (QPair<int, double> &a, QPair<int, double> &b)
-                  {
-                      return a.first < b.first;
-                  }
-                  );
+        for(int m = 1; m < 13; ++m)
+        {
+            vector.push_back(qMakePair(m, grid.getValue(base + m - 1)));
+        }
 
-        dividends[key] = vector;
+        dividends.insert(year, vector);
     }
 
     return dividends;
@@ -456,7 +739,8 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
 {
     Q_ASSERT(database);
 
-    QString currencySign = database->getCurrencySign(database->getSetting().currency);
+    const sCALCULATIONCONTEXT context = database->getCalculationContext();
+    QString currencySign = database->getCurrencySign(context.currency);
     QChart* chart = new QChart();
     chart->setAcceptHoverEvents(true);
 
@@ -464,7 +748,7 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
     {
         case DEPOSITCHART:
         {
-            QLineSeries *depositSeries = getDepositSeries(from, to);
+            QLineSeries *depositSeries = getDepositSeries(context, from, to);
 
             if(depositSeries == nullptr)
             {
@@ -536,7 +820,7 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
 
         case INVESTEDCHART:
         {
-            QLineSeries *investedSeries = getInvestedSeries(from, to);
+            QLineSeries *investedSeries = getInvestedSeries(context, from, to);
 
             if(investedSeries == nullptr)
             {
@@ -606,13 +890,11 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
         }
         break;
 
-        case DIVIDENDCHART:
+        case VALUECHART:
         {
-            QStringList categories;
-            double maxDividendAxis;
-            QBarSeries *dividendSeries = getDividendSeries(from, to, &categories, &maxDividendAxis);
+            QLineSeries *valueSeries = getValueSeries(context, from, to);
 
-            if(dividendSeries == nullptr)
+            if(valueSeries == nullptr)
             {
                 delete chart;
                 chart = nullptr;
@@ -620,11 +902,85 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
                 return nullptr;
             }
 
-            chart->addSeries(dividendSeries);
-            chart->setTitle("Brutto dividends");
-            chart->setAnimationOptions(QChart::SeriesAnimations);
+            chart->addSeries(valueSeries);
+            chart->legend()->hide();
+            chart->setTitle("Portfolio value");
+            chart->setTheme(QChart::ChartThemeQt);
 
-            QBarCategoryAxis *axisX = new QBarCategoryAxis();
+            QDateTimeAxis *valueAxisX = new QDateTimeAxis;
+            valueAxisX->setTickCount(10);
+
+            QPointF first = valueSeries->pointsVector().first();
+            QPointF last = valueSeries->pointsVector().last();
+
+            QDateTime firstDate = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(first.x()));
+            QDateTime lastDate = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(last.x()));
+
+            if(firstDate.date().year() == lastDate.date().year() && firstDate.date().month() == lastDate.date().month())
+            {
+                valueAxisX->setFormat("dd MMM yy");
+            }
+            else
+            {
+                valueAxisX->setFormat("MMM yyyy");
+            }
+
+            valueAxisX->setTitleText("Date");
+            chart->addAxis(valueAxisX, Qt::AlignBottom);
+            valueSeries->attachAxis(valueAxisX);
+
+            QValueAxis *valueAxisY = new QValueAxis;
+            valueAxisY->setLabelFormat("%i");
+            valueAxisY->setTitleText("Value " + currencySign);
+            chart->addAxis(valueAxisY, Qt::AlignLeft);
+            valueSeries->attachAxis(valueAxisY);
+
+
+            Callout *tooltip = new Callout(chart);
+
+            connect(valueSeries, &QLineSeries::hovered, [tooltip, chart](const QPointF &point, bool state) mutable
+                    {
+                        if (tooltip == nullptr)
+                        {
+                            tooltip = new Callout(chart);
+                        }
+
+                        if (state)
+                        {
+                            tooltip->setText(QString("X: %1 \nY: %L2 ").arg(QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(point.x())).toString("dd.MM.yyyy")).arg(point.y()));
+                            tooltip->setAnchor(point);
+                            tooltip->setZValue(11);
+                            tooltip->updateGeometry();
+                            tooltip->show();
+                        }
+                        else
+                        {
+                            tooltip->hide();
+                        }
+                    }
+                    );
+        }
+        break;
+
+        case DIVIDENDCHART:
+        {
+            QStringList categories;
+            double maxDividendAxis;
+            QBarSeries *dividendSeries = getDividendSeries(context, from, to, &categories, &maxDividendAxis);
+
+            if(dividendSeries == nullptr)
+            {
+                delete chart;
+                chart = nullptr;
+
+                return nullptr;
+            }
+
+            chart->addSeries(dividendSeries);
+            chart->setTitle("Brutto dividends");
+            chart->setAnimationOptions(QChart::SeriesAnimations);
+
+            QBarCategoryAxis *axisX = new QBarCategoryAxis();
             axisX->append(categories);
             chart->addAxis(axisX, Qt::AlignBottom);
             dividendSeries->attachAxis(axisX);
@@ -646,7 +1002,7 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
         {
             QStringList categories;
             double maxDividendAxis;
-            QStackedBarSeries *dividendSeries = getMonthDividendSeries(from, to, &categories, &maxDividendAxis);
+            QStackedBarSeries *dividendSeries = getMonthDividendSeries(context, from, to, &categories, &maxDividendAxis);
 
             if(dividendSeries == nullptr)
             {
@@ -706,7 +1062,7 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
         {
             QStringList categories;
             double maxDividendAxis;
-            QBarSeries *dividendSeries = getMonthCompareDividendSeries(from, to, &categories, &maxDividendAxis);
+            QBarSeries *dividendSeries = getMonthCompareDividendSeries(context, from, to, &categories, &maxDividendAxis);
 
             if(dividendSeries == nullptr)
             {
@@ -765,7 +1121,7 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
         {
             QStringList categories;
             double maxDividendAxis;
-            QStackedBarSeries  *yearDividendSeries = getYearDividendSeries(from, to, &categories, &maxDividendAxis);
+            QStackedBarSeries  *yearDividendSeries = getYearDividendSeries(context, from, to, &categories, &maxDividendAxis);
 
             if(yearDividendSeries == nullptr)
             {
@@ -822,10 +1178,28 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
         break;
 
         case SECTORCHART:
+        case STOCKCHART:
+        case INDUSTRYCHART:
+        case COUNTRYCHART:
+        case CURRENCYCHART:
+        case BROKERCHART:
         {
-            QPieSeries *sectorSeries = getSectorSeries(from, to);
+            eGROUPDIMENSION dimension = SECTORDIMENSION;
+            QString title = "Sectors";
+
+            switch(type)
+            {
+                case STOCKCHART: dimension = TICKERDIMENSION; title = "Stocks"; break;
+                case INDUSTRYCHART: dimension = INDUSTRYDIMENSION; title = "Industries"; break;
+                case COUNTRYCHART: dimension = COUNTRYDIMENSION; title = "Countries"; break;
+                case CURRENCYCHART: dimension = CURRENCYDIMENSION; title = "Currencies"; break;
+                case BROKERCHART: dimension = BROKERDIMENSION; title = "Brokers"; break;
+                default: break;
+            }
 
-            if(sectorSeries == nullptr)
+            QPieSeries *groupSeries = getGroupSeries(context, from, to, dimension);
+
+            if(groupSeries == nullptr)
             {
                 delete chart;
                 chart = nullptr;
@@ -833,17 +1207,18 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
                 return nullptr;
             }
 
-            chart->addSeries(sectorSeries);
-            chart->setTitle("Sectors");
+            chart->addSeries(groupSeries);
+            chart->setTitle(title);
             chart->legend()->hide();
         }
         break;
 
-        case STOCKCHART:
+        case RISKCHART:
         {
-            QPieSeries *stockSeries = getStockSeries(from, to);
+            QLineSeries *volatilitySeries = nullptr;
+            QLineSeries *drawdownSeries = nullptr;
 
-            if(stockSeries == nullptr)
+            if(!getRiskSeries(context, from, to, &volatilitySeries, &drawdownSeries))
             {
                 delete chart;
                 chart = nullptr;
@@ -851,17 +1226,42 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
                 return nullptr;
             }
 
-            chart->addSeries(stockSeries);
-            chart->setTitle("Stocks");
-            chart->legend()->hide();
+            chart->addSeries(volatilitySeries);
+            chart->addSeries(drawdownSeries);
+            chart->setTitle("Rolling risk");
+            chart->setTheme(QChart::ChartThemeQt);
+
+            QDateTimeAxis *riskAxisX = new QDateTimeAxis;
+            riskAxisX->setTickCount(10);
+            riskAxisX->setFormat("MMM yyyy");
+            riskAxisX->setTitleText("Date");
+            chart->addAxis(riskAxisX, Qt::AlignBottom);
+            volatilitySeries->attachAxis(riskAxisX);
+            drawdownSeries->attachAxis(riskAxisX);
+
+            QValueAxis *riskAxisY = new QValueAxis;
+            riskAxisY->setLabelFormat("%.1f");
+            riskAxisY->setTitleText("%");
+            chart->addAxis(riskAxisY, Qt::AlignLeft);
+            volatilitySeries->attachAxis(riskAxisY);
+            drawdownSeries->attachAxis(riskAxisY);
         }
         break;
 
+        case CORRELATIONCHART:
+        {
+            // Not a chart, shown as a heatmap by the caller
+            delete chart;
+            chart = nullptr;
+
+            return nullptr;
+        }
+
         case ISINCHART:
         {
             QStringList categories;
             double maxDividendAxis;
-            QBarSeries *dividendSeries = getDividendSeries(from, to, &categories, &maxDividendAxis, ISIN);
+            QBarSeries *dividendSeries = getDividendSeries(context, from, to, &categories, &maxDividendAxis, ISIN);
 
             if(dividendSeries == nullptr)
             {
@@ -893,7 +1293,7 @@ QChart *Calculation::getChart(const eCHARTTYPE &type, const QDate &from, const Q
     return chart;
 }
 
-QLineSeries* Calculation::getDepositSeries(const QDate &from, const QDate &to)
+QLineSeries* Calculation::getDepositSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to)
 {
     Q_ASSERT(stockData);
     Q_ASSERT(database);
@@ -915,11 +1315,11 @@ QLineSeries* Calculation::getDepositSeries(const QDate &from, const QDate &to)
         {
             if( !(stock.dateTime.date() >= from && stock.dateTime.date() <= to) ) continue;
 
-            if( stock.stockName.toLower().contains("fundshare") ) continue;
+            if( stock.flags & EXCLUDEDFLAG ) continue;
 
             if(stock.type == DEPOSIT)
             {
-                deposit += database->getExchangePrice(stock.currency, stock.price);
+                deposit += context.toSelected(stock.currency, stock.price);
                 depositSeries->append(stock.dateTime.toMSecsSinceEpoch(), deposit);
             }
         }
@@ -954,7 +1354,7 @@ QLineSeries* Calculation::getDepositSeries(const QDate &from, const QDate &to)
     return depositSeries;
 }
 
-QLineSeries* Calculation::getInvestedSeries(const QDate &from, const QDate &to)
+QLineSeries* Calculation::getInvestedSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to)
 {
     Q_ASSERT(stockData);
     Q_ASSERT(database);
@@ -976,11 +1376,11 @@ QLineSeries* Calculation::getInvestedSeries(const QDate &from, const QDate &to)
         {
             if( !(stock.dateTime.date() >= from && stock.dateTime.date() <= to) ) continue;
 
-            if( stock.stockName.toLower().contains("fundshare") ) continue;
+            if( stock.flags & EXCLUDEDFLAG ) continue;
 
             if(stock.type == BUY)
             {
-                invested += database->getExchangePrice(stock.currency, (-1.0)*stock.price) * stock.count;
+                invested += context.toSelected(stock.currency, (-1.0)*stock.price) * stock.count;
                 investedSeries->append(stock.dateTime.toMSecsSinceEpoch(), invested);
             }
         }
@@ -1015,254 +1415,211 @@ QLineSeries* Calculation::getInvestedSeries(const QDate &from, const QDate &to)
     return investedSeries;
 }
 
-QBarSeries* Calculation::getDividendSeries(const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis, const QString &ISIN)
+QLineSeries* Calculation::getValueSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to)
 {
     Q_ASSERT(stockData);
     Q_ASSERT(database);
 
-    StockDataType stockList = stockData->getStockData();
+    const StockDataSnapshot snapshot = stockData->getSnapshot();
+    const StockDataType &stockList = *snapshot;
 
     if(stockList.isEmpty())
     {
         return nullptr;
     }
 
-    QHash<QString, QVector<QPair<QDate, double>> > dividends;
-    double maxDividendAxis = 0.0;
-    QList<QString> keys = stockList.keys();
+    updateNavSeries(context, stockList);
 
-    if(!ISIN.isEmpty())
-    {
-        keys.clear();
-        keys << ISIN;
-    }
+    const QVector<QPair<QDate, double>> values = navSeries.getSeries(from, to);
 
-    for(const QString &key : keys)
-    {
-        for(const sSTOCKDATA &stock : stockList.value(key))
-        {
-            if( !(stock.dateTime.date() >= from && stock.dateTime.date() <= to) ) continue;
-
-            if( stock.stockName.toLower().contains("fundshare") ) continue;
-
-            if(stock.type == DIVIDEND)
-            {
-                double price = 0.0;
-
-                price = database->getExchangePrice(stock.currency, stock.price);
-
-                if(price > maxDividendAxis)
-                {
-                    maxDividendAxis = price;
-                }
-
-                QString ticker = stock.ticker;
-                QDate date = stock.dateTime.date();
-
-                QVector<QPair<QDate, double>> vector = dividends.value(ticker);
-
-                if(ISIN.isEmpty())  // we are in DIVIDENDCHART mode, just add new record to the vector
-                {
-                    vector.push_back(qMakePair(date, price));
-                }
-                else    // We are in the ISINCHART mode, sum the dividends within a year
-                {
-                    auto it = std::find_if(vector.begin(), vector.end(), [date](QPair<QDate, double> a)
-                                           {
-                                               return date.year() == a.first.year();
-                                           }
-                                           );
-
-                    if(it != vector.end())  // we need to sum
-                    {
-                        it->second += price;
-
-                        if(it->second > maxDividendAxis)
-                        {
-                            maxDividendAxis = it->second;
-                        }
-                    }
-                    else                    // create new record, because we have found new year
-                    {
-                        vector.push_back(qMakePair(date, price));
-                    }
-                }
-
-                dividends.insert(ticker, vector);
-            }
-        }
-    }
-
-
-    // Sort from min to max and find the min and max
-    QDate min;
-    QDate max;
-
-    QList<QString> divKeys = dividends.keys();
-
-    if(divKeys.count() == 0)
+    if(values.isEmpty())
     {
         return nullptr;
     }
 
-    min = dividends.value(divKeys.first()).first().first;
-    max = dividends.value(divKeys.first()).first().first;
+    QLineSeries *valueSeries = new QLineSeries();
+    QVector<QPointF> points;
+    points.reserve(values.count());
 
-    for (const QString &key : divKeys)
+    for(const QPair<QDate, double> &value : values)
     {
-        auto vector = dividends.value(key);
-
-        std::sort(vector.begin(), vector.end(),
-                  [] (QPair<QDate, double> &a, QPair<QDate, double> &b)
-                  {
-                      return a.first < b.first;
-                  }
-                  );
+        points.push_back(QPointF(QDateTime(value.first, QTime(0, 0, 0)).toMSecsSinceEpoch(), value.second));
+    }
 
-        dividends[key] = vector;
+    valueSeries->replace(points);
 
-        QDate localMin = vector.first().first;
-        QDate localMax = vector.last().first;
+    return valueSeries;
+}
 
-        if(localMin < min)
-        {
-            min = localMin;
-        }
+void Calculation::updateNavSeries(const sCALCULATIONCONTEXT &context, const StockDataType &stockList)
+{
+    // Current online prices, they are used for today only
+    QHash<QString, double> quotes;
+    const QList<QString> keys = stockList.keys();
+    const QVector<double> prices = stockData->getPrices(keys);
 
-        if(localMax > max)
+    for(int i = 0; i < keys.count(); ++i)
+    {
+        if(!std::isnan(prices.at(i)))
         {
-            max = localMax;
+            quotes.insert(keys.at(i), prices.at(i));
         }
     }
 
+    navSeries.update(stockList, quotes, stockData->getPriceHistory(), getRates(context));
+}
 
-    // Save categories - find all months between min and max date
-    QStringList categories;
-    QDate tmpMin = min;
-    QVector<QDate> dates;
+QVector<double> Calculation::getRates(const sCALCULATIONCONTEXT &context)
+{
+    QVector<double> rates;
 
-    if(ISIN.isEmpty())
+    for(int currency = CZK; currency <= CAD; ++currency)
     {
-        while(tmpMin <= max)
-        {
-            QLocale locale;
-            QString month = locale.toString(tmpMin, "MMM") + " " + QString::number(tmpMin.year()-2000);
-            month = month.left(1).toUpper() + month.mid(1);     // first char to upper
+        rates.push_back(context.rates[currency][context.currency]);
+    }
 
-            categories << month;
-            dates.push_back(tmpMin);
+    return rates;
+}
 
-            tmpMin = tmpMin.addMonths(1);
-        }
-    }
-    else
+QMap<QDate, double> Calculation::getTradeFlows(const sCALCULATIONCONTEXT &context, const StockDataType &stockList, const QDate &from, const QDate &to)
+{
+    QMap<QDate, double> tradeFlows;
+
+    for(auto it = stockList.cbegin(); it != stockList.cend(); ++it)
     {
-        while(tmpMin.year() <= max.year())
+        for(const sSTOCKDATA &stock : it.value())
         {
-            QString year = tmpMin.toString("yyyy");
+            const QDate date = stock.dateTime.date();
 
-            categories << year;
-            dates.push_back(tmpMin);
+            if( !(date >= from && date <= to) || (stock.flags & EXCLUDEDFLAG) ) continue;
 
-            tmpMin = tmpMin.addYears(1);
+            if(stock.type == BUY)
+            {
+                tradeFlows[date] += context.toSelected(stock.currency, std::abs(stock.price) * stock.count);
+            }
+            else if(stock.type == SELL)
+            {
+                tradeFlows[date] -= context.toSelected(stock.currency, std::abs(stock.price) * stock.count);
+            }
         }
     }
 
+    return tradeFlows;
+}
 
-    // Fill empty places between dates
-    QMutableHashIterator it(dividends);
+double Calculation::getBeta(const sCALCULATIONCONTEXT &context, const StockDataType &stockList, const QDate &from, const QDate &to)
+{
+    const QList<QString> keys = stockList.keys();
+    const QVector<double> prices = stockData->getPrices(keys);
+    const QVector<double> betas = stockData->getQuotes(keys, BETAQUOTE);
 
-    while(it.hasNext())
-    {
-        it.next();
+    portfolioState.update(stockList);
+    const QHash<QString, int> counts = portfolioState.getCounts(from, to);
 
-        tmpMin = min;
+    double weightedBeta = 0.0;
+    double total = 0.0;
 
-        auto vector = it.value();
+    for(int i = 0; i < keys.count(); ++i)
+    {
+        const QVector<sSTOCKDATA> values = stockList.value(keys.at(i));
+        const int totalCount = counts.value(keys.at(i));
 
-        for(const QDate &d : dates)
-        {
-            auto found = std::find_if(vector.begin(), vector.end(), [d] (QPair<QDate, double> &a)
-                                      {
-                                          //return d.month() == a.first.month();
-                                          return d.month() == a.first.month() && d.year() == a.first.year();
-                                      }
-                                      );
+        if(values.isEmpty() || (values.first().flags & EXCLUDEDFLAG) || totalCount <= 0) continue;
 
-            if(found == vector.end())
-            {
-                int index = dates.indexOf(d);
-                vector.insert(index, qMakePair(d, 0.0));
-            }
-        }
+        if(std::isnan(prices.at(i)) || std::isnan(betas.at(i))) continue;
+
+        const double value = context.toSelected(values.first().currency, prices.at(i)) * totalCount;
 
-        it.value() = vector;
+        weightedBeta += value * betas.at(i);
+        total += value;
     }
 
+    return (total > 0.0) ? weightedBeta / total : std::numeric_limits<double>::quiet_NaN();
+}
 
-    // Sort from min to max and find the min and max
-    divKeys = dividends.keys();
+bool Calculation::getRiskSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, QLineSeries **volatilitySeries, QLineSeries **drawdownSeries)
+{
+    Q_ASSERT(stockData);
 
-    if(divKeys.count() == 0)
-    {
-        return nullptr;
-    }
+    const StockDataSnapshot snapshot = stockData->getSnapshot();
+    const StockDataType &stockList = *snapshot;
 
-    for (const QString &key : divKeys)
+    if(stockList.isEmpty())
     {
-        auto vector = dividends.value(key);
+        return false;
+    }
 
-        std::sort(vector.begin(), vector.end(),
-                  [] (QPair<QDate, double> &a, QPair<QDate, double> &b)
-                  {
-                      return a.first < b.first;
-                  }
-                  );
+    updateNavSeries(context, stockList);
 
-        dividends[key] = vector;
-    }
+    quint64 generation;
+    const QVector<QPair<QDate, double>> values = navSeries.getSeries(from.addDays(-1), to, &generation);
 
+    const std::shared_ptr<RiskMetrics> metrics = getRiskMetrics(from, to);
+    metrics->update(generation, values, getTradeFlows(context, stockList, from, to));
 
-    // Set all sets, ticker and date
-    QVector<QBarSet*> dividendsSets;
-    divKeys = dividends.keys();
+    const QVector<QPair<QDate, sRISKMETRICS>> rolling = metrics->getRolling();
 
-    for (const QString &key : divKeys)
+    if(rolling.isEmpty())
     {
-        QBarSet *bar = new QBarSet(key);
+        return false;
+    }
+
+    QVector<QPointF> volatilityPoints;
+    QVector<QPointF> drawdownPoints;
+    volatilityPoints.reserve(rolling.count());
+    drawdownPoints.reserve(rolling.count());
 
-        auto vector = dividends.value(key);
+    for(const QPair<QDate, sRISKMETRICS> &day : rolling)
+    {
+        const qreal x = QDateTime(day.first, QTime(0, 0, 0)).toMSecsSinceEpoch();
 
-        for (const QPair<QDate, double> &v : vector)
+        if(!std::isnan(day.second.volatility))
         {
-            bar->append(v.second);
+            volatilityPoints.push_back(QPointF(x, day.second.volatility));
         }
 
-        dividendsSets.push_back(bar);
+        drawdownPoints.push_back(QPointF(x, -day.second.maxDrawdown));
     }
 
+    *volatilitySeries = new QLineSeries();
+    (*volatilitySeries)->setName(QString("Volatility (%1 days)").arg(metrics->getWindow()));
+    (*volatilitySeries)->replace(volatilityPoints);
 
-    QBarSeries *dividendSeries = new QBarSeries();
+    *drawdownSeries = new QLineSeries();
+    (*drawdownSeries)->setName(QString("Drawdown (%1 days)").arg(metrics->getWindow()));
+    (*drawdownSeries)->replace(drawdownPoints);
 
-    for(QBarSet *set : dividendsSets)
-    {
-        dividendSeries->append(set);
-    }
+    return true;
+}
 
-    if(xAxis != nullptr)
+std::shared_ptr<RiskMetrics> Calculation::getRiskMetrics(const QDate &from, const QDate &to)
+{
+    QMutexLocker locker(&riskMetricsMutex);
+
+    const QString key = QString("%1|%2").arg(from.toString(Qt::ISODate), to.toString(Qt::ISODate));
+
+    auto it = riskMetrics.find(key);
+
+    if(it != riskMetrics.end())
     {
-        *xAxis = categories;
+        riskMetricsOrder.removeOne(key);
+        riskMetricsOrder.push_back(key);
+
+        return it.value();
     }
 
-    if(maxYAxis != nullptr)
+    // The dropped accumulators stay alive while a running query holds them
+    if(riskMetricsOrder.count() >= RISKMETRICSRANGES)
     {
-        *maxYAxis = maxDividendAxis;
+        riskMetrics.remove(riskMetricsOrder.takeFirst());
     }
 
-    return dividendSeries;
+    riskMetricsOrder.push_back(key);
+
+    return *riskMetrics.insert(key, std::make_shared<RiskMetrics>());
 }
 
-QStackedBarSeries* Calculation::getMonthDividendSeries(const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis)
+QBarSeries* Calculation::getDividendSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis, const QString &ISIN)
 {
     Q_ASSERT(stockData);
     Q_ASSERT(database);
@@ -1274,165 +1631,145 @@ QStackedBarSeries* Calculation::getMonthDividendSeries(const QDate &from, const
         return nullptr;
     }
 
-    QHash<QString, QVector<QPair<QDate, double>> > dividends;
     QList<QString> keys = stockList.keys();
 
-    for(const QString &key : keys)
+    if(!ISIN.isEmpty())
     {
-        for(const sSTOCKDATA &stock : stockList.value(key))
-        {
-            if( !(stock.dateTime.date() >= from && stock.dateTime.date() <= to) ) continue;
-
-            if( stock.stockName.toLower().contains("fundshare") ) continue;
-
-            if(stock.type == DIVIDEND)
-            {
-                double price = 0.0;
-
-                price = database->getExchangePrice(stock.currency, stock.price);
-
-                QString ticker = stock.ticker;
-                QDate date = stock.dateTime.date();
-
-                QVector<QPair<QDate, double>> vector = dividends.value(ticker);
-
-                vector.push_back(qMakePair(date, price));
-
-                dividends.insert(ticker, vector);
-            }
-        }
+        keys.clear();
+        keys << ISIN;
     }
 
-    // Sort from min to max and find the min and max
-    QDate min;
-    QDate max;
+    QStringList tickers;
+    const CalendarGrid grid = getCalendar(getCashEvents(context, stockList, keys, DIVIDEND, from, to), &tickers);
 
-    QList<QString> divKeys = dividends.keys();
-
-    if(divKeys.count() == 0)
+    if(grid.isEmpty())
     {
         return nullptr;
     }
 
-    min = dividends.value(divKeys.first()).first().first;
-    max = dividends.value(divKeys.first()).first().first;
+    QStringList categories;
+    QVector<QBarSet*> dividendsSets;
+    double maxDividendAxis = 0.0;
 
-    for (const QString &key : divKeys)
+    if(ISIN.isEmpty())  // we are in DIVIDENDCHART mode, one bar per month
     {
-        auto vector = dividends.value(key);
-
-        std::sort(vector.begin(), vector.end(),
-                  [] (QPair<QDate, double> &a, QPair<QDate, double> &b)
-                  {
-                      return a.first < b.first;
-                  }
-                  );
-
-        dividends[key] = vector;
-
-        QDate localMin = vector.first().first;
-        QDate localMax = vector.last().first;
+        dividendsSets = getMonthBarSets(grid, tickers, &categories);
 
-        if(localMin < min)
+        for(QBarSet *set : qAsConst(dividendsSets))
         {
-            min = localMin;
+            for(int i = 0; i < set->count(); ++i)
+            {
+                maxDividendAxis = qMax(maxDividendAxis, set->at(i));
+            }
         }
+    }
+    else    // We are in the ISINCHART mode, sum the dividends within a year
+    {
+        const int firstYear = grid.getFirstYear() + grid.getFirstUsed()/12;
+        const int lastYear = grid.getFirstYear() + grid.getLastUsed()/12;
 
-        if(localMax > max)
+        for(int year = firstYear; year <= lastYear; ++year)
         {
-            max = localMax;
+            categories << QString::number(year);
         }
-    }
 
-    // Save categories - find all months between min and max date
-    QStringList categories;
-    QDate tmpMin = min;
-    QVector<QDate> dates;
+        for(int layer = 0; layer < grid.getLayerCount(); ++layer)
+        {
+            const QVector<double> years = grid.getYearTotals(layer);
+            QBarSet *bar = new QBarSet(tickers.at(layer));
 
-    while(tmpMin <= max)
-    {
-        QLocale locale;
-        QString month = locale.toString(tmpMin, "MMM") + " " + QString::number(tmpMin.year()-2000);
-        month = month.left(1).toUpper() + month.mid(1);     // first char to upper
+            for(int year = firstYear; year <= lastYear; ++year)
+            {
+                const double value = years.at(year - grid.getFirstYear());
 
-        categories << month;
-        dates.push_back(tmpMin);
+                bar->append(value);
+                maxDividendAxis = qMax(maxDividendAxis, value);
+            }
 
-        tmpMin = tmpMin.addMonths(1);
+            dividendsSets.push_back(bar);
+        }
     }
 
 
-    // Fill empty places between dates
-    QMutableHashIterator it(dividends);
+    QBarSeries *dividendSeries = new QBarSeries();
 
-    while(it.hasNext())
+    for(QBarSet *set : dividendsSets)
     {
-        it.next();
+        dividendSeries->append(set);
+    }
 
-        tmpMin = min;
+    if(xAxis != nullptr)
+    {
+        *xAxis = categories;
+    }
 
-        auto vector = it.value();
+    if(maxYAxis != nullptr)
+    {
+        *maxYAxis = maxDividendAxis;
+    }
 
-        for(const QDate &d : dates)
-        {
-            auto found = std::find_if(vector.begin(), vector.end(), [d] (QPair<QDate, double> &a)
-                                      {
-                                          return d.month() == a.first.month() && d.year() == a.first.year();
-                                      }
-                                      );
+    return dividendSeries;
+}
 
-            if(found == vector.end())
-            {
-                int index = dates.indexOf(d);
-                vector.insert(index, qMakePair(d, 0.0));
-            }
-        }
+QVector<QBarSet*> Calculation::getMonthBarSets(const CalendarGrid &grid, const QStringList &tickers, QStringList *categories)
+{
+    const int first = grid.getFirstUsed();
+    const int last = grid.getLastUsed();
 
-        it.value() = vector;
-    }
+    // Save categories - all months between the first and the last dividend
+    QLocale locale;
 
+    for(int index = first; index <= last; ++index)
+    {
+        const QDate date = grid.getMonthDate(index);
 
-    // Sort from min to max
-    divKeys = dividends.keys();
+        QString month = locale.toString(date, "MMM") + " " + QString::number(date.year()-2000);
+        month = month.left(1).toUpper() + month.mid(1);     // first char to upper
 
-    if(divKeys.count() == 0)
-    {
-        return nullptr;
+        *categories << month;
     }
 
-    for (const QString &key : divKeys)
+    // Each layer is already a contiguous run of months
+    QVector<QBarSet*> sets;
+
+    for(int layer = 0; layer < grid.getLayerCount(); ++layer)
     {
-        auto vector = dividends.value(key);
+        QBarSet *bar = new QBarSet(tickers.at(layer));
+        const double *values = grid.getLayer(layer);
 
-        std::sort(vector.begin(), vector.end(),
-                  [] (QPair<QDate, double> &a, QPair<QDate, double> &b)
-                  {
-                      return a.first < b.first;
-                  }
-                  );
+        for(int index = first; index <= last; ++index)
+        {
+            bar->append(values[index]);
+        }
 
-        dividends[key] = vector;
+        sets.push_back(bar);
     }
 
+    return sets;
+}
 
-    // Set all sets, tickers and dates
-    QVector<QBarSet*> dividendsSets;
-    divKeys = dividends.keys();
+QStackedBarSeries* Calculation::getMonthDividendSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis)
+{
+    Q_ASSERT(stockData);
+    Q_ASSERT(database);
 
-    for (const QString &key : divKeys)
-    {
-        QBarSet *bar = new QBarSet(key);
+    StockDataType stockList = stockData->getStockData();
 
-        auto vector = dividends.value(key);
+    if(stockList.isEmpty())
+    {
+        return nullptr;
+    }
 
-        for (const QPair<QDate, double> &v : vector)
-        {
-            bar->append(v.second);
-        }
+    QStringList tickers;
+    const CalendarGrid grid = getCalendar(getCashEvents(context, stockList, stockList.keys(), DIVIDEND, from, to), &tickers);
 
-        dividendsSets.push_back(bar);
+    if(grid.isEmpty())
+    {
+        return nullptr;
     }
 
+    QStringList categories;
+    const QVector<QBarSet*> dividendsSets = getMonthBarSets(grid, tickers, &categories);
 
     QStackedBarSeries *dividendSeries = new QStackedBarSeries();
     double maxDividendAxis = 0.0;
@@ -1463,19 +1800,28 @@ QStackedBarSeries* Calculation::getMonthDividendSeries(const QDate &from, const
     return dividendSeries;
 }
 
-QBarSeries* Calculation::getMonthCompareDividendSeries(const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis)
+QBarSeries* Calculation::getMonthCompareDividendSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis)
 {
-    MonthDividendDataType dividends = getMonthDividendData(from, to);
+    Q_ASSERT(stockData);
+    Q_ASSERT(database);
 
-    if(dividends.isEmpty())
+    StockDataType stockList = stockData->getStockData();
+
+    if(stockList.isEmpty())
     {
         return nullptr;
     }
 
-    // Save categories - find all months between min and max date
+    const CalendarGrid grid = getCalendar(getCashEvents(context, stockList, stockList.keys(), DIVIDEND, from, to));
+
+    if(grid.isEmpty())
+    {
+        return nullptr;
+    }
+
+    // Save categories - all months of a year
     QStringList categories;
     QDate tmpMonth = QDate(2020, 1, 1);
-    QVector<QDate> dates;
 
     for(quint8 m = 1; m < 13; ++m)
     {
@@ -1488,33 +1834,26 @@ QBarSeries* Calculation::getMonthCompareDividendSeries(const QDate &from, const
         tmpMonth = tmpMonth.addMonths(1);
     }
 
-    // Set all sets, tickers and dates
-    QVector<QBarSet*> dividendsSets;
-    QList<int> divKeys = dividends.keys();
+    // One set per year, the year is the row of the grid
+    QBarSeries *dividendSeries = new QBarSeries();
+    double maxDividendAxis = 0.0;
+    const double *values = grid.getLayer(0);
 
-    for (const int &key : divKeys)
+    for(int year = grid.getFirstYear(); year <= grid.getLastYear(); ++year)
     {
-        QBarSet *bar = new QBarSet(QString::number(key));
+        if(!grid.isYearUsed(year)) continue;
 
-        auto vector = dividends.value(key);
+        QBarSet *bar = new QBarSet(QString::number(year));
+        const int base = (year - grid.getFirstYear())*12;
 
-        for (const QPair<int, double> &v : vector)
+        for(int m = 0; m < 12; ++m)
         {
-            bar->append(v.second);
+            bar->append(values[base + m]);
         }
 
-        dividendsSets.push_back(bar);
-    }
-
-
-    QBarSeries *dividendSeries = new QBarSeries();
-    double maxDividendAxis = 0.0;
-
-    for(QBarSet *set : dividendsSets)
-    {
-        dividendSeries->append(set);
+        dividendSeries->append(bar);
 
-        qreal sum = set->sum();
+        qreal sum = bar->sum();
 
         if(sum > maxDividendAxis)
         {
@@ -1536,7 +1875,7 @@ QBarSeries* Calculation::getMonthCompareDividendSeries(const QDate &from, const
     return dividendSeries;
 }
 
-QStackedBarSeries* Calculation::getYearDividendSeries(const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis)
+QStackedBarSeries* Calculation::getYearDividendSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis)
 {
     Q_ASSERT(stockData);
     Q_ASSERT(database);
@@ -1548,182 +1887,325 @@ QStackedBarSeries* Calculation::getYearDividendSeries(const QDate &from, const Q
         return nullptr;
     }
 
+    const CalendarGrid grid = getCalendar(getCashEvents(context, stockList, stockList.keys(), DIVIDEND, from, to));
 
-    QVector<QPair<double, int> > dividends;     // price, year
-    double maxDividendAxis = 0.0;
-    QList<QString> keys = stockList.keys();
-
-    for(const QString &key : keys)
+    if(grid.isEmpty())
     {
-        for(const sSTOCKDATA &stock : stockList.value(key))
-        {
-            if( !(stock.dateTime.date() >= from && stock.dateTime.date() <= to) ) continue;
+        return nullptr;
+    }
 
-            if( stock.stockName.toLower().contains("fundshare") ) continue;
+    const QVector<double> years = grid.getYearTotals();
+    const int yearMin = grid.getFirstYear();
+    const int yearMax = grid.getLastYear();
+    double maxDividendAxis = 0.0;
 
-            if(stock.type == DIVIDEND)
-            {
-                double price = 0.0;
+    // Set all sets, one per year with dividends; the categories cover every year of the range so the bars line up
+    QStringList categories;
+    QStackedBarSeries *dividendSeries = new QStackedBarSeries();
 
-                price = database->getExchangePrice(stock.currency, stock.price);
+    for(int year = yearMin; year <= yearMax; ++year)
+    {
+        categories << QString::number(year);
 
-                if(price > maxDividendAxis)
-                {
-                    maxDividendAxis = price;
-                }
+        if(!grid.isYearUsed(year)) continue;
 
-                QString ticker = stock.ticker;
-                QDate date = stock.dateTime.date();
+        const double total = years.at(year - yearMin);
+        QBarSet *bar = new QBarSet(QString::number(year));
 
+        for(int a = yearMin; a < yearMax+1; ++a)
+        {
+            bar->append((a == year) ? total : 0.0);
+        }
 
-                auto it = std::find_if(dividends.begin(), dividends.end(), [date](QPair<double, int> a)
-                                       {
-                                           return date.year() == a.second;
-                                       }
-                                       );
+        maxDividendAxis = qMax(maxDividendAxis, total);
 
-                if(it != dividends.end())  // we need to sum
-                {
-                    it->first += price;
+        dividendSeries->append(bar);
+    }
 
-                    if(it->first > maxDividendAxis)
-                    {
-                        maxDividendAxis = it->first;
-                    }
-                }
-                else                    // create new record, because we have found new year
-                {
-                    dividends.push_back(qMakePair(price, date.year()));
-                }
-            }
-        }
+    if(xAxis != nullptr)
+    {
+        *xAxis = categories;
     }
 
-    if(dividends.count() == 0)
+    if(maxYAxis != nullptr)
     {
-        return nullptr;
+        *maxYAxis = maxDividendAxis;
     }
 
-    std::sort(dividends.begin(), dividends.end(),
-              [] (QPair<double, int> &a, QPair<double, int> &b)
-              {
-                  return a.second < b.second;
-              }
-              );
+    return dividendSeries;
+}
 
-    int yearMin = dividends.first().second;
-    int yearMax = dividends.last().second;
+AggregationCube Calculation::getCube(const QDate &from, const QDate &to, const QVector<eGROUPDIMENSION> &dimensions, const eTIMEBUCKET &bucket)
+{
+    Q_ASSERT(database);
 
-    // Set all sets, ticker and date
-    QStringList categories;
-    QStackedBarSeries *dividendSeries = new QStackedBarSeries();
+    return getCube(database->getCalculationContext(), from, to, dimensions, bucket);
+}
+
+AggregationCube Calculation::getCube(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, const QVector<eGROUPDIMENSION> &dimensions, const eTIMEBUCKET &bucket)
+{
+    Q_ASSERT(stockData);
+    Q_ASSERT(database);
+
+    quint64 generation;
+    const StockDataSnapshot snapshot = stockData->getSnapshot(&generation);
+    const StockDataType &stockList = *snapshot;
 
-    for (const QPair<double, int> &key : dividends)
+    QList<QString> isinList = stockList.keys();
+    std::sort(isinList.begin(), isinList.end());
+
+    // Attributes of the securities, the same positions as the overview table
+    QVector<sSECURITYATTRIBUTES> securities;
+    QList<QString> securityISINs;
+    QVector<eCURRENCY> currencies;
+
+    const QStringList countries = stockData->getCountries(isinList);
+
+    for(int i = 0; i < isinList.count(); ++i)
     {
-        QBarSet *bar = new QBarSet(QString::number(key.second));
+        const QString &ISIN = isinList.at(i);
+        const QVector<sSTOCKDATA> values = stockList.value(ISIN);
+
+        auto stock = std::find_if(values.cbegin(), values.cend(), [](const sSTOCKDATA &data)
+                     {
+                         return data.type == BUY;
+                     });
+
+        if( ISIN.isEmpty() || stock == values.cend() || (stock->flags & EXCLUDEDFLAG) ) continue;
+
+        sSECURITYATTRIBUTES security;
+        security.values[TICKERDIMENSION] = stock->ticker;
+        security.values[COUNTRYDIMENSION] = countries.at(i);
+        security.values[CURRENCYDIMENSION] = database->getCurrencyText(stock->currency);
+        security.values[BROKERDIMENSION] = database->getSourceText(stock->source);
+
+        auto isinData = context.isins.constFind(ISIN);
 
-        for(int a = yearMin; a<yearMax+1; ++a)
+        if(isinData != context.isins.cend())
         {
-            if(a == key.second)
-            {
-                bar->append(key.first);
-            }
-            else
-            {
-                bar->append(0);
-            }
+            security.values[SECTORDIMENSION] = isinData->sector;
+            security.values[INDUSTRYDIMENSION] = isinData->industry;
         }
 
-        categories << QString::number(key.second);
+        securities.push_back(security);
+        securityISINs.push_back(ISIN);
+        currencies.push_back(stock->currency);
+    }
 
-        dividendSeries->append(bar);
+    const QVector<double> prices = stockData->getPrices(securityISINs);
+
+    // The transactions and the settings are identified by the generation and the version, the rest by its content
+    uint fingerprint = 0;
+
+    for(const sSECURITYATTRIBUTES &security : qAsConst(securities))
+    {
+        for(int dimension = 0; dimension < DIMENSIONCOUNT; ++dimension)
+        {
+            fingerprint = qHash(security.values[dimension], fingerprint);
+        }
     }
 
-    if(xAxis != nullptr)
+    for(const double &price : prices)
     {
-        *xAxis = categories;
+        fingerprint = qHashBits(&price, sizeof(price), fingerprint);
     }
 
-    if(maxYAxis != nullptr)
+    sAGGREGATIONSOURCE source;
+    source.generation = generation;
+    source.version = context.version;
+    source.fingerprint = fingerprint;
+
+    QStringList keyParts;
+
+    for(const eGROUPDIMENSION &dimension : dimensions)
     {
-        *maxYAxis = maxDividendAxis;
+        keyParts << QString::number(dimension);
     }
 
-    return dividendSeries;
-}
+    const QString key = QString("%1|%2|%3|%4").arg(keyParts.join(','), QString::number(bucket), from.toString(Qt::ISODate), to.toString(Qt::ISODate));
 
-QPieSeries* Calculation::getSectorSeries(const QDate &from, const QDate &to)
-{
-    QVector<sOVERVIEWTABLE> table = getOverviewTable(from, to);
+    AggregationCube cube;
 
-    if(table.isEmpty())
+    if(aggregation.getCached(key, source, &cube))
     {
-        return nullptr;
+        return cube;
     }
 
-    QVector<QPair<QString, double> > sectors;
+    costBasis.setMethod(context.costBasisMethod);
+    costBasis.update(stockList);
+
+    portfolioState.update(stockList);
+    const QHash<QString, int> counts = portfolioState.getCounts(from, to);
+
+    QVector<sAGGREGATIONFACT> facts;
 
-    for(const sOVERVIEWTABLE &item : table)
+    for(int security = 0; security < securities.count(); ++security)
     {
-        auto it = std::find_if(sectors.begin(), sectors.end(), [item](QPair<QString, double> a)
-                               {
-                                   return a.first == item.sector;
-                               }
-                               );
+        const QString &ISIN = securityISINs.at(security);
+        const int totalCount = counts.value(ISIN);
 
-        if(it != sectors.end()) // sector already exists
+        // The position measures belong to the bucket of the end of the range
+        if(totalCount > 0 && !std::isnan(prices.at(security)))
         {
-            it->second += item.totalOnlinePrice;
+            facts.push_back({security, to, MARKETVALUEMEASURE, context.toSelected(currencies.at(security), prices.at(security))*totalCount});
         }
-        else
+
+        const sCOSTBASISSTATE state = costBasis.getState(ISIN, to);
+
+        if(state.openCount > 0)
         {
-            sectors.push_back(qMakePair(item.sector, item.totalOnlinePrice));
+            facts.push_back({security, to, COSTMEASURE, context.toSelected(currencies.at(security), state.openCost)});
+        }
+
+        const QVector<sSTOCKDATA> values = stockList.value(ISIN);
+
+        for(const sSTOCKDATA &stock : values)
+        {
+            const QDate date = stock.dateTime.date();
+
+            if( !(date >= from && date <= to) || (stock.flags & EXCLUDEDFLAG) ) continue;
+
+            switch(stock.type)
+            {
+                case DIVIDEND:
+                {
+                    facts.push_back({security, date, DIVIDENDMEASURE, context.toSelected(stock.currency, stock.price + stock.fee)});
+                }
+                break;
+
+                case BUY:
+                case SELL:
+                {
+                    facts.push_back({security, date, FEEMEASURE, context.toSelected(stock.currency, std::abs(stock.fee))});
+                }
+                break;
+
+                default:
+                break;
+            }
+        }
+    }
+
+    cube = Aggregation::build(securities, facts, dimensions, bucket, from, to);
+    aggregation.setCached(key, source, cube);
+
+    return cube;
+}
+
+QHash<QString, sHOLDING> Calculation::getHoldings(const QDate &date)
+{
+    Q_ASSERT(stockData);
+
+    const StockDataSnapshot snapshot = stockData->getSnapshot();
+
+    portfolioState.update(*snapshot);
+
+    return portfolioState.getState(date).holdings;
+}
+
+sCORRELATION Calculation::getCorrelation(const QDate &from, const QDate &to)
+{
+    Q_ASSERT(stockData);
+    Q_ASSERT(database);
+
+    sCORRELATION correlation;
+
+    const QVector<sOVERVIEWTABLE> table = getOverviewTable(database->getCalculationContext(), from, to);
+
+    QList<QString> ISINs;
+
+    for(const sOVERVIEWTABLE &row : table)
+    {
+        if(row.totalCount > 0)
+        {
+            ISINs.push_back(row.ISIN);
+            correlation.tickers.push_back(row.ticker);
         }
     }
 
-    QPieSeries *sectorSeries = new QPieSeries();
+    const QVector<QMap<QDate, double>> history = stockData->getPriceHistory(ISINs, from, to);
+
+    // Common day grid of all the recorded prices
+    QMap<QDate, int> grid;
 
-    for(const QPair<QString, double> &item : sectors)
+    for(const QMap<QDate, double> &prices : history)
     {
-        sectorSeries->append(item.first, item.second);
+        for(auto it = prices.cbegin(); it != prices.cend(); ++it)
+        {
+            grid.insert(it.key(), 0);
+        }
     }
 
-    sectorSeries->setLabelsVisible();
+    int index = 0;
 
-    for(QPieSlice *slice : sectorSeries->slices())
+    for(auto it = grid.begin(); it != grid.end(); ++it)
     {
-        slice->setLabel(QString("%1 (%2%)").arg(slice->label()).arg(100*slice->percentage(), 0, 'f', 1));
+        it.value() = index++;
     }
 
-    sectorSeries->setHoleSize(0.35);
+    const int count = ISINs.count();
+    const int days = qMax(0, grid.count() - 1);
+
+    // Column-major, the return of a day needs the price of the day and of the previous grid day
+    QVector<double> returns(days*count, std::numeric_limits<double>::quiet_NaN());
+
+    for(int security = 0; security < count; ++security)
+    {
+        const QMap<QDate, double> &prices = history.at(security);
+        double *column = returns.data() + security*days;
+        int previousIndex = -1;
+        double previousPrice = 0.0;
 
-    return sectorSeries;
+        for(auto it = prices.cbegin(); it != prices.cend(); ++it)
+        {
+            const int dayIndex = grid.value(it.key());
+
+            if(previousIndex >= 0 && previousIndex == dayIndex - 1 && previousPrice > 0.0)
+            {
+                column[dayIndex - 1] = it.value()/previousPrice - 1.0;
+            }
+
+            previousIndex = dayIndex;
+            previousPrice = it.value();
+        }
+    }
+
+    Covariance::getCorrelation(returns, days, count, &correlation.matrix, &correlation.days);
+
+    return correlation;
 }
 
-QPieSeries* Calculation::getStockSeries(const QDate &from, const QDate &to)
+QPieSeries* Calculation::getGroupSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, const eGROUPDIMENSION &dimension)
 {
-    QVector<sOVERVIEWTABLE> table = getOverviewTable(from, to);
+    const AggregationCube cube = getCube(context, from, to, {dimension}, NOBUCKET);
+    const QVector<double> values = cube.getGroupTotals(MARKETVALUEMEASURE);
+
+    QPieSeries *groupSeries = new QPieSeries();
 
-    if(table.isEmpty())
+    for(int group = 0; group < values.count(); ++group)
     {
-        return nullptr;
+        if(values.at(group) > 0.0)
+        {
+            groupSeries->append(cube.getGroupLabel(group), values.at(group));
+        }
     }
 
-    QPieSeries *sectorSeries = new QPieSeries();
-
-    for(const sOVERVIEWTABLE &item : table)
+    if(groupSeries->count() == 0)
     {
-        sectorSeries->append(item.ticker, item.percentage);
+        delete groupSeries;
+        return nullptr;
     }
 
-    sectorSeries->setLabelsVisible();
+    groupSeries->setLabelsVisible();
+
+    const int precision = (dimension == TICKERDIMENSION) ? 2 : 1;
 
-    for(QPieSlice *slice : sectorSeries->slices())
+    for(QPieSlice *slice : groupSeries->slices())
     {
-        slice->setLabel(QString("%1 (%2%)").arg(slice->label()).arg(100*slice->percentage(), 0, 'f', 2));
+        slice->setLabel(QString("%1 (%2%)").arg(slice->label()).arg(100*slice->percentage(), 0, 'f', precision));
     }
 
-    sectorSeries->setHoleSize(0.35);
+    groupSeries->setHoleSize(0.35);
 
-    return sectorSeries;
+    return groupSeries;
 }
@@ -2,10 +2,22 @@
 #define CALCULATION_H
 
 #include <QObject>
+#include <QFuture>
+#include <QThreadPool>
 #include <QtCharts>
 
+#include <memory>
+
+#include "aggregation.h"
+#include "calendargrid.h"
 #include "callout.h"
+#include "costbasis.h"
+#include "covariance.h"
 #include "database.h"
+#include "navseries.h"
+#include "portfoliostate.h"
+#include "returns.h"
+#include "riskmetrics.h"
 #include "stockdata.h"
 
 class Calculation : public QObject
@@ -17,21 +29,137 @@ public:
     QVector<sOVERVIEWTABLE> getOverviewTable(const QDate &from, const QDate &to);
     double getPortfolioValue(const QDate &from, const QDate &to);
     sOVERVIEWINFO getOverviewInfo(const QDate &from, const QDate &to);
+
+    /**
+     * @brief getOverviewTableAsync - submit getOverviewTable to the calculation pool
+     * @return future with the table, the GUI thread is not blocked
+     */
+    QFuture<QVector<sOVERVIEWTABLE>> getOverviewTableAsync(const QDate &from, const QDate &to);
+
+    /**
+     * @brief getOverviewInfoAsync - submit getOverviewInfo to the calculation pool
+     * @return future with the overview info, the GUI thread is not blocked
+     */
+    QFuture<sOVERVIEWINFO> getOverviewInfoAsync(const QDate &from, const QDate &to);
+
     QChartView *getChartView(const eCHARTTYPE &type, const QDate &from, const QDate &to, const QString &ISIN = QString());
     MonthDividendDataType getMonthDividendData(const QDate &from, const QDate &to);
+
+    /**
+     * @brief getCube - measures of the positions grouped by the dimensions and the time buckets, e.g. for a pivot table
+     * The cube is cached until the transactions, the settings, the prices or the security attributes change
+     */
+    AggregationCube getCube(const QDate &from, const QDate &to, const QVector<eGROUPDIMENSION> &dimensions, const eTIMEBUCKET &bucket = NOBUCKET);
+
+    /**
+     * @brief getCorrelation - correlation of the daily returns of the open positions within the range
+     * The returns come from the recorded online prices, days without a price are left out pairwise
+     */
+    sCORRELATION getCorrelation(const QDate &from, const QDate &to);
+
+    /**
+     * @brief getHoldings - positions held at the end of the day, replayed from the nearest checkpoint
+     * @return ISIN, holding; only non-zero positions
+     */
+    QHash<QString, sHOLDING> getHoldings(const QDate &date);
 private:
     Database *database;
     StockData *stockData;
 
+    CostBasis costBasis;
+    PortfolioState portfolioState;
+    NavSeries navSeries;
+    Returns returns;
+    Aggregation aggregation;
+
+    enum
+    {
+        RISKMETRICSRANGES = 8       // accumulators kept for the recently used ranges
+    };
+
+    QHash<QString, std::shared_ptr<RiskMetrics>> riskMetrics;      // range, accumulators of the range
+    QStringList riskMetricsOrder;   // ranges, the least recently used first
+    QMutex riskMetricsMutex;
+
+    QThreadPool pool;               // declared last, destroyed first, so the jobs are finished before the members they use
+
+    /**
+     * @brief getOverviewTable, getPortfolioValue, getOverviewInfo - the queries with the settings snapshot taken once by the caller
+     */
+    QVector<sOVERVIEWTABLE> getOverviewTable(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to);
+    double getPortfolioValue(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to);
+    sOVERVIEWINFO getOverviewInfo(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to);
+
+    /**
+     * @brief getCashEvents - collect the events of the type (dividends, fees, deposits, ...) of each ISIN in parallel
+     * @return one vector per key, in the keys order, so the callers can reduce them deterministically
+     */
+    QVector<QVector<sCASHEVENT>> getCashEvents(const sCALCULATIONCONTEXT &context, const StockDataType &stockList, const QList<QString> &keys, const eSTOCKEVENTTYPE &type, const QDate &from, const QDate &to);
+
+    /**
+     * @brief getCalendar - sum the events into the month buckets in one pass
+     * @param tickers - if set, each ticker has its own layer and the tickers are returned in the layer order
+     */
+    CalendarGrid getCalendar(const QVector<QVector<sCASHEVENT>> &events, QStringList *tickers = nullptr);
+
+    /**
+     * @brief getMonthBarSets - one bar set per layer of the grid, from the first to the last used month
+     */
+    QVector<QBarSet*> getMonthBarSets(const CalendarGrid &grid, const QStringList &tickers, QStringList *categories);
+
     QChart *getChart(const eCHARTTYPE &type, const QDate &from, const QDate &to, const QString &ISIN = QString());
-    QLineSeries *getInvestedSeries(const QDate &from, const QDate &to);
-    QLineSeries *getDepositSeries(const QDate &from, const QDate &to);
-    QBarSeries *getDividendSeries(const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis, const QString &ISIN = QString());
-    QStackedBarSeries *getMonthDividendSeries(const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis);
-    QBarSeries *getMonthCompareDividendSeries(const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis);
-    QStackedBarSeries *getYearDividendSeries(const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis);
-    QPieSeries *getSectorSeries(const QDate &from, const QDate &to);
-    QPieSeries *getStockSeries(const QDate &from, const QDate &to);
+    QLineSeries *getInvestedSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to);
+    QLineSeries *getDepositSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to);
+    QLineSeries *getValueSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to);
+
+    /**
+     * @brief updateNavSeries - pass the transactions, online prices and current exchange rates to the daily value series
+     */
+    void updateNavSeries(const sCALCULATIONCONTEXT &context, const StockDataType &stockList);
+
+    /**
+     * @brief getRates - value of one unit of each eCURRENCY in the selected currency
+     */
+    QVector<double> getRates(const sCALCULATIONCONTEXT &context);
+
+    /**
+     * @brief getReturns - fill TWR and XIRR of the overview
+     * @param flows - deposits and withdrawals within the range, investor view
+     * @param tradeFlows - date, money moved into the holdings by buys and sells
+     */
+    void getReturns(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, const StockDataType &stockList, QVector<sCASHFLOW> flows, const QMap<QDate, double> &tradeFlows, sOVERVIEWINFO &info);
+
+    /**
+     * @brief getTradeFlows - date, money moved into the holdings by buys and sells within the range
+     */
+    QMap<QDate, double> getTradeFlows(const sCALCULATIONCONTEXT &context, const StockDataType &stockList, const QDate &from, const QDate &to);
+
+    /**
+     * @brief getBeta - online beta of the open positions weighted by their value
+     * @return NaN if no position has both the price and the beta
+     */
+    double getBeta(const sCALCULATIONCONTEXT &context, const StockDataType &stockList, const QDate &from, const QDate &to);
+
+    /**
+     * @brief getRiskSeries - rolling volatility and rolling drawdown of the daily values
+     * @return false if the range is shorter than the rolling window
+     */
+    bool getRiskSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, QLineSeries **volatilitySeries, QLineSeries **drawdownSeries);
+    QBarSeries *getDividendSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis, const QString &ISIN = QString());
+    QStackedBarSeries *getMonthDividendSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis);
+    QBarSeries *getMonthCompareDividendSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis);
+    QStackedBarSeries *getYearDividendSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, QStringList *xAxis, double *maxYAxis);
+    AggregationCube getCube(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, const QVector<eGROUPDIMENSION> &dimensions, const eTIMEBUCKET &bucket);
+
+    /**
+     * @brief getGroupSeries - market value of the open positions grouped by the dimension
+     */
+    QPieSeries *getGroupSeries(const sCALCULATIONCONTEXT &context, const QDate &from, const QDate &to, const eGROUPDIMENSION &dimension);
+
+    /**
+     * @brief getRiskMetrics - accumulators of the range, so each range (overview, chart) adds only its new days
+     */
+    std::shared_ptr<RiskMetrics> getRiskMetrics(const QDate &from, const QDate &to);
 signals:
 };
 
@@ -0,0 +1,99 @@
+#include "calendargrid.h"
+
+CalendarGrid::CalendarGrid() : firstYear(0), layerCount(0), monthCount(0)
+{
+
+}
+
+CalendarGrid::CalendarGrid(const int &firstYear, const int &lastYear, const int &layerCount) :
+    firstYear(firstYear), layerCount(layerCount), monthCount((lastYear - firstYear + 1)*12)
+{
+    cells = QVector<double>(layerCount*monthCount, 0.0);
+    used = QVector<quint8>(monthCount, 0);
+}
+
+bool CalendarGrid::isEmpty() const
+{
+    return getFirstUsed() < 0;
+}
+
+int CalendarGrid::getFirstUsed() const
+{
+    for(int index = 0; index < monthCount; ++index)
+    {
+        if(used.at(index) != 0)
+        {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+int CalendarGrid::getLastUsed() const
+{
+    for(int index = monthCount - 1; index >= 0; --index)
+    {
+        if(used.at(index) != 0)
+        {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+bool CalendarGrid::isYearUsed(const int &year) const
+{
+    const int base = (year - firstYear)*12;
+
+    if(base < 0 || base >= monthCount)
+    {
+        return false;
+    }
+
+    quint8 any = 0;
+
+    for(int month = 0; month < 12; ++month)
+    {
+        any |= used.at(base + month);
+    }
+
+    return any != 0;
+}
+
+QDate CalendarGrid::getMonthDate(const int &index) const
+{
+    return QDate(firstYear + index/12, index%12 + 1, 1);
+}
+
+QVector<double> CalendarGrid::getMonthTotals() const
+{
+    QVector<double> totals(monthCount, 0.0);
+    double *total = totals.data();
+
+    for(int layer = 0; layer < layerCount; ++layer)
+    {
+        const double *values = getLayer(layer);
+
+        for(int index = 0; index < monthCount; ++index)
+        {
+            total[index] += values[index];
+        }
+    }
+
+    return totals;
+}
+
+QVector<double> CalendarGrid::getYearTotals(const int &layer) const
+{
+    QVector<double> totals(monthCount/12, 0.0);
+    const QVector<double> months = (layer < 0) ? getMonthTotals() : QVector<double>(getLayer(layer), getLayer(layer) + monthCount);
+
+    for(int index = 0; index < monthCount; ++index)
+    {
+        totals[index/12] += months.at(index);
+    }
+
+    return totals;
+}
@@ -0,0 +1,76 @@
+#ifndef CALENDARGRID_H
+#define CALENDARGRID_H
+
+#include <QDate>
+#include <QVector>
+
+/**
+ * @brief The CalendarGrid class - year x 12 month buckets in one contiguous array
+ * Each layer (e.g. ticker) is stored as one block of yearCount*12 values, so a layer can be read as a plain array
+ * and the layers can be summed month by month.
+ */
+class CalendarGrid
+{
+public:
+    CalendarGrid();
+    CalendarGrid(const int &firstYear, const int &lastYear, const int &layerCount = 1);
+
+    /**
+     * @brief add - add the value to the month bucket of the date, the date has to be within the years of the grid
+     */
+    inline void add(const QDate &date, const double &value, const int &layer = 0)
+    {
+        const int index = (date.year() - firstYear)*12 + date.month() - 1;
+
+        cells[layer*monthCount + index] += value;
+        used[index] = 1;
+    }
+
+    bool isEmpty() const;
+
+    int getFirstYear() const { return firstYear; }
+    int getLastYear() const { return firstYear + monthCount/12 - 1; }
+    int getLayerCount() const { return layerCount; }
+    int getMonthCount() const { return monthCount; }
+
+    /**
+     * @brief getFirstUsed, getLastUsed - month index of the first and the last bucket with any value, -1 if there is none
+     */
+    int getFirstUsed() const;
+    int getLastUsed() const;
+
+    bool isUsed(const int &index) const { return used.at(index) != 0; }
+    bool isYearUsed(const int &year) const;
+
+    /**
+     * @brief getMonthDate - first day of the month of the index
+     */
+    QDate getMonthDate(const int &index) const;
+
+    double getValue(const int &index, const int &layer = 0) const { return cells.at(layer*monthCount + index); }
+
+    /**
+     * @brief getLayer - monthCount values of the layer
+     */
+    const double *getLayer(const int &layer) const { return cells.constData() + layer*monthCount; }
+
+    /**
+     * @brief getMonthTotals - values of all layers summed per month
+     */
+    QVector<double> getMonthTotals() const;
+
+    /**
+     * @brief getYearTotals - values summed per year
+     * @param layer - -1 for all layers
+     */
+    QVector<double> getYearTotals(const int &layer = -1) const;
+
+private:
+    int firstYear;
+    int layerCount;
+    int monthCount;
+    QVector<double> cells;          // layer-major, then year, then month
+    QVector<quint8> used;           // month index, 1 if any value was added
+};
+
+#endif // CALENDARGRID_H
@@ -0,0 +1,117 @@
+#include "correlationheatmap.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QToolTip>
+
+#include <cmath>
+
+CorrelationHeatmap::CorrelationHeatmap(const sCORRELATION &correlation, QWidget *parent) : QWidget(parent), correlation(correlation)
+{
+    setMouseTracking(true);
+    setMinimumSize(400, 400);
+}
+
+void CorrelationHeatmap::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event)
+
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::white);
+
+    const int count = correlation.tickers.count();
+
+    if(count == 0)
+    {
+        return;
+    }
+
+    QPoint origin;
+    const int cell = getCell(&origin);
+
+    for(int row = 0; row < count; ++row)
+    {
+        for(int column = 0; column < count; ++column)
+        {
+            painter.fillRect(origin.x() + column*cell, origin.y() + row*cell, cell, cell, getColor(correlation.matrix.at(row*count + column)));
+        }
+    }
+
+    // Labels only if they fit
+    if(cell >= 12)
+    {
+        QFont font = painter.font();
+        font.setPixelSize(qMin(cell - 2, 12));
+        painter.setFont(font);
+        painter.setPen(Qt::black);
+
+        for(int i = 0; i < count; ++i)
+        {
+            painter.drawText(QRect(0, origin.y() + i*cell, origin.x() - 4, cell), Qt::AlignRight | Qt::AlignVCenter, correlation.tickers.at(i));
+
+            painter.save();
+            painter.translate(origin.x() + i*cell, origin.y() - 4);
+            painter.rotate(-90);
+            painter.drawText(QRect(0, 0, origin.y() - 4, cell), Qt::AlignLeft | Qt::AlignVCenter, correlation.tickers.at(i));
+            painter.restore();
+        }
+    }
+}
+
+void CorrelationHeatmap::mouseMoveEvent(QMouseEvent *event)
+{
+    const int count = correlation.tickers.count();
+
+    QPoint origin;
+    const int cell = getCell(&origin);
+
+    if(count == 0 || cell <= 0)
+    {
+        return;
+    }
+
+    const int column = (event->pos().x() - origin.x())/cell;
+    const int row = (event->pos().y() - origin.y())/cell;
+
+    if(event->pos().x() < origin.x() || event->pos().y() < origin.y() || row >= count || column >= count)
+    {
+        QToolTip::hideText();
+        return;
+    }
+
+    const double value = correlation.matrix.at(row*count + column);
+    const QString text = QString("%1 / %2\n%3\n%4 days").arg(correlation.tickers.at(row), correlation.tickers.at(column))
+                                                          .arg(std::isnan(value) ? QString("-") : QString("%L1").arg(value, 0, 'f', 2))
+                                                          .arg(correlation.days.at(row*count + column));
+
+    QToolTip::showText(event->globalPos(), text, this);
+}
+
+int CorrelationHeatmap::getCell(QPoint *origin) const
+{
+    const int count = correlation.tickers.count();
+    const int labels = 60;
+
+    if(count == 0)
+    {
+        *origin = QPoint(labels, labels);
+        return 0;
+    }
+
+    const int cell = qMax(1, qMin(width() - labels, height() - labels)/count);
+    *origin = QPoint(labels, labels);
+
+    return cell;
+}
+
+QColor CorrelationHeatmap::getColor(const double &value)
+{
+    if(std::isnan(value))
+    {
+        return QColor(200, 200, 200);
+    }
+
+    const int fade = static_cast<int>(255*(1.0 - std::abs(value)));
+
+    return (value >= 0.0) ? QColor(fade, 255, fade) : QColor(255, fade, fade);
+}
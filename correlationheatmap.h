@@ -0,0 +1,32 @@
+#ifndef CORRELATIONHEATMAP_H
+#define CORRELATIONHEATMAP_H
+
+#include <QWidget>
+
+#include "global.h"
+
+class CorrelationHeatmap : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit CorrelationHeatmap(const sCORRELATION &correlation, QWidget *parent = nullptr);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private:
+    sCORRELATION correlation;
+
+    /**
+     * @brief getCell - cell size and the top left corner of the matrix, the labels are left and above
+     */
+    int getCell(QPoint *origin) const;
+
+    /**
+     * @brief getColor - red for -1, white for 0, green for 1, gray if not available
+     */
+    static QColor getColor(const double &value);
+};
+
+#endif // CORRELATIONHEATMAP_H
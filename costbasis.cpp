@@ -0,0 +1,297 @@
+#include "costbasis.h"
+
+#include <algorithm>
+#include <cmath>
+
+CostBasis::CostBasis(QObject *parent) : QObject(parent), method(FIFOMETHOD)
+{
+
+}
+
+void CostBasis::setMethod(const eCOSTBASIS &method)
+{
+    QMutexLocker locker(&mutex);
+
+    if(this->method != method)
+    {
+        this->method = method;
+        isins.clear();
+    }
+}
+
+void CostBasis::update(const StockDataType &stockList)
+{
+    QMutexLocker locker(&mutex);
+
+    for(auto it = stockList.cbegin(); it != stockList.cend(); ++it)
+    {
+        auto found = isins.find(it.key());
+
+        if(found == isins.end())
+        {
+            sISINLOTS isin;
+            rebuild(isin, it.value());
+            isins.insert(it.key(), isin);
+
+            continue;
+        }
+
+        // The vector is implicitly shared with the processed one, nothing has changed
+        if(found->source.constData() == it.value().constData() && found->source.count() == it.value().count())
+        {
+            continue;
+        }
+
+        if(!append(*found, it.value()))
+        {
+            rebuild(*found, it.value());
+        }
+    }
+
+    // Remove deleted ISINs
+    QMutableHashIterator<QString, sISINLOTS> it(isins);
+
+    while(it.hasNext())
+    {
+        it.next();
+
+        if(!stockList.contains(it.key()))
+        {
+            it.remove();
+        }
+    }
+}
+
+sCOSTBASISSTATE CostBasis::getState(const QString &ISIN, const QDate &date) const
+{
+    QMutexLocker locker(&mutex);
+
+    return findState(ISIN, date);
+}
+
+double CostBasis::getRealized(const QString &ISIN, const QDate &from, const QDate &to) const
+{
+    QMutexLocker locker(&mutex);
+
+    return findState(ISIN, to).realized - findState(ISIN, from.addDays(-1)).realized;
+}
+
+void CostBasis::rebuild(sISINLOTS &isin, const QVector<sSTOCKDATA> &vector)
+{
+    isin = sISINLOTS();
+    isin.source = vector;
+
+    const QVector<sSTOCKDATA> trades = getTrades(vector, 0);
+
+    for(const sSTOCKDATA &stock : trades)
+    {
+        apply(isin, stock);
+    }
+}
+
+bool CostBasis::append(sISINLOTS &isin, const QVector<sSTOCKDATA> &vector)
+{
+    const QVector<sSTOCKDATA> &source = isin.source;
+
+    if(source.count() > vector.count())
+    {
+        return false;
+    }
+
+    for(int i = 0; i < source.count(); ++i)
+    {
+        if(source.at(i) != vector.at(i))
+        {
+            return false;
+        }
+    }
+
+    const QVector<sSTOCKDATA> trades = getTrades(vector, source.count());
+
+    // Back-dated trades change the order of the lots, they need the full rebuild
+    if(!trades.isEmpty() && !isin.states.isEmpty() && trades.first().dateTime < isin.states.last().dateTime)
+    {
+        return false;
+    }
+
+    for(const sSTOCKDATA &stock : trades)
+    {
+        apply(isin, stock);
+    }
+
+    isin.source = vector;
+
+    return true;
+}
+
+void CostBasis::apply(sISINLOTS &isin, const sSTOCKDATA &stock)
+{
+    sCOSTBASISSTATE state;
+
+    if(isin.states.isEmpty())
+    {
+        state.openCount = 0;
+        state.openCost = 0.0;
+        state.realized = 0.0;
+    }
+    else
+    {
+        state = isin.states.last();
+    }
+
+    state.dateTime = stock.dateTime;
+
+    // The buy price is stored as the cash movement, i.e. negative
+    const double price = std::abs(stock.price);
+
+    if(stock.type == BUY)
+    {
+        if(method != AVERAGEMETHOD)
+        {
+            sLOT lot;
+            lot.dateTime = stock.dateTime;
+            lot.count = stock.count;
+            lot.price = price;
+
+            isin.lots.push_back(lot);
+        }
+
+        state.openCount += stock.count;
+        state.openCost += stock.count * price;
+    }
+    else if(stock.type == SELL)
+    {
+        int remaining = stock.count;
+        int matched = 0;
+        double cost = 0.0;
+
+        switch(method)
+        {
+            case FIFOMETHOD:
+            {
+                while(remaining > 0 && isin.head < isin.lots.count())
+                {
+                    sLOT &lot = isin.lots[isin.head];
+                    int take = qMin(remaining, lot.count);
+
+                    lot.count -= take;
+                    cost += take * lot.price;
+                    matched += take;
+                    remaining -= take;
+
+                    if(lot.count == 0)
+                    {
+                        isin.head++;
+                    }
+                }
+
+                // Drop the sold lots once they take most of the vector
+                if(isin.head > 32 && isin.head*2 > isin.lots.count())
+                {
+                    isin.lots.remove(0, isin.head);
+                    isin.head = 0;
+                }
+            }
+            break;
+
+            case LIFOMETHOD:
+            {
+                while(remaining > 0 && !isin.lots.isEmpty())
+                {
+                    sLOT &lot = isin.lots.last();
+                    int take = qMin(remaining, lot.count);
+
+                    lot.count -= take;
+                    cost += take * lot.price;
+                    matched += take;
+                    remaining -= take;
+
+                    if(lot.count == 0)
+                    {
+                        isin.lots.removeLast();
+                    }
+                }
+            }
+            break;
+
+            case AVERAGEMETHOD:
+            {
+                matched = qMin(remaining, state.openCount);
+
+                if(state.openCount > 0)
+                {
+                    cost = state.openCost * matched / state.openCount;
+                }
+            }
+            break;
+        }
+
+        // Shares sold without a matching buy (e.g. history not imported) have no known cost, they are not realized
+        state.openCount -= matched;
+        state.openCost -= cost;
+        state.realized += matched * price - cost;
+
+        if(state.openCount == 0)
+        {
+            state.openCost = 0.0;
+        }
+    }
+
+    isin.states.push_back(state);
+}
+
+QVector<sSTOCKDATA> CostBasis::getTrades(const QVector<sSTOCKDATA> &vector, const int &from)
+{
+    QVector<sSTOCKDATA> trades;
+
+    for(int i = from; i < vector.count(); ++i)
+    {
+        const sSTOCKDATA &stock = vector.at(i);
+
+        if(stock.type == BUY || stock.type == SELL)
+        {
+            trades.push_back(stock);
+        }
+    }
+
+    std::stable_sort(trades.begin(), trades.end(),
+                     [](const sSTOCKDATA &a, const sSTOCKDATA &b)
+                     {
+                         return a.dateTime < b.dateTime;
+                     }
+                     );
+
+    return trades;
+}
+
+sCOSTBASISSTATE CostBasis::findState(const QString &ISIN, const QDate &date) const
+{
+    sCOSTBASISSTATE state;
+    state.openCount = 0;
+    state.openCost = 0.0;
+    state.realized = 0.0;
+
+    auto found = isins.constFind(ISIN);
+
+    if(found == isins.cend())
+    {
+        return state;
+    }
+
+    const QVector<sCOSTBASISSTATE> &states = found->states;
+
+    // Last state on or before the date
+    auto it = std::upper_bound(states.cbegin(), states.cend(), date,
+                               [](const QDate &d, const sCOSTBASISSTATE &s)
+                               {
+                                   return d < s.dateTime.date();
+                               }
+                               );
+
+    if(it == states.cbegin())
+    {
+        return state;
+    }
+
+    return *(it - 1);
+}
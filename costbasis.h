@@ -0,0 +1,62 @@
+#ifndef COSTBASIS_H
+#define COSTBASIS_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "global.h"
+#include "stockdata.h"
+
+class CostBasis : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CostBasis(QObject *parent = nullptr);
+
+    /**
+     * @brief setMethod - select FIFO, LIFO or average cost, all lots are rebuilt on the next update
+     */
+    void setMethod(const eCOSTBASIS &method);
+
+    /**
+     * @brief update - synchronize the open lots with the transactions
+     * @param stockList - all transactions
+     * Unchanged ISINs are skipped, appended transactions are applied to the existing lots, other changes rebuild the ISIN
+     */
+    void update(const StockDataType &stockList);
+
+    /**
+     * @brief getState - open lots and realized gain of the ISIN at the end of the day
+     * @return state from the nearest stored checkpoint, zero state if there is no trade before the date
+     */
+    sCOSTBASISSTATE getState(const QString &ISIN, const QDate &date) const;
+
+    /**
+     * @brief getRealized - realized gain of the ISIN within the range, in the stock currency
+     */
+    double getRealized(const QString &ISIN, const QDate &from, const QDate &to) const;
+
+private:
+    struct sISINLOTS
+    {
+        QVector<sSTOCKDATA> source;         // shallow copy of the processed transactions, used to detect changes
+        QVector<sLOT> lots;                 // open lots, the first "head" lots are already sold
+        int head = 0;
+        QVector<sCOSTBASISSTATE> states;    // state after each trade, sorted by date
+    };
+
+    eCOSTBASIS method;
+    QHash<QString, sISINLOTS> isins;
+    mutable QMutex mutex;
+
+    void rebuild(sISINLOTS &isin, const QVector<sSTOCKDATA> &vector);
+    bool append(sISINLOTS &isin, const QVector<sSTOCKDATA> &vector);
+    void apply(sISINLOTS &isin, const sSTOCKDATA &stock);
+
+    static QVector<sSTOCKDATA> getTrades(const QVector<sSTOCKDATA> &vector, const int &from);
+    sCOSTBASISSTATE findState(const QString &ISIN, const QDate &date) const;
+};
+
+#endif // COSTBASIS_H
@@ -0,0 +1,161 @@
+#include "covariance.h"
+
+#include <QtConcurrent>
+
+#include <cmath>
+#include <limits>
+
+void Covariance::getCorrelation(const QVector<double> &returns, const int &days, const int &count,
+                                QVector<double> *correlation, QVector<int> *overlaps)
+{
+    Q_ASSERT(correlation);
+    Q_ASSERT(returns.count() == days*count);
+
+    // Branch-free inner loop: the missing days are 0 with mask 0
+    QVector<double> values(days*count);
+    QVector<double> masks(days*count);
+
+    for(int i = 0; i < days*count; ++i)
+    {
+        const bool present = !std::isnan(returns.at(i));
+        values[i] = present ? returns.at(i) : 0.0;
+        masks[i] = present ? 1.0 : 0.0;
+    }
+
+    // Upper triangle tiles, each tile writes only its own pairs
+    struct sTILE
+    {
+        int first;          // first column of the row block
+        int second;         // first column of the column block
+    };
+
+    QVector<sTILE> tiles;
+
+    for(int first = 0; first < count; first += COLUMNBLOCK)
+    {
+        for(int second = first; second < count; second += COLUMNBLOCK)
+        {
+            tiles.push_back({first, second});
+        }
+    }
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    *correlation = QVector<double>(count*count, nan);
+
+    if(overlaps != nullptr)
+    {
+        *overlaps = QVector<int>(count*count, 0);
+    }
+
+    double *result = correlation->data();
+    int *common = (overlaps != nullptr) ? overlaps->data() : nullptr;
+    const double *valueData = values.constData();
+    const double *maskData = masks.constData();
+
+    QtConcurrent::blockingMap(tiles, [=](const sTILE &tile)
+                              {
+                                  const int rows = qMin(int(COLUMNBLOCK), count - tile.first);
+                                  const int columns = qMin(int(COLUMNBLOCK), count - tile.second);
+
+                                  QVector<double> sums(COLUMNBLOCK*COLUMNBLOCK*SUMCOUNT, 0.0);
+
+                                  for(int day = 0; day < days; day += DAYBLOCK)
+                                  {
+                                      const int n = qMin(int(DAYBLOCK), days - day);
+
+                                      for(int row = 0; row < rows; ++row)
+                                      {
+                                          const int i = tile.first + row;
+                                          const double *x = valueData + i*days + day;
+                                          const double *mx = maskData + i*days + day;
+
+                                          for(int column = 0; column < columns; ++column)
+                                          {
+                                              const int j = tile.second + column;
+
+                                              if(j < i) continue;
+
+                                              accumulate(x, mx, valueData + j*days + day, maskData + j*days + day, n,
+                                                         sums.data() + (row*COLUMNBLOCK + column)*SUMCOUNT);
+                                          }
+                                      }
+                                  }
+
+                                  for(int row = 0; row < rows; ++row)
+                                  {
+                                      for(int column = 0; column < columns; ++column)
+                                      {
+                                          const int i = tile.first + row;
+                                          const int j = tile.second + column;
+
+                                          if(j < i) continue;
+
+                                          const double *sum = sums.constData() + (row*COLUMNBLOCK + column)*SUMCOUNT;
+                                          const double n = sum[COUNTSUM];
+
+                                          if(common != nullptr)
+                                          {
+                                              common[i*count + j] = static_cast<int>(n);
+                                              common[j*count + i] = static_cast<int>(n);
+                                          }
+
+                                          if(n < 2.0) continue;
+
+                                          const double covariance = n*sum[XYSUM] - sum[XSUM]*sum[YSUM];
+                                          const double varianceX = n*sum[XXSUM] - sum[XSUM]*sum[XSUM];
+                                          const double varianceY = n*sum[YYSUM] - sum[YSUM]*sum[YSUM];
+
+                                          if(varianceX <= 0.0 || varianceY <= 0.0) continue;
+
+                                          const double value = qBound(-1.0, covariance/std::sqrt(varianceX*varianceY), 1.0);
+
+                                          result[i*count + j] = value;
+                                          result[j*count + i] = value;
+                                      }
+                                  }
+                              }
+                              );
+}
+
+void Covariance::accumulate(const double *x, const double *mx, const double *y, const double *my, const int &n, double *sums)
+{
+    double lanes[SUMCOUNT][LANES] = {};
+    int k = 0;
+
+    for(; k + LANES <= n; k += LANES)
+    {
+        for(int lane = 0; lane < LANES; ++lane)
+        {
+            const double m = mx[k + lane]*my[k + lane];
+            const double a = m*x[k + lane];
+            const double b = m*y[k + lane];
+
+            lanes[COUNTSUM][lane] += m;
+            lanes[XSUM][lane] += a;
+            lanes[YSUM][lane] += b;
+            lanes[XYSUM][lane] += a*y[k + lane];
+            lanes[XXSUM][lane] += a*x[k + lane];
+            lanes[YYSUM][lane] += b*y[k + lane];
+        }
+    }
+
+    for(; k < n; ++k)
+    {
+        const double m = mx[k]*my[k];
+        const double a = m*x[k];
+        const double b = m*y[k];
+
+        lanes[COUNTSUM][0] += m;
+        lanes[XSUM][0] += a;
+        lanes[YSUM][0] += b;
+        lanes[XYSUM][0] += a*y[k];
+        lanes[XXSUM][0] += a*x[k];
+        lanes[YYSUM][0] += b*y[k];
+    }
+
+    for(int sum = 0; sum < SUMCOUNT; ++sum)
+    {
+        sums[sum] += lanes[sum][0] + lanes[sum][1] + lanes[sum][2] + lanes[sum][3];
+    }
+}
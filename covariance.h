@@ -0,0 +1,51 @@
+#ifndef COVARIANCE_H
+#define COVARIANCE_H
+
+#include <QVector>
+
+/**
+ * @brief The Covariance class - pairwise correlation of the return columns
+ * The returns are stored column-major (all days of one security are contiguous), a missing day is NaN.
+ * Each pair uses only the days both securities have (pairwise mask). The pairs are processed in tiles
+ * of column blocks and day chunks, so the columns of a tile stay in the cache, and the tiles run in parallel.
+ */
+class Covariance
+{
+public:
+    /**
+     * @brief getCorrelation
+     * @param returns - days x count, column-major, NaN for a missing day
+     * @param correlation - count x count, NaN if the pair has less than two common days or no variance
+     * @param overlaps - count x count, common days of the pair
+     */
+    static void getCorrelation(const QVector<double> &returns, const int &days, const int &count,
+                               QVector<double> *correlation, QVector<int> *overlaps = nullptr);
+
+private:
+    enum
+    {
+        COLUMNBLOCK = 32,           // securities in one tile side
+        DAYBLOCK = 256,             // days of one pass over a tile
+        LANES = 4                   // independent accumulators, the compiler can map them to SIMD registers
+    };
+
+    enum eSUM
+    {
+        COUNTSUM = 0,
+        XSUM,
+        YSUM,
+        XYSUM,
+        XXSUM,
+        YYSUM,
+        SUMCOUNT
+    };
+
+    /**
+     * @brief accumulate - masked sums of the two columns over n days
+     * @param x, y - returns with 0 for the missing days
+     * @param mx, my - 1 for a present day, 0 for a missing one
+     */
+    static void accumulate(const double *x, const double *mx, const double *y, const double *my, const int &n, double *sums);
+};
+
+#endif // COVARIANCE_H
@@ -1,6 +1,8 @@
 #include "customcsvimportform.h"
 #include "ui_customcsvimportform.h"
 
+#include "stockdata.h"
+
 CustomCSVImportForm::CustomCSVImportForm(eCUSTOMCSVACTION action, QWidget *parent, StockDataType *data) :
     QDialog(parent),
     ui(new Ui::CustomCSVImportForm)
@@ -582,7 +584,7 @@ void CustomCSVImportForm::fillTable(StockDataType *data)
     exportTableData.erase(std::remove_if(exportTableData.begin(), exportTableData.end(),
                           [](const sSTOCKDATA &x)
                           {
-                            return x.stockName.toLower().contains("fundshare");
+                            return StockData::getFlags(x) & MONEYMARKETFLAG;
                           }),
                           exportTableData.end());
 
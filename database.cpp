@@ -80,6 +80,8 @@ Database::Database(QObject *parent) : QObject(parent)
     loadScreenParams();
     loadFilterList();
     loadIsinData();
+
+    buildCalculationContext();
 }
 
 void Database::loadConfig()
@@ -107,6 +109,8 @@ void Database::loadConfig()
     setting.lastOverviewFrom = QDate::fromString(settings.value("Overview/lastOverviewFrom", QDate(QDate::currentDate().year(), 1, 1).toString("dd.MM.yyyy")).toString(), "dd.MM.yyyy");
     setting.lastOverviewTo = QDate::fromString(settings.value("Overview/lastOverviewTo", QDate(QDate::currentDate().year(), 12, 31).toString("dd.MM.yyyy")).toString(), "dd.MM.yyyy");
     setting.showSoldPositions = settings.value("Overview/soldPositions", false).toBool();
+    setting.costBasisMethod = static_cast<eCOSTBASIS>(settings.value("Overview/costBasis", 0).toInt());
+    setting.exclusionRules = settings.value("Overview/exclusionRules", QStringList()).toStringList();
 
     QDate currentDate = QDate::currentDate();
     currentDate = currentDate.addDays(-1);
@@ -167,6 +171,8 @@ void Database::saveConfig()
     settings.setValue("Overview/lastOverviewFrom", setting.lastOverviewFrom.toString("dd.MM.yyyy"));
     settings.setValue("Overview/lastOverviewTo", setting.lastOverviewTo.toString("dd.MM.yyyy"));
     settings.setValue("Overview/soldPositions", setting.showSoldPositions);
+    settings.setValue("Overview/costBasis", setting.costBasisMethod);
+    settings.setValue("Overview/exclusionRules", setting.exclusionRules);
 
     settings.setValue("Exchange/lastExchangeRatesUpdate", setting.lastExchangeRatesUpdate.toString("dd.MM.yyyy"));
 
@@ -190,15 +196,23 @@ void Database::saveConfig()
     settings.setValue("Exchange/GBP2USD", setting.GBP2USD);
     settings.setValue("Exchange/GBP2CAD", setting.GBP2CAD);
 
-    settings.setValue("Exchange/GBP2CZK", setting.CAD2CZK);
-    settings.setValue("Exchange/GBP2EUR", setting.CAD2EUR);
-    settings.setValue("Exchange/GBP2USD", setting.CAD2USD);
-    settings.setValue("Exchange/GBP2CAD", setting.CAD2GBP);
+    settings.setValue("Exchange/CAD2CZK", setting.CAD2CZK);
+    settings.setValue("Exchange/CAD2EUR", setting.CAD2EUR);
+    settings.setValue("Exchange/CAD2USD", setting.CAD2USD);
+    settings.setValue("Exchange/CAD2GBP", setting.CAD2GBP);
 
     settings.setValue("Exchange/EUR2CZKDAP", setting.EUR2CZKDAP);
     settings.setValue("Exchange/USD2CZKDAP", setting.USD2CZKDAP);
     settings.setValue("Exchange/GBP2CZKDAP", setting.GBP2CZKDAP);
     settings.setValue("Exchange/CAD2CZKDAP", setting.CAD2CZKDAP);
+
+    // The file is replaced at once, a crash can not leave only a part of the rates written
+    settings.sync();
+
+    if (settings.status() != QSettings::NoError)
+    {
+        qWarning("Couldn't save the config file.");
+    }
 }
 
 void Database::loadScreenParams()
@@ -280,7 +294,15 @@ double Database::getExchangePrice(const eCURRENCY &currencyFrom, const double &p
             break;
     }
 
-    return exchangeRatesFuncMap[rates](price);
+    // const lookup, the map is read from the calculation threads as well
+    auto it = exchangeRatesFuncMap.constFind(rates);
+
+    if (it == exchangeRatesFuncMap.constEnd())
+    {
+        return price;
+    }
+
+    return it.value()(price);
 }
 
 QString Database::getCurrencyText(eCURRENCY currency)
@@ -311,6 +333,19 @@ QString Database::getCurrencySign(eCURRENCY currency)
     return "";
 }
 
+QString Database::getSourceText(eSTOCKSOURCE source)
+{
+    switch (source)
+    {
+        case MANUALLY: return "Manually";
+        case DEGIRO: return "DeGiro";
+        case TASTYWORKS: return "Tastyworks";
+        case LYNX: return "Lynx";
+    }
+
+    return "";
+}
+
 // Getters and Setters
 sSETTINGS Database::getSetting() const
 {
@@ -320,6 +355,7 @@ sSETTINGS Database::getSetting() const
 void Database::setSettingSlot(const sSETTINGS &value)
 {
     setting = value;
+    buildCalculationContext();
     saveConfig();
 }
 
@@ -328,6 +364,68 @@ ExchangeRatesFunctions Database::getExchangeRatesFuncMap() const
     return exchangeRatesFuncMap;
 }
 
+sCALCULATIONCONTEXT Database::getCalculationContext() const
+{
+    QMutexLocker locker(&contextMutex);
+
+    return calculationContext;
+}
+
+void Database::buildCalculationContext()
+{
+    sCALCULATIONCONTEXT context;
+    context.currency = setting.currency;
+    context.showSoldPositions = setting.showSoldPositions;
+    context.costBasisMethod = setting.costBasisMethod;
+    context.exclusionRules = setting.exclusionRules;
+
+    // The first record of the ISIN wins, the same as findIsin
+    context.isins.reserve(isinIndex.count());
+
+    for(auto it = isinIndex.constBegin(); it != isinIndex.constEnd(); ++it)
+    {
+        context.isins.insert(it.key(), isinList.at(it.value()));
+    }
+
+    // The rates are linear, so the matrix holds the value of one unit
+    for (int from = CZK; from <= CAD; ++from)
+    {
+        for (int to = CZK; to <= CAD; ++to)
+        {
+            const QString rates = getCurrencyText(static_cast<eCURRENCY>(from)) + "2" + getCurrencyText(static_cast<eCURRENCY>(to));
+            auto it = exchangeRatesFuncMap.constFind(rates);
+
+            context.rates[from][to] = (it == exchangeRatesFuncMap.constEnd()) ? 1.0 : it.value()(1.0);
+        }
+    }
+
+    QMutexLocker locker(&contextMutex);
+
+    context.version = calculationContext.version + 1;
+    calculationContext = context;
+}
+
+void Database::updateContextIsins(const QStringList &ISINs)
+{
+    QMutexLocker locker(&contextMutex);
+
+    for(const QString &ISIN : ISINs)
+    {
+        const sISINDATA *record = findIsin(ISIN);
+
+        if(record != nullptr)
+        {
+            calculationContext.isins.insert(ISIN, *record);
+        }
+        else
+        {
+            calculationContext.isins.remove(ISIN);
+        }
+    }
+
+    ++calculationContext.version;
+}
+
 QString Database::getDegiroCSV() const
 {
     return setting.degiroCSV;
@@ -452,7 +550,234 @@ QVector<sISINDATA> Database::getIsinList() const
 void Database::setIsinList(const QVector<sISINDATA> &value)
 {
     isinList = value;
+    buildIsinIndex();
+    buildCalculationContext();
+    saveIsinData();
+}
+
+const sISINDATA *Database::findIsin(const QString &ISIN) const
+{
+    auto it = isinIndex.constFind(ISIN);
+
+    if(it == isinIndex.cend())
+    {
+        return nullptr;
+    }
+
+    return &isinList.at(it.value());
+}
+
+const sISINDATA *Database::findTicker(const QString &ticker) const
+{
+    if(ticker.isEmpty())
+    {
+        return nullptr;
+    }
+
+    auto it = tickerIndex.constFind(ticker);
+
+    if(it == tickerIndex.cend())
+    {
+        it = tickerKeyIndex.constFind(getTickerKey(ticker));
+
+        if(it == tickerKeyIndex.cend())
+        {
+            return nullptr;
+        }
+    }
+
+    return &isinList.at(it.value());
+}
+
+bool Database::addIsin(const sISINDATA &record)
+{
+    if(isinIndex.contains(record.ISIN))
+    {
+        return false;
+    }
+
+    isinList.push_back(record);
+    indexIsin(isinList.count() - 1);
+    updateContextIsins(QStringList() << record.ISIN);
+    saveIsinData();
+
+    return true;
+}
+
+bool Database::updateIsin(const QString &ISIN, const sISINDATA &record)
+{
+    if(!replaceIsin(ISIN, record))
+    {
+        return false;
+    }
+
+    updateContextIsins(QStringList() << ISIN << record.ISIN);
     saveIsinData();
+
+    return true;
+}
+
+int Database::updateIsins(const QVector<sISINDATA> &records)
+{
+    QStringList updated;
+
+    for(const sISINDATA &record : records)
+    {
+        if(replaceIsin(record.ISIN, record))
+        {
+            updated << record.ISIN;
+        }
+    }
+
+    if(!updated.isEmpty())
+    {
+        updateContextIsins(updated);
+        saveIsinData();
+    }
+
+    return updated.count();
+}
+
+bool Database::replaceIsin(const QString &ISIN, const sISINDATA &record)
+{
+    auto it = isinIndex.constFind(ISIN);
+
+    if(it == isinIndex.cend())
+    {
+        return false;
+    }
+
+    const int row = it.value();
+    const sISINDATA previous = isinList.at(row);
+
+    isinList[row] = record;
+
+    // Only the changed keys of the row are moved, the refresh of the online data keeps both of them
+    if(previous.ISIN != record.ISIN)
+    {
+        releaseIndexKey(&isinIndex, previous.ISIN, row, [](const sISINDATA &data) { return data.ISIN; });
+    }
+
+    if(previous.ticker != record.ticker)
+    {
+        releaseIndexKey(&tickerIndex, previous.ticker, row, [](const sISINDATA &data) { return data.ticker; });
+
+        if(getTickerKey(previous.ticker) != getTickerKey(record.ticker))
+        {
+            releaseIndexKey(&tickerKeyIndex, getTickerKey(previous.ticker), row, [](const sISINDATA &data) { return getTickerKey(data.ticker); });
+        }
+    }
+
+    indexIsin(row);
+
+    return true;
+}
+
+QString Database::getTickerKey(const QString &ticker)
+{
+    QString key;
+    key.reserve(ticker.size());
+
+    for(const QChar &c : ticker)
+    {
+        if(c.isLetterOrNumber())
+        {
+            key.append(c.toUpper());
+        }
+    }
+
+    return key;
+}
+
+void Database::indexIsin(const int &row)
+{
+    const sISINDATA &record = isinList.at(row);
+
+    claimIndexKey(&isinIndex, record.ISIN, row);
+
+    if(record.ticker.isEmpty()) return;
+
+    claimIndexKey(&tickerIndex, record.ticker, row);
+
+    const QString key = getTickerKey(record.ticker);
+
+    if(!key.isEmpty())
+    {
+        claimIndexKey(&tickerKeyIndex, key, row);
+    }
+}
+
+void Database::claimIndexKey(QHash<QString, int> *index, const QString &key, const int &row)
+{
+    auto it = index->find(key);
+
+    // The first record wins, the same as buildIsinIndex
+    if(it == index->end())
+    {
+        index->insert(key, row);
+    }
+    else if(it.value() > row)
+    {
+        it.value() = row;
+    }
+}
+
+void Database::releaseIndexKey(QHash<QString, int> *index, const QString &key, const int &row, const std::function<QString(const sISINDATA&)> &getKey)
+{
+    auto it = index->find(key);
+
+    if(it == index->end() || it.value() != row)
+    {
+        return;
+    }
+
+    index->erase(it);
+
+    // A duplicate takes the key over, it happens only when the user edits the ISIN or the ticker
+    for(int i = 0; i < isinList.count(); ++i)
+    {
+        if(i != row && getKey(isinList.at(i)) == key)
+        {
+            index->insert(key, i);
+            return;
+        }
+    }
+}
+
+void Database::buildIsinIndex()
+{
+    isinIndex.clear();
+    tickerIndex.clear();
+    tickerKeyIndex.clear();
+
+    isinIndex.reserve(isinList.count());
+    tickerIndex.reserve(isinList.count());
+    tickerKeyIndex.reserve(isinList.count());
+
+    // The first record wins, the same as the linear search did
+    for(int i = 0; i < isinList.count(); ++i)
+    {
+        const sISINDATA &record = isinList.at(i);
+
+        if(!isinIndex.contains(record.ISIN))
+        {
+            isinIndex.insert(record.ISIN, i);
+        }
+
+        if(record.ticker.isEmpty()) continue;
+
+        if(!tickerIndex.contains(record.ticker))
+        {
+            tickerIndex.insert(record.ticker, i);
+        }
+
+        const QString key = getTickerKey(record.ticker);
+
+        if(!key.isEmpty() && !tickerKeyIndex.contains(key))
+        {
+            tickerKeyIndex.insert(key, i);
+        }
+    }
 }
 
 bool Database::loadIsinData()
@@ -466,6 +791,7 @@ bool Database::loadIsinData()
             QDataStream in(&qFile);
             in >> isinList;
             qFile.close();
+            buildIsinIndex();
             return true;
         }
     }
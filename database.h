@@ -3,9 +3,13 @@
 
 #include <QObject>
 #include <QDataStream>
+#include <QHash>
 #include <QMap>
+#include <QMutex>
 #include <QVector>
 
+#include <functional>
+
 #include "global.h"
 
 
@@ -26,6 +30,7 @@ public:
 
     QString getCurrencyText(eCURRENCY currency);
     QString getCurrencySign(eCURRENCY currency);
+    QString getSourceText(eSTOCKSOURCE source);
 
     QVector<sSCREENERPARAM> getScreenerParams() const;
     void setScreenerParams(const QVector<sSCREENERPARAM> &value);
@@ -38,9 +43,46 @@ public:
     QVector<sISINDATA> getIsinList() const;
     void setIsinList(const QVector<sISINDATA> &value);
 
+    /**
+     * @brief findIsin, findTicker - hash lookup in the ISIN list
+     * @return record or nullptr; the pointer is valid until the ISIN list is changed
+     * The ticker is matched exactly first, then by its normalized form (case, spaces and separators are ignored)
+     */
+    const sISINDATA *findIsin(const QString &ISIN) const;
+    const sISINDATA *findTicker(const QString &ticker) const;
+
+    /**
+     * @brief addIsin - append the record, if the ISIN is not in the list yet
+     * @return false if the ISIN already exists
+     */
+    bool addIsin(const sISINDATA &record);
+
+    /**
+     * @brief updateIsin - replace the record of the ISIN, the record may change the ISIN or the ticker
+     * @return false if the ISIN does not exist
+     */
+    bool updateIsin(const QString &ISIN, const sISINDATA &record);
+
+    /**
+     * @brief updateIsins - replace the records by their ISIN and write the ISIN file once for the whole batch
+     * @return number of the updated records, the unknown ISINs are skipped
+     */
+    int updateIsins(const QVector<sISINDATA> &records);
+
+    /**
+     * @brief getTickerKey - normalized ticker, e.g. "brk.b", "BRK-B" and "BRK B" give the same key
+     */
+    static QString getTickerKey(const QString &ticker);
+
     double getExchangePrice(const eCURRENCY &rates, const double &price);
     ExchangeRatesFunctions getExchangeRatesFuncMap() const;
 
+    /**
+     * @brief getCalculationContext - settings and exchange rates snapshot for one calculation query
+     * Safe to call from the calculation threads
+     */
+    sCALCULATIONCONTEXT getCalculationContext() const;
+
 signals:
 
 public slots:
@@ -51,12 +93,21 @@ private:
     QStringList enabledScreenerParams;
     QVector<sFILTER> filterList;
     QVector<sISINDATA> isinList;
+    QHash<QString, int> isinIndex;          // ISIN, index to the isinList
+    QHash<QString, int> tickerIndex;        // ticker, index to the isinList
+    QHash<QString, int> tickerKeyIndex;     // normalized ticker, index to the isinList
 
     ExchangeRatesFunctions exchangeRatesFuncMap;
 
+    sCALCULATIONCONTEXT calculationContext;
+    mutable QMutex contextMutex;
+
     void loadConfig();
     void saveConfig();
 
+    void buildCalculationContext();
+    void updateContextIsins(const QStringList &ISINs);
+
     void loadScreenParams();
     void saveScreenerParams();
 
@@ -67,6 +118,11 @@ private:
 
     bool loadIsinData();
     void saveIsinData();
+    void buildIsinIndex();
+    bool replaceIsin(const QString &ISIN, const sISINDATA &record);
+    void indexIsin(const int &row);
+    void claimIndexKey(QHash<QString, int> *index, const QString &key, const int &row);
+    void releaseIndexKey(QHash<QString, int> *index, const QString &key, const int &row, const std::function<QString(const sISINDATA&)> &getKey);
     bool copyDirectoryFiles(const QString &fromDir, const QString &toDir, const bool &coverFileIfExist, const bool &removeOldFiles);
 };
 
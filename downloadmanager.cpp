@@ -1,15 +1,263 @@
 #include "downloadmanager.h"
 
+#include <QRandomGenerator>
 
-DownloadManager::DownloadManager(QObject *parent) : QObject(parent)
+#include <cmath>
+
+
+DownloadReply::DownloadReply(const QUrl &url, const eDOWNLOADPRIORITY &priority, const int &timeout, QObject *parent) :
+    QObject(parent), url(url), priority(priority), timeout(timeout)
+{
+    statusCode = 0;
+    errorType = NODOWNLOADERROR;
+    done = false;
+    fromCache = false;
+    attempts = 0;
+    notBefore = 0;
+    probe = false;
+    reply = nullptr;
+
+    timer.setSingleShot(true);
+}
+
+QByteArray DownloadReply::getHeader(const QByteArray &name) const
+{
+    for (const QNetworkReply::RawHeaderPair &header : headers)
+    {
+        if (header.first.compare(name, Qt::CaseInsensitive) == 0)
+        {
+            return header.second;
+        }
+    }
+
+    return QByteArray();
+}
+
+bool DownloadReply::isTransient() const
+{
+    return errorType == NETWORKERROR || errorType == TIMEOUTERROR || errorType == SERVERERROR || errorType == RATELIMITERROR;
+}
+
+void DownloadReply::cancel()
 {
+    DownloadManager *downloadManager = qobject_cast<DownloadManager*>(parent());
+
+    if (!done && downloadManager)
+    {
+        downloadManager->cancel(this);
+    }
+}
+
+
+DownloadManager::DownloadManager(QObject *parent) : QObject(parent),
+    cache(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + HTTPCACHEDIR)
+{
+    maxConcurrent = DEFAULTCONCURRENCY;
+
+    wakeTimer.setSingleShot(true);
+
+    connect(&wakeTimer, &QTimer::timeout, this, &DownloadManager::startNext);
     connect(&manager, SIGNAL(finished(QNetworkReply*)),
                 SLOT(downloadFinished(QNetworkReply*)));
+
+    // Offline runs: SPM_RECORD=<file> records the responses, SPM_REPLAY=<file> serves them without the network,
+    // SPM_REPLAY_LATENCY, SPM_REPLAY_JITTER (ms), SPM_REPLAY_ERRORS (0 - 1) and SPM_REPLAY_SEED shape the replay
+    if (qEnvironmentVariableIsSet("SPM_REPLAY"))
+    {
+        setFixture(REPLAYFIXTURE, qEnvironmentVariable("SPM_REPLAY"));
+
+        fixture->setLatency(qEnvironmentVariableIntValue("SPM_REPLAY_LATENCY"), qEnvironmentVariableIntValue("SPM_REPLAY_JITTER"));
+        fixture->setErrorRate(qEnvironmentVariable("SPM_REPLAY_ERRORS").toDouble());
+
+        if (qEnvironmentVariableIsSet("SPM_REPLAY_SEED"))
+        {
+            fixture->setSeed(static_cast<quint32>(qEnvironmentVariableIntValue("SPM_REPLAY_SEED")));
+        }
+    }
+    else if (qEnvironmentVariableIsSet("SPM_RECORD"))
+    {
+        setFixture(RECORDFIXTURE, qEnvironmentVariable("SPM_RECORD"));
+    }
+}
+
+void DownloadManager::setFixture(const eFIXTUREMODE &mode, const QString &path)
+{
+    fixture.reset();
+
+    if (mode == NOFIXTURE || path.isEmpty())
+    {
+        return;
+    }
+
+    fixture = std::make_unique<NetworkFixture> (path, mode);
+
+    qDebug() << QString("The network fixture %1 is used for the %2, %3 responses").arg(path, (mode == REPLAYFIXTURE) ? "replay" : "recording")
+                                                                                  .arg(fixture->count());
+}
+
+DownloadReply *DownloadManager::execute(const QString &urlPath, const eDOWNLOADPRIORITY &priority, const int &timeout)
+{
+    QUrl url = QUrl::fromEncoded(urlPath.toUtf8(), QUrl::TolerantMode);
+
+    DownloadReply *download = new DownloadReply(url, priority, timeout, this);
+
+    // A fresh response does not need the network, nor a free slot; the user waits for the current data,
+    // so the high priority request is sent with the ETag / Last-Modified and the server answers 304 if nothing has changed
+    sHTTPCACHEENTRY entry;
+
+    if (!fixture && priority != HIGHPRIORITY && cache.find(url, &entry) && cache.isFresh(entry))
+    {
+        setCached(download, entry, "Status code: 200 OK");
+        QTimer::singleShot(0, download, [this, download]() { finish(download); });
+
+        return download;
+    }
+
+    connect(&download->timer, &QTimer::timeout, this, [this, download]()
+            {
+                QNetworkReply *reply = download->reply;
+
+                if (reply == nullptr) return;
+
+                // abort() emits finished(), the reply is not ours anymore
+                currentDownloads.remove(reply);
+                download->reply = nullptr;
+
+                reply->abort();
+                reply->deleteLater();
+
+                failed(download, TIMEOUTERROR, QString("Timeout after %1 ms").arg(download->timeout), 0);
+            }
+            );
+
+    queues[priority].enqueue(download);
+
+    // Started from the event loop, so the caller can connect to the handle first
+    QTimer::singleShot(0, this, &DownloadManager::startNext);
+
+    return download;
+}
+
+QVector<DownloadReply*> DownloadManager::execute(const QStringList &urlPaths, const eDOWNLOADPRIORITY &priority, const int &timeout)
+{
+    QVector<DownloadReply*> downloads;
+    downloads.reserve(urlPaths.count());
+
+    for (const QString &urlPath : urlPaths)
+    {
+        downloads.push_back(execute(urlPath, priority, timeout));
+    }
+
+    return downloads;
+}
+
+void DownloadManager::setMaxConcurrent(const int &value)
+{
+    maxConcurrent = qMax(1, value);
+    startNext();
+}
+
+void DownloadManager::startNext()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 wake = -1;
+
+    // The waiting requests (retry, paused host) are skipped, so the other hosts keep going
+    for (int priority = PRIORITYCOUNT - 1; priority >= 0; --priority)
+    {
+        QQueue<DownloadReply*> &queue = queues[priority];
+
+        for (int i = 0; i < queue.count() && getRunning() < maxConcurrent; )
+        {
+            DownloadReply *download = queue.at(i);
+            qint64 ready = download->notBefore;
+
+            if (ready <= now && !isHostReady(download->url.host(), now, &ready))
+            {
+                if (ready < 0)      // the probe of the host is running
+                {
+                    ++i;
+                    continue;
+                }
+            }
+
+            if (ready > now)
+            {
+                wake = (wake < 0) ? ready : qMin(wake, ready);
+                ++i;
+                continue;
+            }
+
+            queue.removeAt(i);
+            doDownload(download);
+        }
+    }
+
+    if (wake >= 0 && (!wakeTimer.isActive() || wakeTimer.remainingTime() > wake - now))
+    {
+        wakeTimer.start(static_cast<int>(qMax(qint64(1), wake - now)));
+    }
+}
+
+bool DownloadManager::isHostReady(const QString &host, const qint64 &now, qint64 *ready) const
+{
+    auto it = hosts.constFind(host);
+
+    if (it == hosts.constEnd() || it.value().openUntil == 0)
+    {
+        return true;
+    }
+
+    if (now < it.value().openUntil)
+    {
+        *ready = it.value().openUntil;
+        return false;
+    }
+
+    if (it.value().probing)
+    {
+        *ready = -1;
+        return false;
+    }
+
+    return true;
 }
 
-void DownloadManager::doDownload(const QUrl &url)
+void DownloadManager::doDownload(DownloadReply *download)
 {
-    QNetworkRequest request(url);
+    QNetworkRequest request(download->url);
+
+    // The stale response is revalidated, the server answers 304 if it has not changed
+    sHTTPCACHEENTRY entry;
+
+    if (!fixture && cache.find(download->url, &entry))
+    {
+        if (!entry.ETag.isEmpty())
+        {
+            request.setRawHeader("If-None-Match", entry.ETag);
+        }
+
+        if (!entry.lastModified.isEmpty())
+        {
+            request.setRawHeader("If-Modified-Since", entry.lastModified);
+        }
+    }
+
+    // The first request after a pause of the host is a probe
+    sHOSTSTATE &host = hosts[download->url.host()];
+
+    if (host.openUntil != 0)
+    {
+        host.probing = true;
+        download->probe = true;
+    }
+
+    if (fixture && fixture->getMode() == REPLAYFIXTURE)
+    {
+        replay(download);
+        return;
+    }
+
     QNetworkReply *reply = manager.get(request);
 
 #if QT_CONFIG(ssl)
@@ -17,7 +265,275 @@ void DownloadManager::doDownload(const QUrl &url)
             SLOT(sslErrors(QList<QSslError>)));
 #endif
 
-    currentDownloads.push_back(reply);
+    download->attempts++;
+    download->reply = reply;
+    currentDownloads.insert(reply, download);
+
+    if (download->timeout > 0)
+    {
+        download->timer.start(download->timeout);
+    }
+}
+
+void DownloadManager::replay(DownloadReply *download)
+{
+    download->attempts++;
+    replayDownloads.insert(download);
+
+    const int delay = fixture->getDelay();
+    const bool timedOut = download->timeout > 0 && delay > download->timeout;
+
+    QTimer::singleShot(timedOut ? download->timeout : delay, download, [this, download, timedOut]() { replayFinished(download, timedOut); });
+}
+
+void DownloadManager::replayFinished(DownloadReply *download, const bool &timedOut)
+{
+    if (!replayDownloads.remove(download))      // canceled
+    {
+        return;
+    }
+
+    if (!fixture)
+    {
+        failed(download, OTHERERROR, "The fixture has been closed", 0);
+        return;
+    }
+
+    if (timedOut)
+    {
+        failed(download, TIMEOUTERROR, QString("Timeout after %1 ms").arg(download->timeout), 0);
+        return;
+    }
+
+    const eDOWNLOADERROR injected = fixture->injectError();
+
+    if (injected != NODOWNLOADERROR)
+    {
+        download->statusCode = (injected == SERVERERROR) ? 503 : (injected == RATELIMITERROR) ? 429 : 0;
+        failed(download, injected, "Injected error", 0);
+        return;
+    }
+
+    sFIXTURERESPONSE response;
+
+    if (!fixture->find(download->url, &response))
+    {
+        failed(download, OTHERERROR, QString("%1 is not in the fixture").arg(download->url.toString()), 0);
+        return;
+    }
+
+    download->statusCode = response.statusCode;
+    download->headers = response.headers;
+    download->body = response.body;
+
+    if (response.errorType != NODOWNLOADERROR)
+    {
+        failed(download, response.errorType, response.status, getRetryAfter(download->getHeader("Retry-After")));
+        return;
+    }
+
+    download->status = response.status;
+    hostSucceeded(download);
+
+    finish(download);
+    startNext();
+}
+
+void DownloadManager::cancel(DownloadReply *download)
+{
+    if (download->done) return;
+
+    download->error = "Canceled";
+    download->errorType = CANCELEDERROR;
+    download->status = download->error;
+
+    if (download->probe)
+    {
+        hosts[download->url.host()].probing = false;
+        download->probe = false;
+    }
+
+    if (download->reply)
+    {
+        QNetworkReply *reply = download->reply;
+
+        // abort() emits finished(), the reply is not ours anymore
+        currentDownloads.remove(reply);
+        download->reply = nullptr;
+
+        reply->abort();
+        reply->deleteLater();
+    }
+    else if (!replayDownloads.remove(download))
+    {
+        queues[download->priority].removeAll(download);
+    }
+
+    finish(download);
+    startNext();
+}
+
+void DownloadManager::finish(DownloadReply *download)
+{
+    if (download->done) return;
+
+    download->timer.stop();
+    download->done = true;
+
+    emit download->finished();
+
+    download->deleteLater();
+}
+
+void DownloadManager::setCached(DownloadReply *download, const sHTTPCACHEENTRY &entry, const QString &status)
+{
+    download->statusCode = 200;
+    download->status = status;
+    download->headers = entry.headers;
+    download->body = entry.body;
+    download->fromCache = true;
+}
+
+void DownloadManager::failed(DownloadReply *download, const eDOWNLOADERROR &type, const QString &error, const qint64 &retryAfter)
+{
+    download->timer.stop();
+    download->error = error;
+    download->errorType = type;
+    download->status = error;
+
+    if (type == CLIENTERROR || type == OTHERERROR)
+    {
+        // The host works, the request is wrong
+        hostSucceeded(download);
+        finish(download);
+        startNext();
+        return;
+    }
+
+    hostFailed(download, type, retryAfter);
+
+    if (download->attempts >= MAXATTEMPTS)
+    {
+        qDebug() << QString("Download of %1 failed after %2 attempts: %3").arg(download->url.toString()).arg(download->attempts).arg(error);
+
+        finish(download);
+        startNext();
+        return;
+    }
+
+    // Equal jitter: a half of the exponential delay is fixed, the other half is random, so the retries do not come in waves
+    const qint64 backoff = qMin(qint64(MAXBACKOFF), qint64(BASEBACKOFF) << (download->attempts - 1));
+    // The replay takes the jitter from the seeded generator of the fixture, so the same seed gives the same retries
+    const quint32 jitterRange = static_cast<quint32>(backoff/2 + 1);
+    const quint32 jitter = fixture ? fixture->getRandom(jitterRange) : QRandomGenerator::global()->bounded(jitterRange);
+    const qint64 delay = qMax(retryAfter, backoff/2 + static_cast<qint64>(jitter));
+
+    download->notBefore = QDateTime::currentMSecsSinceEpoch() + delay;
+    download->statusCode = 0;
+    download->body.clear();
+    download->headers.clear();
+
+    queues[download->priority].enqueue(download);
+    startNext();
+}
+
+void DownloadManager::hostSucceeded(DownloadReply *download)
+{
+    sHOSTSTATE &host = hosts[download->url.host()];
+
+    host.failures = 0;
+    host.openUntil = 0;
+    host.cooldown = BASECOOLDOWN;
+    host.probing = false;
+    download->probe = false;
+}
+
+void DownloadManager::hostFailed(DownloadReply *download, const eDOWNLOADERROR &type, const qint64 &retryAfter)
+{
+    sHOSTSTATE &host = hosts[download->url.host()];
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    host.failures++;
+
+    // A failed probe or a rate limit pauses the host at once
+    if (download->probe || type == RATELIMITERROR || host.failures >= BREAKERTHRESHOLD)
+    {
+        host.openUntil = now + qMax(retryAfter, qint64(host.cooldown));
+        host.cooldown = qMin(host.cooldown*2, int(MAXCOOLDOWN));
+
+        qDebug() << QString("Host %1 is paused for %2 s").arg(download->url.host()).arg((host.openUntil - now)/1000);
+    }
+
+    host.probing = false;
+    download->probe = false;
+}
+
+eDOWNLOADERROR DownloadManager::getErrorType(QNetworkReply *reply, const int &statusCode)
+{
+    if (statusCode == 429)
+    {
+        return RATELIMITERROR;
+    }
+    else if (statusCode >= 500)
+    {
+        return SERVERERROR;
+    }
+    else if (statusCode >= 400)
+    {
+        return CLIENTERROR;
+    }
+
+    switch (reply->error())
+    {
+        case QNetworkReply::NoError:
+            return NODOWNLOADERROR;
+        case QNetworkReply::ConnectionRefusedError:
+        case QNetworkReply::RemoteHostClosedError:
+        case QNetworkReply::HostNotFoundError:
+        case QNetworkReply::TemporaryNetworkFailureError:
+        case QNetworkReply::NetworkSessionFailedError:
+        case QNetworkReply::ProxyConnectionRefusedError:
+        case QNetworkReply::ProxyConnectionClosedError:
+        case QNetworkReply::ProxyNotFoundError:
+        case QNetworkReply::UnknownNetworkError:
+        case QNetworkReply::UnknownProxyError:
+            return NETWORKERROR;
+        case QNetworkReply::TimeoutError:
+        case QNetworkReply::ProxyTimeoutError:
+            return TIMEOUTERROR;
+        case QNetworkReply::OperationCanceledError:
+            return CANCELEDERROR;
+        default:
+            return OTHERERROR;
+    }
+}
+
+qint64 DownloadManager::getRetryAfter(const QByteArray &header)
+{
+    const QByteArray value = header.trimmed();
+
+    if (value.isEmpty())
+    {
+        return 0;
+    }
+
+    // Seconds or an HTTP date
+    bool ok;
+    const qint64 seconds = value.toLongLong(&ok);
+
+    if (ok)
+    {
+        return qMax(qint64(0), seconds*1000);
+    }
+
+    const QDateTime date = QDateTime::fromString(QString::fromLatin1(value), Qt::RFC2822Date);
+
+    if (date.isValid())
+    {
+        return qMax(qint64(0), QDateTime::currentDateTimeUtc().msecsTo(date));
+    }
+
+    return 0;
 }
 
 QString DownloadManager::saveFileName(const QUrl &url)
@@ -79,12 +595,6 @@ QString DownloadManager::isHttpRedirect(QNetworkReply *reply)
            || statusCode == 305 || statusCode == 307 || statusCode == 308;*/
 }
 
-void DownloadManager::execute(QString urlPath)
-{
-    QUrl url = QUrl::fromEncoded(urlPath.toUtf8(), QUrl::TolerantMode);
-    doDownload(url);
-}
-
 void DownloadManager::sslErrors(const QList<QSslError> &sslErrors)
 {
 #if QT_CONFIG(ssl)
@@ -99,45 +609,62 @@ void DownloadManager::sslErrors(const QList<QSslError> &sslErrors)
 
 void DownloadManager::downloadFinished(QNetworkReply *reply)
 {
-    QUrl url = reply->url();
+    DownloadReply *download = currentDownloads.take(reply);
+    reply->deleteLater();
 
-    if (reply->error())
+    if (download == nullptr)       // canceled or timed out
     {
-        qDebug() << QString("Download of %1 failed: %2 \n").arg(url.toEncoded().constData())
-                                                          .arg(reply->errorString());
+        return;
+    }
+
+    download->reply = nullptr;
+
+    QUrl url = reply->url();
 
-        emit sendData(reply->readAll(), reply->errorString());
+    download->statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    download->headers = reply->rawHeaderPairs();
+    download->body = reply->readAll();
+
+    const eDOWNLOADERROR type = getErrorType(reply, download->statusCode);
+    const QString status = (type == NODOWNLOADERROR) ? isHttpRedirect(reply) : reply->errorString();
+
+    if (fixture && fixture->getMode() == RECORDFIXTURE)
+    {
+        fixture->record(download->url, {download->statusCode, status, type, download->headers, download->body});
     }
-    else
+
+    if (type != NODOWNLOADERROR)
     {
-        QString statusCode = isHttpRedirect(reply);
+        qDebug() << QString("Download of %1 failed: %2 \n").arg(url.toEncoded().constData())
+                                                          .arg(status);
 
-        if (!statusCode.contains("200")) /*== 301 || statusCode == 302 || statusCode == 303 || statusCode == 305 || statusCode == 307 || statusCode == 308*/
-        {
-            qDebug() << "Request was redirected. \n";
+        failed(download, type, status, getRetryAfter(reply->rawHeader("Retry-After")));
+        return;
+    }
 
-            emit sendData(reply->readAll(), statusCode);
-        }
-        else
-        {
-            /*QString filename = saveFileName(url);
+    download->status = status;
+    hostSucceeded(download);
 
-            if (saveToDisk(filename, reply))
-            {
-                qDebug() << QString("Download of %1 succeeded (saved to %2) \n").arg(url.toEncoded().constData())
-                                                                               .arg(filename);
-            }*/
+    sHTTPCACHEENTRY entry;
 
-            emit sendData(reply->readAll(), statusCode);
+    if (download->statusCode == 200)
+    {
+        // The fixture runs do not touch the cache, the same as the lookups in execute and doDownload
+        if (!fixture)
+        {
+            cache.insert(download->url, download->headers, download->body);
         }
     }
-
-    currentDownloads.removeAll(reply);
-    reply->deleteLater();
-
-    if (currentDownloads.isEmpty())
+    else if (!fixture && download->statusCode == 304 && cache.find(download->url, &entry))
     {
-        // all downloads finished
-        //QCoreApplication::instance()->quit();
+        cache.touch(download->url);
+        setCached(download, entry, "Status code: 200 Not Modified");
     }
+    else
+    {
+        qDebug() << "Request was redirected. \n";
+    }
+
+    finish(download);
+    startNext();
 }
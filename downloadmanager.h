@@ -5,31 +5,203 @@
 #include <QtCore>
 #include <QtNetwork>
 
+#include "global.h"
+#include "httpcache.h"
+#include "networkfixture.h"
+
 QT_BEGIN_NAMESPACE
 class QSslError;
 QT_END_NAMESPACE
 
 
+/**
+ * @brief The DownloadReply class - handle of one request
+ * finished() is emitted exactly once, after the last attempt or a cancel, the handle is deleted after it.
+ */
+class DownloadReply : public QObject
+{
+    Q_OBJECT
+    friend class DownloadManager;
+
+public:
+    QUrl getUrl() const { return url; }
+    eDOWNLOADPRIORITY getPriority() const { return priority; }
+
+    /**
+     * @brief getStatusCode - HTTP status code, 0 if the server has not answered
+     */
+    int getStatusCode() const { return statusCode; }
+
+    /**
+     * @brief getStatus - "Status code: 200 OK" or the error string
+     */
+    QString getStatus() const { return status; }
+
+    bool isSuccess() const { return statusCode == 200 && error.isEmpty(); }
+    QString getError() const { return error; }
+    eDOWNLOADERROR getErrorType() const { return errorType; }
+
+    /**
+     * @brief isTransient - the request has failed, but it can succeed later (network, timeout, 5xx, 429)
+     */
+    bool isTransient() const;
+
+    /**
+     * @brief getAttempts - number of the sent requests, the transient failures are retried
+     */
+    int getAttempts() const { return attempts; }
+
+    QByteArray getBody() const { return body; }
+    QList<QNetworkReply::RawHeaderPair> getHeaders() const { return headers; }
+    QByteArray getHeader(const QByteArray &name) const;
+
+    bool isFinished() const { return done; }
+
+    /**
+     * @brief isFromCache - the body is from the HTTP cache, fresh or confirmed by the server (304)
+     */
+    bool isFromCache() const { return fromCache; }
+
+    /**
+     * @brief cancel - drop the queued request or abort the running one, finished() is emitted immediately
+     */
+    void cancel();
+
+signals:
+    void finished();
+
+private:
+    explicit DownloadReply(const QUrl &url, const eDOWNLOADPRIORITY &priority, const int &timeout, QObject *parent);
+
+    QUrl url;
+    eDOWNLOADPRIORITY priority;
+    int timeout;                            // ms, 0 - no timeout
+
+    int statusCode;
+    QString status;
+    QString error;
+    eDOWNLOADERROR errorType;
+    QByteArray body;
+    QList<QNetworkReply::RawHeaderPair> headers;
+    bool done;
+    bool fromCache;
+
+    int attempts;
+    qint64 notBefore;                       // ms since epoch, the retry waits until then
+    bool probe;                             // the test request of a half-open host
+
+    QNetworkReply *reply;
+    QTimer timer;
+};
+
+
 class DownloadManager : public QObject
 {
     Q_OBJECT
+    friend class DownloadReply;
     QNetworkAccessManager manager;
-    QVector<QNetworkReply *> currentDownloads;
+    HttpCache cache;
 
 public:
     explicit DownloadManager(QObject *parent = nullptr);
 
-    void execute(QString urlPath);
+    enum
+    {
+        DEFAULTTIMEOUT = 30000,             // ms
+        DEFAULTCONCURRENCY = 8,
+        MAXATTEMPTS = 4,
+        BASEBACKOFF = 1000,                 // ms, doubled with each attempt
+        MAXBACKOFF = 60000,                 // ms
+        BREAKERTHRESHOLD = 5,               // transient failures in a row which pause the host
+        BASECOOLDOWN = 30000,               // ms, doubled with each failed probe
+        MAXCOOLDOWN = 10*60000              // ms
+    };
+
+    /**
+     * @brief execute - queue the request, the requests with higher priority are sent first
+     * A fresh cached response is returned without the network, except for HIGHPRIORITY, which is always revalidated
+     * @param timeout - ms from sending the request, 0 - no timeout
+     * @return handle of the request, valid until its finished() signal
+     */
+    DownloadReply *execute(const QString &urlPath, const eDOWNLOADPRIORITY &priority = NORMALPRIORITY, const int &timeout = DEFAULTTIMEOUT);
+
+    /**
+     * @brief execute - queue all requests at once, the handles are in the order of the URLs
+     */
+    QVector<DownloadReply*> execute(const QStringList &urlPaths, const eDOWNLOADPRIORITY &priority = NORMALPRIORITY, const int &timeout = DEFAULTTIMEOUT);
+
+    /**
+     * @brief setMaxConcurrent - maximum of the requests on the network, the others wait in the queue
+     */
+    void setMaxConcurrent(const int &value);
+
+    /**
+     * @brief getCache - the responses of all requests are cached, the budget and the TTLs can be changed here
+     */
+    HttpCache *getCache() { return &cache; }
+
+    /**
+     * @brief setFixture - record the responses to the fixture or replay them from it, the HTTP cache is not used with a fixture
+     * The running requests finish in the previous mode. It is also set by the environment, see the constructor.
+     */
+    void setFixture(const eFIXTUREMODE &mode, const QString &path = QString());
+
+    /**
+     * @brief getFixture - the latency, the error rate and the seed of the replay are set here, nullptr without a fixture
+     */
+    NetworkFixture *getFixture() { return fixture.get(); }
 
 private:
-    void doDownload(const QUrl &url);
+    /**
+     * @brief sHOSTSTATE - circuit breaker of one host
+     * closed - openUntil is 0; open - the requests wait until openUntil;
+     * half-open - after openUntil only one probe is sent, its result closes or opens the host again
+     */
+    struct sHOSTSTATE
+    {
+        int failures = 0;                   // transient failures in a row
+        qint64 openUntil = 0;               // ms since epoch
+        int cooldown = BASECOOLDOWN;        // ms
+        bool probing = false;
+    };
+
+    QQueue<DownloadReply*> queues[PRIORITYCOUNT];
+    QHash<QNetworkReply*, DownloadReply*> currentDownloads;
+    QSet<DownloadReply*> replayDownloads;   // waiting for the latency of the replay
+    std::unique_ptr<NetworkFixture> fixture;
+    QHash<QString, sHOSTSTATE> hosts;
+    QTimer wakeTimer;                       // the next retry or the end of a host pause
+    int maxConcurrent;
+
+    void doDownload(DownloadReply *download);
+    void replay(DownloadReply *download);
+    void replayFinished(DownloadReply *download, const bool &timedOut);
+    int getRunning() const { return currentDownloads.count() + replayDownloads.count(); }
+    void startNext();
+    void cancel(DownloadReply *download);
+    void finish(DownloadReply *download);
+
+    /**
+     * @brief isHostReady - the host can take a request now, otherwise ready is the time it can (-1 - after the running probe)
+     */
+    bool isHostReady(const QString &host, const qint64 &now, qint64 *ready) const;
+
+    /**
+     * @brief failed - retry the transient failure with a jittered exponential backoff or finish the request
+     * @param retryAfter - ms requested by the server, 0 if not set
+     */
+    void failed(DownloadReply *download, const eDOWNLOADERROR &type, const QString &error, const qint64 &retryAfter);
+    void hostSucceeded(DownloadReply *download);
+    void hostFailed(DownloadReply *download, const eDOWNLOADERROR &type, const qint64 &retryAfter);
+
+    static eDOWNLOADERROR getErrorType(QNetworkReply *reply, const int &statusCode);
+    static qint64 getRetryAfter(const QByteArray &header);
+    void setCached(DownloadReply *download, const sHTTPCACHEENTRY &entry, const QString &status);
+
     static QString saveFileName(const QUrl &url);
     bool saveToDisk(const QString &filename, QIODevice *data);
     static QString isHttpRedirect(QNetworkReply *reply);
 
-signals:
-    void sendData(QByteArray data, QString statusCode);
-
 public Q_SLOTS:
     void downloadFinished(QNetworkReply *reply);
     void sslErrors(const QList<QSslError> &errors);
@@ -0,0 +1,345 @@
+#include "fxservice.h"
+
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QXmlStreamReader>
+#include <QtConcurrent>
+
+#include <cmath>
+
+namespace
+{
+    const double MAXDEVIATION = 0.3;        // relative change against the recent rates, more is a broken answer
+    const double MAXINCONSISTENCY = 1e-9;   // relative error of A2B * B2C against A2C
+}
+
+FxService::FxService(DownloadManager *downloadManager, QObject *parent) : QObject(parent), downloadManager(downloadManager)
+{
+    Q_ASSERT(downloadManager);
+
+    source = -1;
+}
+
+void FxService::update(const sFXRATES &previous)
+{
+    if(isRunning()) return;
+
+    this->previous = previous;
+    errors.clear();
+    source = EXCHANGERATESAPISOURCE;
+
+    request();
+}
+
+QStringList FxService::getCurrencies()
+{
+    return QStringList() << "CZK" << "EUR" << "USD" << "GBP" << "CAD";
+}
+
+sFXRATES FxService::fromSettings(const sSETTINGS &setting)
+{
+    sFXRATES rates;
+    rates.source = "settings";
+    rates.date = setting.lastExchangeRatesUpdate;
+
+    rates.rates.insert("CZK2USD", setting.CZK2USD);
+    rates.rates.insert("CZK2EUR", setting.CZK2EUR);
+    rates.rates.insert("CZK2GBP", setting.CZK2GBP);
+    rates.rates.insert("CZK2CAD", setting.CZK2CAD);
+
+    rates.rates.insert("EUR2USD", setting.EUR2USD);
+    rates.rates.insert("EUR2GBP", setting.EUR2GBP);
+    rates.rates.insert("EUR2CZK", setting.EUR2CZK);
+    rates.rates.insert("EUR2CAD", setting.EUR2CAD);
+
+    rates.rates.insert("GBP2USD", setting.GBP2USD);
+    rates.rates.insert("GBP2EUR", setting.GBP2EUR);
+    rates.rates.insert("GBP2CZK", setting.GBP2CZK);
+    rates.rates.insert("GBP2CAD", setting.GBP2CAD);
+
+    rates.rates.insert("USD2EUR", setting.USD2EUR);
+    rates.rates.insert("USD2GBP", setting.USD2GBP);
+    rates.rates.insert("USD2CZK", setting.USD2CZK);
+    rates.rates.insert("USD2CAD", setting.USD2CAD);
+
+    rates.rates.insert("CAD2USD", setting.CAD2USD);
+    rates.rates.insert("CAD2EUR", setting.CAD2EUR);
+    rates.rates.insert("CAD2GBP", setting.CAD2GBP);
+    rates.rates.insert("CAD2CZK", setting.CAD2CZK);
+
+    return rates;
+}
+
+void FxService::toSettings(const sFXRATES &rates, sSETTINGS *setting)
+{
+    Q_ASSERT(setting);
+
+    setting->CZK2USD = rates.rates.value("CZK2USD", setting->CZK2USD);
+    setting->CZK2EUR = rates.rates.value("CZK2EUR", setting->CZK2EUR);
+    setting->CZK2GBP = rates.rates.value("CZK2GBP", setting->CZK2GBP);
+    setting->CZK2CAD = rates.rates.value("CZK2CAD", setting->CZK2CAD);
+
+    setting->EUR2USD = rates.rates.value("EUR2USD", setting->EUR2USD);
+    setting->EUR2GBP = rates.rates.value("EUR2GBP", setting->EUR2GBP);
+    setting->EUR2CZK = rates.rates.value("EUR2CZK", setting->EUR2CZK);
+    setting->EUR2CAD = rates.rates.value("EUR2CAD", setting->EUR2CAD);
+
+    setting->GBP2USD = rates.rates.value("GBP2USD", setting->GBP2USD);
+    setting->GBP2EUR = rates.rates.value("GBP2EUR", setting->GBP2EUR);
+    setting->GBP2CZK = rates.rates.value("GBP2CZK", setting->GBP2CZK);
+    setting->GBP2CAD = rates.rates.value("GBP2CAD", setting->GBP2CAD);
+
+    setting->USD2EUR = rates.rates.value("USD2EUR", setting->USD2EUR);
+    setting->USD2GBP = rates.rates.value("USD2GBP", setting->USD2GBP);
+    setting->USD2CZK = rates.rates.value("USD2CZK", setting->USD2CZK);
+    setting->USD2CAD = rates.rates.value("USD2CAD", setting->USD2CAD);
+
+    setting->CAD2USD = rates.rates.value("CAD2USD", setting->CAD2USD);
+    setting->CAD2EUR = rates.rates.value("CAD2EUR", setting->CAD2EUR);
+    setting->CAD2GBP = rates.rates.value("CAD2GBP", setting->CAD2GBP);
+    setting->CAD2CZK = rates.rates.value("CAD2CZK", setting->CAD2CZK);
+}
+
+QString FxService::getUrl(const eFXSOURCE &source)
+{
+    switch(source)
+    {
+        case EXCHANGERATESAPISOURCE:
+            return "https://api.exchangeratesapi.io/latest?base=EUR&symbols=USD,CZK,GBP,CAD";
+        case ECBSOURCE:
+            return "https://www.ecb.europa.eu/stats/eurofxref/eurofxref-daily.xml";
+        default:
+            return QString();
+    }
+}
+
+void FxService::request()
+{
+    DownloadReply *reply = downloadManager->execute(getUrl(static_cast<eFXSOURCE>(source)), LOWPRIORITY);
+    connect(reply, &DownloadReply::finished, this, [this, reply]() { replyFinished(reply); });
+}
+
+void FxService::replyFinished(DownloadReply *reply)
+{
+    if(!reply->isSuccess())
+    {
+        computed({sFXRATES(), reply->getStatus()});
+        return;
+    }
+
+    const QByteArray data = reply->getBody();
+    const eFXSOURCE current = static_cast<eFXSOURCE>(source);
+    const sFXRATES previousRates = previous;
+
+    QFutureWatcher<sRESULT> *watcher = new QFutureWatcher<sRESULT>(this);
+
+    connect(watcher, &QFutureWatcher<sRESULT>::finished, this, [this, watcher]()
+            {
+                computed(watcher->result());
+                watcher->deleteLater();
+            }
+            );
+
+    watcher->setFuture(QtConcurrent::run([data, current, previousRates]()
+                                         {
+                                             return compute(data, current, previousRates);
+                                         }
+                                         ));
+}
+
+void FxService::computed(const sRESULT &result)
+{
+    if(result.error.isEmpty())
+    {
+        source = -1;
+        emit ratesReady(result.rates);
+        return;
+    }
+
+    errors << QString("%1: %2").arg(getUrl(static_cast<eFXSOURCE>(source)), result.error);
+    qDebug() << "The exchange rates source has failed!" << errors.last();
+
+    // The next source
+    if(++source < FXSOURCECOUNT)
+    {
+        request();
+        return;
+    }
+
+    source = -1;
+    emit failed(errors.join("; "));
+}
+
+FxService::sRESULT FxService::compute(const QByteArray &data, const eFXSOURCE &source, const sFXRATES &previous)
+{
+    sRESULT result;
+
+    QString base;
+    QDate date;
+    QHash<QString, double> vector;
+
+    const bool ok = (source == ECBSOURCE) ? parseEcb(data, &base, &date, &vector, &result.error)
+                                          : parseExchangeRatesApi(data, &base, &date, &vector, &result.error);
+
+    if(!ok) return result;
+
+    vector.insert(base, 1.0);
+
+    const QStringList currencies = getCurrencies();
+
+    for(const QString &currency : currencies)
+    {
+        if(!vector.contains(currency))
+        {
+            result.error = QString("The rate of %1 is missing").arg(currency);
+            return result;
+        }
+    }
+
+    result.rates.source = getUrl(source);
+    result.rates.date = date.isValid() ? date : QDate::currentDate();
+    result.rates.rates = triangulate(vector);
+    result.error = validate(result.rates, previous);
+
+    return result;
+}
+
+bool FxService::parseExchangeRatesApi(const QByteArray &data, QString *base, QDate *date, QHash<QString, double> *vector, QString *error)
+{
+    QJsonParseError parseError;
+    const QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &parseError);
+
+    if(parseError.error != QJsonParseError::NoError)
+    {
+        *error = parseError.errorString();
+        return false;
+    }
+
+    const QJsonObject jsonObject = jsonDoc.object();
+
+    if(jsonObject.contains("error"))
+    {
+        const QJsonObject errorObject = jsonObject["error"].toObject();
+        *error = QString("%1: %2").arg(errorObject["code"].toVariant().toString(), errorObject["info"].toString());
+        return false;
+    }
+
+    *base = jsonObject["base"].toString();
+    *date = QDate::fromString(jsonObject["date"].toString(), Qt::ISODate);
+
+    const QJsonObject rates = jsonObject["rates"].toObject();
+
+    for(auto it = rates.constBegin(); it != rates.constEnd(); ++it)
+    {
+        vector->insert(it.key(), it.value().toDouble());
+    }
+
+    if(base->isEmpty())
+    {
+        *error = "The base currency is missing";
+        return false;
+    }
+
+    return true;
+}
+
+bool FxService::parseEcb(const QByteArray &data, QString *base, QDate *date, QHash<QString, double> *vector, QString *error)
+{
+    // <Cube time='2020-06-05'><Cube currency='USD' rate='1.1330'/>...</Cube>, the rates are against EUR
+    QXmlStreamReader xml(data);
+
+    while(!xml.atEnd())
+    {
+        if(xml.readNext() != QXmlStreamReader::StartElement || xml.name() != QLatin1String("Cube")) continue;
+
+        const QXmlStreamAttributes attributes = xml.attributes();
+
+        if(attributes.hasAttribute("time"))
+        {
+            *date = QDate::fromString(attributes.value("time").toString(), Qt::ISODate);
+        }
+        else if(attributes.hasAttribute("currency"))
+        {
+            vector->insert(attributes.value("currency").toString(), attributes.value("rate").toDouble());
+        }
+    }
+
+    if(xml.hasError())
+    {
+        *error = xml.errorString();
+        return false;
+    }
+
+    *base = "EUR";
+
+    return true;
+}
+
+QHash<QString, double> FxService::triangulate(const QHash<QString, double> &vector)
+{
+    QHash<QString, double> rates;
+
+    const QStringList currencies = getCurrencies();
+
+    for(const QString &from : currencies)
+    {
+        for(const QString &to : currencies)
+        {
+            if(from == to) continue;
+
+            // 1 from = (base2to / base2from) to
+            rates.insert(from + "2" + to, vector.value(to) / vector.value(from));
+        }
+    }
+
+    return rates;
+}
+
+QString FxService::validate(const sFXRATES &rates, const sFXRATES &previous)
+{
+    const QStringList currencies = getCurrencies();
+
+    for(auto it = rates.rates.constBegin(); it != rates.rates.constEnd(); ++it)
+    {
+        if(!std::isfinite(it.value()) || it.value() <= 0.0)
+        {
+            return QString("The rate %1 is not valid (%2)").arg(it.key()).arg(it.value());
+        }
+    }
+
+    // A2B * B2C == A2C, it holds for the triangulated rates unless the values are out of the precision
+    for(const QString &a : currencies)
+    {
+        for(const QString &b : currencies)
+        {
+            for(const QString &c : currencies)
+            {
+                if(a == b || b == c || a == c) continue;
+
+                const double direct = rates.rates.value(a + "2" + c);
+                const double cross = rates.rates.value(a + "2" + b) * rates.rates.value(b + "2" + c);
+
+                if(std::abs(cross / direct - 1.0) > MAXINCONSISTENCY)
+                {
+                    return QString("The rates %1, %2 and %3 are not consistent").arg(a, b, c);
+                }
+            }
+        }
+    }
+
+    // The currencies can really move that much over a long time, so only the recent rates are the reference
+    if(!previous.date.isValid() || previous.date.daysTo(rates.date) > MAXPREVIOUSAGE) return QString();
+
+    for(auto it = rates.rates.constBegin(); it != rates.rates.constEnd(); ++it)
+    {
+        const double old = previous.rates.value(it.key());
+
+        if(old > 0.0 && std::abs(it.value() / old - 1.0) > MAXDEVIATION)
+        {
+            return QString("The rate %1 has changed too much (%2 -> %3)").arg(it.key()).arg(old).arg(it.value());
+        }
+    }
+
+    return QString();
+}
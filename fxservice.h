@@ -0,0 +1,90 @@
+#ifndef FXSERVICE_H
+#define FXSERVICE_H
+
+#include <QObject>
+#include <QStringList>
+
+#include "downloadmanager.h"
+#include "global.h"
+
+/**
+ * @brief The FxService class - update of the exchange rates by one request
+ * One source gives the rates of all currencies against its base, the rates of all other pairs are derived
+ * from this vector (A2B = base2B / base2A), so they are consistent with each other by construction.
+ * The download and the computing run off the GUI thread, a source with an invalid answer is replaced by the next one.
+ */
+class FxService : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FxService(DownloadManager *downloadManager, QObject *parent = nullptr);
+
+    /**
+     * @brief update - download the rates, a running update is kept
+     * @param previous - the current rates, a new rate too far from a recent previous one is not accepted
+     */
+    void update(const sFXRATES &previous);
+
+    bool isRunning() const { return source >= 0; }
+
+    /**
+     * @brief getCurrencies - currencies of the rates, eCURRENCY order
+     */
+    static QStringList getCurrencies();
+
+    /**
+     * @brief fromSettings, toSettings - rates of the settings, toSettings writes all pairs at once
+     */
+    static sFXRATES fromSettings(const sSETTINGS &setting);
+    static void toSettings(const sFXRATES &rates, sSETTINGS *setting);
+
+signals:
+    void ratesReady(sFXRATES rates);
+    void failed(QString error);
+
+private:
+    enum eFXSOURCE
+    {
+        EXCHANGERATESAPISOURCE = 0,
+        ECBSOURCE,
+        FXSOURCECOUNT
+    };
+
+    enum
+    {
+        MAXPREVIOUSAGE = 30         // days, older rates are not used for the check
+    };
+
+    struct sRESULT
+    {
+        sFXRATES rates;
+        QString error;
+    };
+
+    DownloadManager *downloadManager;
+    sFXRATES previous;
+    int source;                     // source of the running request, -1 - no update
+    QStringList errors;             // of the sources tried by the running update
+
+    void request();
+    void replyFinished(DownloadReply *reply);
+    void computed(const sRESULT &result);
+
+    static QString getUrl(const eFXSOURCE &source);
+
+    /**
+     * @brief compute - parse the answer of the source, triangulate and validate the rates
+     */
+    static sRESULT compute(const QByteArray &data, const eFXSOURCE &source, const sFXRATES &previous);
+
+    static bool parseExchangeRatesApi(const QByteArray &data, QString *base, QDate *date, QHash<QString, double> *vector, QString *error);
+    static bool parseEcb(const QByteArray &data, QString *base, QDate *date, QHash<QString, double> *vector, QString *error);
+
+    /**
+     * @brief triangulate - rates of all pairs from the rates against the base
+     */
+    static QHash<QString, double> triangulate(const QHash<QString, double> &vector);
+    static QString validate(const sFXRATES &rates, const sFXRATES &previous);
+};
+
+#endif // FXSERVICE_H
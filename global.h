@@ -2,6 +2,7 @@
 #define VARIABLES_H
 
 #include <QString>
+#include <QStringList>
 #include <QVector>
 #include <QDateTime>
 #include <QMap>
@@ -21,6 +22,9 @@ typedef QMap<int, QVector<QPair<int, double>> >         MonthDividendDataType;
 #define SCREENERALLDATA     "/screenerAllData.bin"
 #define FILTERLISTFILE      "/filterList.bin"
 #define CONFIGFILE          "/config.ini"
+#define PRICEHISTORYDIR     "/history/"
+#define HTTPCACHEDIR        "/httpcache/"
+#define TEMPLATEDIR         "/templates/"
 
 
 enum eDELIMETER
@@ -36,6 +40,13 @@ enum eCUSTOMCSVACTION
     EXPORTCSV
 };
 
+enum eCOSTBASIS
+{
+    FIFOMETHOD = 0,
+    LIFOMETHOD,
+    AVERAGEMETHOD
+};
+
 struct sSCREENERPARAM
 {
     QString name;
@@ -65,6 +76,8 @@ struct sSETTINGS
     QDate lastOverviewFrom;
     QDate lastOverviewTo;
     bool showSoldPositions;
+    eCOSTBASIS costBasisMethod;
+    QStringList exclusionRules;     // parts of stock names, ISINs or tickers excluded from the statistics
 
     // Exchange
     QDate lastExchangeRatesUpdate;
@@ -115,6 +128,40 @@ struct sSETTINGS
     bool screenerAutoLoad;
 };
 
+struct sISINDATA
+{
+    QString ISIN;
+    QString ticker;
+    QString name;
+    QString sector;
+    QString industry;
+
+    QDateTime lastUpdate;
+};
+
+/**
+ * @brief sCALCULATIONCONTEXT - snapshot of the settings used by one calculation query
+ * It is built by the Database when the settings or the ISIN list change and passed by const reference through the calculation
+ */
+struct sCALCULATIONCONTEXT
+{
+    quint64 version = 0;                    // increased with each change of the settings
+    eCURRENCY currency = CZK;               // selected currency
+    double rates[CAD + 1][CAD + 1] = {};    // [from][to], value of one unit of "from" in "to"
+    bool showSoldPositions = false;
+    eCOSTBASIS costBasisMethod = FIFOMETHOD;
+    QStringList exclusionRules;
+    QHash<QString, sISINDATA> isins;        // ISIN, the calculation threads never touch the ISIN list of the Database
+
+    /**
+     * @brief toSelected - convert the price to the selected currency, the same as Database::getExchangePrice
+     */
+    double toSelected(const eCURRENCY &from, const double &price) const
+    {
+        return price * rates[from][currency];
+    }
+};
+
 struct sOVERVIEWTABLE
 {
     QString ISIN;
@@ -129,6 +176,18 @@ struct sOVERVIEWTABLE
     double onlineStockPrice;
     double totalOnlinePrice;
     double dividend;
+    double realized;
+    double unrealized;
+    double XIRR;        // % p.a., NaN if it can not be calculated
+    double beta;        // online beta of the stock, NaN if not available
+};
+
+struct sRISKMETRICS
+{
+    double volatility;      // % p.a., NaN if it can not be calculated
+    double maxDrawdown;     // %, the largest fall from a peak
+    double sharpe;          // p.a., risk-free rate 0, NaN if it can not be calculated
+    double sortino;         // p.a., target return 0, NaN if it can not be calculated
 };
 
 struct sOVERVIEWINFO
@@ -145,18 +204,117 @@ struct sOVERVIEWINFO
     double sell;
     double portfolio;
     double performance;
+    double TWR;         // %, NaN if it can not be calculated
+    double XIRR;        // % p.a., NaN if it can not be calculated
+    sRISKMETRICS risk;  // of the daily values of the holdings
+    double beta;        // value-weighted online beta of the holdings, NaN if not available
+};
+
+struct sLOT
+{
+    QDateTime dateTime;
+    int count;
+    double price;       // per share, in the stock currency
+};
+
+struct sCOSTBASISSTATE
+{
+    QDateTime dateTime;
+    int openCount;
+    double openCost;    // cost of the open lots, in the stock currency
+    double realized;    // cumulative realized gain, in the stock currency
+};
+
+struct sHOLDING
+{
+    int count;
+    double cost;        // average cost of the held shares, in the stock currency
+};
+
+struct sPORTFOLIOSTATE
+{
+    QDate date;
+    QHash<QString, sHOLDING> holdings;      // ISIN, only non-zero positions
+    QVector<double> cash;                   // cash per eCURRENCY
+};
+
+struct sCASHFLOW
+{
+    QDate date;
+    double amount;      // investor view, money put in is negative
+};
+
+struct sCASHEVENT
+{
+    QString ticker;
+    QDate date;
+    double price;       // already converted to the selected currency
+};
+
+struct sCORRELATION
+{
+    QStringList tickers;
+    QVector<double> matrix;     // tickers x tickers, NaN if the pair has too few common days
+    QVector<int> days;          // tickers x tickers, common days of the pair
+};
+
+enum eGROUPDIMENSION
+{
+    TICKERDIMENSION = 0,
+    SECTORDIMENSION,
+    INDUSTRYDIMENSION,
+    COUNTRYDIMENSION,
+    CURRENCYDIMENSION,
+    BROKERDIMENSION,
+    DIMENSIONCOUNT
+};
+
+enum eMEASURE
+{
+    MARKETVALUEMEASURE = 0,     // value of the open positions at the end of the range
+    COSTMEASURE,                // cost of the open lots at the end of the range
+    DIVIDENDMEASURE,            // net dividends
+    FEEMEASURE,                 // transaction fees of the buys and sells
+    MEASURECOUNT
+};
+
+enum eTIMEBUCKET
+{
+    NOBUCKET = 0,
+    MONTHBUCKET,
+    YEARBUCKET
+};
+
+struct sSECURITYATTRIBUTES
+{
+    QString values[DIMENSIONCOUNT];     // eGROUPDIMENSION, empty if not known
+};
+
+struct sAGGREGATIONFACT
+{
+    int security;           // index of the sSECURITYATTRIBUTES
+    QDate date;
+    eMEASURE measure;
+    double value;           // already converted to the selected currency
 };
 
 enum eCHARTTYPE
 {
     DEPOSITCHART = 0,
     INVESTEDCHART,
+    VALUECHART,
     DIVIDENDCHART,
     MONTHDIVIDEND,
     MONTHCOMPAREDIVDEND,
     YEARDIVIDENDCHART,
     SECTORCHART,
     STOCKCHART,
+    INDUSTRYCHART,
+    COUNTRYCHART,
+    CURRENCYCHART,
+    BROKERCHART,
+    RISKCHART,
+    CORRELATIONCHART,
     ISINCHART
 };
 
@@ -181,6 +339,13 @@ enum eSTOCKSOURCE
     LYNX = 4
 };
 
+enum eRECORDFLAG
+{
+    MONEYMARKETFLAG = 0x01,     // money-market fund, e.g. DeGiro "Fundshare"
+    CASHSWEEPFLAG = 0x04,       // cash swept into or out of a fund by the broker
+    EXCLUDEDFLAG = 0x08         // excluded from the statistics, money-market funds and the user rules
+};
+
 struct sSTOCKDATA
 {
     QDateTime dateTime;
@@ -196,6 +361,8 @@ struct sSTOCKDATA
     double fee;         // dividend--tax; buy/sell--transactionfee
 
     eSTOCKSOURCE source;
+
+    quint8 flags = 0;   // eRECORDFLAG, set by StockData when the records are loaded or changed
 };
 
 struct sNEWRECORD
@@ -264,6 +431,49 @@ struct sONLINEDATA
     sTICKERINFO info;
 };
 
+struct sREFRESHRESULT
+{
+    QString ticker;
+    sONLINEDATA data;               // finviz row and info merged with the Yahoo row
+    QString error;                  // empty if both sources have been loaded
+};
+
+enum ePREFETCHTIER
+{
+    HELDTIER = 0,           // held positions, the overview prices
+    SCREENERTIER            // tickers of the active screener
+};
+
+struct sPREFETCHITEM
+{
+    QString ticker;
+    QDateTime lastUpdate;           // invalid - never updated
+    ePREFETCHTIER tier;
+};
+
+struct sFXRATES
+{
+    QString source;
+    QDate date;                     // date of the rates
+    QHash<QString, double> rates;   // "USD2CZK" -> 1 USD in CZK, all pairs of the currencies
+};
+
+enum eQUOTEFIELD
+{
+    PRICEQUOTE = 0,
+    PREVCLOSEQUOTE,
+    PEQUOTE,
+    BETAQUOTE,
+    DIVIDENDYIELDQUOTE,
+    QUOTEFIELDCOUNT
+};
+
+struct sQUOTE
+{
+    double fields[QUOTEFIELDCOUNT];             // eQUOTEFIELD, parsed once; NaN if not available
+    QString country;
+};
+
 
 enum eSCREENSOURCE
 {
@@ -271,6 +481,52 @@ enum eSCREENSOURCE
     YAHOO = 1
 };
 
+struct sHTTPCACHEENTRY
+{
+    QString url;
+    QByteArray ETag;
+    QByteArray lastModified;
+    QDateTime fetched;                                  // last download or revalidation
+    QList<QPair<QByteArray, QByteArray>> headers;
+    QByteArray body;
+};
+
+enum eDOWNLOADERROR
+{
+    NODOWNLOADERROR = 0,
+    NETWORKERROR,           // connection refused or closed, DNS, ... - transient
+    TIMEOUTERROR,           // transient
+    SERVERERROR,            // HTTP 5xx - transient
+    RATELIMITERROR,         // HTTP 429 - transient, the host is paused
+    CLIENTERROR,            // HTTP 4xx, e.g. unknown ticker - permanent
+    CANCELEDERROR,
+    OTHERERROR              // SSL, unsupported protocol, ... - permanent
+};
+
+enum eFIXTUREMODE
+{
+    NOFIXTURE = 0,          // the network
+    RECORDFIXTURE,          // the network, the responses are written to the fixture
+    REPLAYFIXTURE           // the responses of the fixture, no network
+};
+
+struct sFIXTURERESPONSE
+{
+    int statusCode = 0;
+    QString status;                                     // DownloadReply::getStatus()
+    eDOWNLOADERROR errorType = NODOWNLOADERROR;
+    QList<QPair<QByteArray, QByteArray>> headers;
+    QByteArray body;
+};
+
+enum eDOWNLOADPRIORITY
+{
+    LOWPRIORITY = 0,        // background requests, e.g. the version check
+    NORMALPRIORITY,
+    HIGHPRIORITY,           // the user waits for the result
+    PRIORITYCOUNT
+};
+
 struct sSCREENER
 {
     ScreenerDataType screenerData;
@@ -293,15 +549,4 @@ struct sFILTER
     double val2;
 };
 
-struct sISINDATA
-{
-    QString ISIN;
-    QString ticker;
-    QString name;
-    QString sector;
-    QString industry;
-
-    QDateTime lastUpdate;
-};
-
 #endif // VARIABLES_H
@@ -0,0 +1,137 @@
+#include "htmlscanner.h"
+
+HtmlScanner::HtmlScanner() : position(0)
+{
+
+}
+
+HtmlScanner::HtmlScanner(const QByteArray &data) : data(data.constData(), static_cast<std::size_t>(data.size())), position(0)
+{
+
+}
+
+HtmlScanner::HtmlScanner(std::string_view data) : data(data), position(0)
+{
+
+}
+
+bool HtmlScanner::startsWith(std::string_view prefix) const
+{
+    return remaining().substr(0, prefix.size()) == prefix;
+}
+
+bool HtmlScanner::skipPast(std::string_view needle)
+{
+    if (!skipTo(needle))
+    {
+        return false;
+    }
+
+    position += needle.size();
+
+    return true;
+}
+
+bool HtmlScanner::skipTo(std::string_view needle)
+{
+    const std::size_t found = data.find(needle, position);
+
+    if (found == std::string_view::npos)
+    {
+        position = data.size();
+        return false;
+    }
+
+    position = found;
+
+    return true;
+}
+
+bool HtmlScanner::skipToWithin(std::string_view needle, const std::size_t &limit)
+{
+    const std::size_t found = remaining().substr(0, limit).find(needle);
+
+    if (found == std::string_view::npos)
+    {
+        return false;
+    }
+
+    position += found;
+
+    return true;
+}
+
+std::string_view HtmlScanner::peek(std::string_view needle, const std::size_t &limit) const
+{
+    const std::string_view window = remaining().substr(0, limit);
+
+    if (needle.empty())
+    {
+        return window;
+    }
+
+    return window.substr(0, window.find(needle));
+}
+
+std::string_view HtmlScanner::readUntil(std::string_view needle)
+{
+    const std::size_t start = position;
+    const std::size_t found = data.find(needle, position);
+
+    if (found == std::string_view::npos)
+    {
+        position = data.size();
+        return data.substr(start);
+    }
+
+    position = found + needle.size();
+
+    return data.substr(start, found - start);
+}
+
+HtmlScanner HtmlScanner::section(std::string_view needle)
+{
+    const std::size_t start = position;
+    std::size_t found = data.find(needle, position);
+
+    if (found == std::string_view::npos)
+    {
+        found = data.size();
+    }
+
+    position = found;
+
+    return HtmlScanner(data.substr(start, found - start));
+}
+
+bool HtmlScanner::nextElement(std::string_view tag, HtmlScanner *element)
+{
+    Q_ASSERT(element);
+
+    if (!skipPast(tag))
+    {
+        return false;
+    }
+
+    *element = section(tag);
+
+    return true;
+}
+
+QString HtmlScanner::toText(std::string_view text, const bool &entities)
+{
+    QString result = QString::fromUtf8(text.data(), static_cast<int>(text.size()));
+
+    // Only the texts with an entity pay for the replacing
+    if (entities && result.contains('&'))
+    {
+        result.replace("&amp;", "&");
+        result.replace("&lt;", "<");
+        result.replace("&gt;", ">");
+        result.replace("&quot;", "\"");
+        result.replace("&#39;", "'");
+        result.replace("&nbsp;", " ");
+    }
+
+    return result;
+}
@@ -0,0 +1,79 @@
+#ifndef HTMLSCANNER_H
+#define HTMLSCANNER_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <string_view>
+
+/**
+ * @brief The HtmlScanner class - forward-only cursor over a slice of the raw (UTF-8) page
+ * Nothing is copied or decoded while scanning, only the extracted texts are converted to QString.
+ * The scanned buffer has to outlive the scanner and all its sections.
+ */
+class HtmlScanner
+{
+public:
+    HtmlScanner();
+    explicit HtmlScanner(const QByteArray &data);
+    explicit HtmlScanner(std::string_view data);
+
+    bool atEnd() const { return position >= data.size(); }
+
+    /**
+     * @brief remaining - the text from the cursor to the end of the slice
+     */
+    std::string_view remaining() const { return data.substr(position); }
+
+    bool startsWith(std::string_view prefix) const;
+
+    /**
+     * @brief skipPast - move the cursor behind the needle, false (and the cursor at the end) if there is none
+     */
+    bool skipPast(std::string_view needle);
+
+    /**
+     * @brief skipTo - move the cursor to the needle, false (and the cursor at the end) if there is none
+     */
+    bool skipTo(std::string_view needle);
+
+    /**
+     * @brief skipToWithin - move the cursor to the needle if it is within the limit (bytes from the cursor)
+     * @return false and the cursor is not moved if there is no needle in the limit
+     */
+    bool skipToWithin(std::string_view needle, const std::size_t &limit);
+
+    /**
+     * @brief peek - text from the cursor to the needle (or to the end), at most limit bytes; the cursor is not moved
+     */
+    std::string_view peek(std::string_view needle, const std::size_t &limit) const;
+
+    /**
+     * @brief readUntil - text from the cursor to the needle, the cursor moves behind the needle
+     * @return the rest of the slice if there is no needle
+     */
+    std::string_view readUntil(std::string_view needle);
+
+    /**
+     * @brief section - scanner of the text from the cursor to the needle (or to the end), the cursor moves to the needle
+     */
+    HtmlScanner section(std::string_view needle);
+
+    /**
+     * @brief nextElement - scanner of the next element with the tag up to the next one (or to the end), e.g. "<tr"
+     * The returned slice starts behind the tag name, so the attributes can be checked with startsWith()
+     */
+    bool nextElement(std::string_view tag, HtmlScanner *element);
+
+    /**
+     * @brief toText - decode UTF-8
+     * @param entities - decode the common entities too; the parameter names are kept raw, they are the keys of the saved settings
+     */
+    static QString toText(std::string_view text, const bool &entities = false);
+
+private:
+    std::string_view data;
+    std::size_t position;
+};
+
+#endif // HTMLSCANNER_H
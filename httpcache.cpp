@@ -0,0 +1,341 @@
+#include "httpcache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <climits>
+
+namespace
+{
+    const quint32 CACHEVERSION = 1;
+}
+
+HttpCache::HttpCache(const QString &path) : path(path)
+{
+    diskBudget = DEFAULTDISKBUDGET;
+    diskSize = 0;
+    accessCounter = 0;
+
+    memory.setMaxCost(DEFAULTMEMORYBUDGET);
+    writer.setMaxThreadCount(1);
+
+    ttl.insert("finviz.com", 15*60);
+    ttl.insert("finance.yahoo.com", 15*60);
+    ttl.insert("api.exchangeratesapi.io", 12*60*60);
+    ttl.insert("www.ecb.europa.eu", 12*60*60);
+    ttl.insert("ado.4fan.cz", 60*60);
+
+    QDir dir(path);
+
+    if (!dir.exists())
+    {
+        dir.mkpath(".");
+    }
+
+    // The files of the previous sessions are ordered by their last write
+    const QFileInfoList files = dir.entryInfoList(QStringList() << "*.bin", QDir::Files, QDir::Time | QDir::Reversed);
+
+    for (const QFileInfo &file : files)
+    {
+        disk.insert(file.fileName(), {file.size(), ++accessCounter});
+        diskSize += file.size();
+    }
+
+    evict();
+}
+
+HttpCache::~HttpCache()
+{
+    // The last responses are written before the application quits
+    writer.waitForDone();
+}
+
+void HttpCache::setBudget(const qint64 &memory, const qint64 &disk)
+{
+    this->memory.setMaxCost(static_cast<int>(qBound(qint64(0), memory, qint64(INT_MAX))));
+    diskBudget = qMax(qint64(0), disk);
+
+    evict();
+}
+
+void HttpCache::setTtl(const QString &host, const int &seconds)
+{
+    ttl.insert(host.toLower(), qMax(0, seconds));
+}
+
+bool HttpCache::find(const QUrl &url, sHTTPCACHEENTRY *entry)
+{
+    Q_ASSERT(entry);
+
+    const QString key = getKey(url);
+    const QString fileName = getFileName(key);
+
+    if (disk.contains(fileName))
+    {
+        disk[fileName].access = ++accessCounter;
+    }
+
+    if (const sHTTPCACHEENTRY *cached = memory.object(key))
+    {
+        *entry = *cached;
+        return true;
+    }
+
+    if (!load(key, entry))
+    {
+        return false;
+    }
+
+    memory.insert(key, new sHTTPCACHEENTRY(*entry), entry->body.size());
+
+    return true;
+}
+
+bool HttpCache::isFresh(const sHTTPCACHEENTRY &entry) const
+{
+    return entry.fetched.secsTo(QDateTime::currentDateTime()) < getTtl(QUrl(entry.url).host());
+}
+
+void HttpCache::insert(const QUrl &url, const QList<QPair<QByteArray, QByteArray>> &headers, const QByteArray &body)
+{
+    sHTTPCACHEENTRY entry;
+    entry.url = getKey(url);
+    entry.fetched = QDateTime::currentDateTime();
+    entry.headers = headers;
+    entry.body = body;
+
+    for (const QPair<QByteArray, QByteArray> &header : headers)
+    {
+        const QByteArray name = header.first.toLower();
+
+        if (name == "etag")
+        {
+            entry.ETag = header.second;
+        }
+        else if (name == "last-modified")
+        {
+            entry.lastModified = header.second;
+        }
+        else if (name == "cache-control" && header.second.toLower().contains("no-store"))
+        {
+            return;
+        }
+    }
+
+    memory.insert(entry.url, new sHTTPCACHEENTRY(entry), entry.body.size());
+    store(entry);
+}
+
+void HttpCache::touch(const QUrl &url)
+{
+    sHTTPCACHEENTRY entry;
+
+    if (!find(url, &entry))
+    {
+        return;
+    }
+
+    entry.fetched = QDateTime::currentDateTime();
+
+    memory.insert(entry.url, new sHTTPCACHEENTRY(entry), entry.body.size());
+    store(entry);
+}
+
+void HttpCache::clear()
+{
+    memory.clear();
+
+    writer.waitForDone();
+    pending.clear();
+
+    for (auto it = disk.constBegin(); it != disk.constEnd(); ++it)
+    {
+        QFile::remove(path + it.key());
+    }
+
+    disk.clear();
+    diskSize = 0;
+}
+
+QString HttpCache::getKey(const QUrl &url)
+{
+    return url.toString(QUrl::FullyEncoded);
+}
+
+QString HttpCache::getFileName(const QString &key)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex()) + ".bin";
+}
+
+int HttpCache::getTtl(const QString &host) const
+{
+    QString domain = host.toLower();
+
+    // www.finviz.com -> finviz.com -> com
+    while (!domain.isEmpty())
+    {
+        auto it = ttl.constFind(domain);
+
+        if (it != ttl.constEnd())
+        {
+            return it.value();
+        }
+
+        const int dot = domain.indexOf('.');
+        domain = (dot == -1) ? QString() : domain.mid(dot + 1);
+    }
+
+    return DEFAULTTTL;
+}
+
+void HttpCache::store(const sHTTPCACHEENTRY &entry)
+{
+    const QString fileName = getFileName(entry.url);
+    const QString filePath = path + fileName;
+
+    // The size is known when the file is written, until then the previous size is counted
+    pending.insert(fileName, QtConcurrent::run(&writer, [filePath, entry]() { return write(filePath, entry); }));
+
+    disk.insert(fileName, {disk.value(fileName).size, ++accessCounter});
+
+    evict();
+}
+
+qint64 HttpCache::write(const QString &filePath, const sHTTPCACHEENTRY &entry)
+{
+    QSaveFile file(filePath);
+
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning("Couldn't open the cache file.");
+        return -1;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << CACHEVERSION << entry.url << entry.ETag << entry.lastModified << entry.fetched << entry.headers << qCompress(entry.body);
+
+    if (!file.commit())
+    {
+        qWarning("Couldn't write the cache file.");
+        return -1;
+    }
+
+    return QFileInfo(filePath).size();
+}
+
+void HttpCache::collect(const QString &fileName)
+{
+    for (auto it = pending.begin(); it != pending.end();)
+    {
+        if (it.key() == fileName)
+        {
+            it.value().waitForFinished();
+        }
+        else if (!it.value().isFinished())
+        {
+            ++it;
+            continue;
+        }
+
+        // A failed write keeps the previous file, so its size stays
+        const qint64 size = it.value().result();
+        auto entry = disk.find(it.key());
+
+        if (entry != disk.end() && size >= 0)
+        {
+            diskSize += size - entry.value().size;
+            entry.value().size = size;
+        }
+
+        it = pending.erase(it);
+    }
+}
+
+bool HttpCache::load(const QString &key, sHTTPCACHEENTRY *entry)
+{
+    const QString fileName = getFileName(key);
+
+    if (!disk.contains(fileName))
+    {
+        return false;
+    }
+
+    // The file may be still on the writer thread
+    collect(fileName);
+
+    QFile file(path + fileName);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+
+    quint32 version;
+    QByteArray body;
+
+    in >> version;
+
+    if (version == CACHEVERSION)
+    {
+        in >> entry->url >> entry->ETag >> entry->lastModified >> entry->fetched >> entry->headers >> body;
+    }
+
+    file.close();
+
+    // Old format, damaged file or a hash collision
+    if (version != CACHEVERSION || in.status() != QDataStream::Ok || entry->url != key)
+    {
+        QFile::remove(path + fileName);
+        diskSize -= disk.take(fileName).size;
+
+        return false;
+    }
+
+    entry->body = qUncompress(body);
+
+    return true;
+}
+
+void HttpCache::evict()
+{
+    collect();
+
+    if (diskSize <= diskBudget)
+    {
+        return;
+    }
+
+    QVector<QPair<quint64, QString>> order;
+    order.reserve(disk.count());
+
+    for (auto it = disk.constBegin(); it != disk.constEnd(); ++it)
+    {
+        order.push_back(qMakePair(it.value().access, it.key()));
+    }
+
+    std::sort(order.begin(), order.end());
+
+    for (const QPair<quint64, QString> &item : qAsConst(order))
+    {
+        if (diskSize <= diskBudget) break;
+
+        // A file on the writer thread is finished first, so the write does not create it again
+        if (pending.contains(item.second))
+        {
+            collect(item.second);
+        }
+
+        QFile::remove(path + item.second);
+        diskSize -= disk.take(item.second).size;
+    }
+}
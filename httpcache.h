@@ -0,0 +1,86 @@
+#ifndef HTTPCACHE_H
+#define HTTPCACHE_H
+
+#include <QCache>
+#include <QFuture>
+#include <QHash>
+#include <QThreadPool>
+#include <QUrl>
+
+#include "global.h"
+
+/**
+ * @brief The HttpCache class - cache of the successful GET responses
+ * The recently used responses are kept in memory, all of them are stored on the disk (compressed, one file per URL).
+ * Both levels have a size budget, the least recently used responses are dropped first. A response is fresh
+ * for the TTL of its host, a stale one is revalidated with its ETag / Last-Modified.
+ * The files are compressed and written by a writer thread, the caller only waits when it reads a file still being written.
+ */
+class HttpCache
+{
+public:
+    explicit HttpCache(const QString &path);
+    ~HttpCache();
+
+    enum
+    {
+        DEFAULTMEMORYBUDGET = 16*1024*1024,     // bytes
+        DEFAULTDISKBUDGET = 64*1024*1024,       // bytes
+        DEFAULTTTL = 5*60                       // s
+    };
+
+    void setBudget(const qint64 &memory, const qint64 &disk);
+
+    /**
+     * @brief setTtl - freshness of the responses of the host and its subdomains
+     */
+    void setTtl(const QString &host, const int &seconds);
+
+    /**
+     * @brief find - response of the URL, loaded from the disk if it is not in memory
+     */
+    bool find(const QUrl &url, sHTTPCACHEENTRY *entry);
+
+    bool isFresh(const sHTTPCACHEENTRY &entry) const;
+
+    /**
+     * @brief insert - store the response, nothing is stored for "Cache-Control: no-store"
+     */
+    void insert(const QUrl &url, const QList<QPair<QByteArray, QByteArray>> &headers, const QByteArray &body);
+
+    /**
+     * @brief touch - the server has confirmed the stored response (304), it is fresh again
+     */
+    void touch(const QUrl &url);
+
+    void clear();
+
+private:
+    struct sDISKENTRY
+    {
+        qint64 size;
+        quint64 access;         // counter of the last use, a higher one is newer
+    };
+
+    QString path;
+    QCache<QString, sHTTPCACHEENTRY> memory;    // cost is the body size
+    QHash<QString, sDISKENTRY> disk;            // file name, the index is built from the directory
+    QHash<QString, int> ttl;                    // host, s
+    QHash<QString, QFuture<qint64>> pending;    // file name, size of the written file or -1
+    QThreadPool writer;                         // one thread, so the writes of one file keep their order
+    qint64 diskBudget;
+    qint64 diskSize;
+    quint64 accessCounter;
+
+    static QString getKey(const QUrl &url);
+    static QString getFileName(const QString &key);
+    int getTtl(const QString &host) const;
+
+    void store(const sHTTPCACHEENTRY &entry);
+    static qint64 write(const QString &filePath, const sHTTPCACHEENTRY &entry);
+    void collect(const QString &fileName = QString());
+    bool load(const QString &key, sHTTPCACHEENTRY *entry);
+    void evict();
+};
+
+#endif // HTTPCACHE_H
@@ -1,6 +1,7 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include "correlationheatmap.h"
 #include "customcsvimportform.h"
 #include "filterform.h"
 #include "settingsform.h"
@@ -8,18 +9,27 @@
 #include <QBrush>
 #include <QDebug>
 #include <QDesktopWidget>
+#include <QFile>
 #include <QRadialGradient>
 #include <QHash>
 #include <QInputDialog>
 #include <QLabel>
 #include <QMessageBox>
 #include <QScreen>
+#include <QSet>
 #include <QTableWidgetItem>
 #include <QTimer>
 #include <QPageSize>
 #include <QPrinter>
 #include <QtCharts>
 
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int EXPORTCOLUMNS = 70;       // the last column of the finviz export, all columns are requested
+}
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -43,8 +53,28 @@ MainWindow::MainWindow(QWidget *parent) :
     tastyworks = std::make_unique<Tastyworks> (this);
     screener = std::make_unique<Screener> (this);
     stockData = std::make_unique<StockData> (this);
+    stockData->setExclusionRules(database->getSetting().exclusionRules);
     calculation = std::make_unique<Calculation> (database.get(), stockData.get(), this);
+    refreshEngine = std::make_unique<RefreshEngine> (downloadManager.get(), this);
+    refreshEngine->setPriority(HIGHPRIORITY);       // the user waits for the refresh, the cached pages are revalidated
+    fxService = std::make_unique<FxService> (downloadManager.get(), this);
+    prefetchScheduler = std::make_unique<PrefetchScheduler> (downloadManager.get(), this);
+    prefetchScheduler->setProvider([this]() { return getPrefetchItems(); });
     refreshProgressDlg = nullptr;
+    refreshScreenerIndex = -1;
+    bulkImportScreenerIndex = -1;
+
+    connect(refreshEngine.get(), &RefreshEngine::resultsReady, this, &MainWindow::refreshResultsSlot);
+    connect(refreshEngine.get(), &RefreshEngine::progress, this, &MainWindow::refreshProgressSlot);
+    connect(refreshEngine.get(), &RefreshEngine::finished, this, &MainWindow::refreshFinishedSlot);
+    connect(fxService.get(), &FxService::ratesReady, this, &MainWindow::exchangeRatesReadySlot);
+    connect(fxService.get(), &FxService::failed, this, &MainWindow::exchangeRatesFailedSlot);
+    connect(prefetchScheduler.get(), &PrefetchScheduler::resultsReady, this, &MainWindow::prefetchResultsSlot);
+
+    overviewTablePending = false;
+    overviewInfoPending = false;
+    connect(&overviewTableWatcher, &QFutureWatcher<QVector<sOVERVIEWTABLE>>::finished, this, &MainWindow::overviewTableFinished);
+    connect(&overviewInfoWatcher, &QFutureWatcher<sOVERVIEWINFO>::finished, this, &MainWindow::overviewInfoFinished);
 
     connect(degiro.get(), &DeGiro::setDegiroData, this, &MainWindow::setDegiroDataSlot);
 
@@ -123,8 +153,7 @@ MainWindow::MainWindow(QWidget *parent) :
     // Update the exchange rates
     if (database->getSetting().lastExchangeRatesUpdate < QDate::currentDate())
     {
-        connect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::updateExchangeRates);
-        downloadManager.get()->execute("https://api.exchangeratesapi.io/latest?base=USD&symbols=EUR,CZK,GBP");
+        fxService->update(FxService::fromSettings(database->getSetting()));
     }
 
     /********************************
@@ -206,8 +235,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
     QTimer::singleShot(5000, [this]()
                        {
-                            connect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::checkVersion);
-                            downloadManager.get()->execute("http://ado.4fan.cz/SPM/version.txt");
+                            requestData("http://ado.4fan.cz/SPM/version.txt", &MainWindow::checkVersion, LOWPRIORITY);
                        });
 
 
@@ -244,6 +272,12 @@ void MainWindow::centerAndResize()
 
 MainWindow::~MainWindow()
 {
+    // The running jobs use the calculation and the stock data, let them finish before these are destroyed
+    overviewTablePending = false;
+    overviewInfoPending = false;
+    overviewTableWatcher.waitForFinished();
+    overviewInfoWatcher.waitForFinished();
+
     delete ui;
 }
 
@@ -312,6 +346,10 @@ void MainWindow::on_actionSettings_triggered()
     SettingsForm *dlg = new SettingsForm(database->getSetting(), this);
     dlg->setAttribute(Qt::WA_DeleteOnClose);
     connect(dlg, SIGNAL(setSetting(sSETTINGS)), database.get(), SLOT(setSettingSlot(sSETTINGS)));
+    connect(dlg, &SettingsForm::setSetting, [this](const sSETTINGS &set)
+            {
+                stockData->setExclusionRules(set.exclusionRules);
+            });
     connect(dlg, &SettingsForm::setScreenerParams, this, &MainWindow::setScreenerParamsSlot);
     connect(dlg, &SettingsForm::loadOnlineParameters, this, &MainWindow::loadOnlineParametersSlot);
     connect(dlg, &SettingsForm::loadDegiroCSV, this, &MainWindow::loadDegiroCSVslot);
@@ -418,90 +456,42 @@ bool MainWindow::eventFilter(QObject* obj, QEvent* event)
     }
 }
 
-void MainWindow::updateExchangeRates(const QByteArray data, QString statusCode)
+void MainWindow::exchangeRatesReadySlot(sFXRATES rates)
 {
-    disconnect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::updateExchangeRates);
-
-    if (!statusCode.contains("200"))
-    {
-        qDebug() << QString("There is something wrong with the update exchange rates request! %1").arg(statusCode);
-        setStatus(QString("There is something wrong with the update exchange rates request! %1").arg(statusCode));
-        QApplication::restoreOverrideCursor();
-    }
-    else
-    {
-        QJsonParseError error;
-        QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
-
-        if (error.error == QJsonParseError::NoError)
-        {
-            QJsonObject jsonObject = jsonDoc.object();
-
-            if (jsonObject["base"].toString() == "USD")
-            {
-                QJsonObject rates = jsonObject["rates"].toObject();
-
-                sSETTINGS set = database->getSetting();
-                set.USD2CZK = rates["CZK"].toDouble();
-                set.USD2EUR = rates["EUR"].toDouble();
-                set.USD2GBP = rates["GBP"].toDouble();
-                database->setSettingSlot(set);
-
-                connect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::updateExchangeRates);
-                downloadManager.get()->execute("https://api.exchangeratesapi.io/latest?base=EUR&symbols=USD,CZK,GBP");
-            }
-            else if (jsonObject["base"].toString() == "EUR")
-            {
-                QJsonObject rates = jsonObject["rates"].toObject();
-
-                sSETTINGS set = database->getSetting();
-                set.EUR2USD = rates["USD"].toDouble();
-                set.EUR2CZK = rates["CZK"].toDouble();
-                set.EUR2GBP = rates["GBP"].toDouble();
-                database->setSettingSlot(set);
+    // All pairs and the date are written by one save of the settings
+    sSETTINGS set = database->getSetting();
+    FxService::toSettings(rates, &set);
+    set.lastExchangeRatesUpdate = QDate::currentDate();
+    database->setSettingSlot(set);
 
+    qDebug() << QString("The exchange rates of %1 have been loaded from %2").arg(rates.date.toString("dd.MM.yyyy"), rates.source);
+    setStatus("The exchange rates have been updated!");
+}
 
-                connect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::updateExchangeRates);
-                downloadManager.get()->execute("https://api.exchangeratesapi.io/latest?base=CZK&symbols=USD,EUR,GBP");
-            }
-            else if (jsonObject["base"].toString() == "CZK")
-            {
-                QJsonObject rates = jsonObject["rates"].toObject();
+void MainWindow::exchangeRatesFailedSlot(QString error)
+{
+    setStatus(QString("The exchange rates have not been updated because of the following error: %1").arg(error));
+}
 
-                sSETTINGS set = database->getSetting();
-                set.CZK2USD = rates["USD"].toDouble();
-                set.CZK2EUR = rates["EUR"].toDouble();
-                set.CZK2GBP = rates["GBP"].toDouble();
-                set.lastExchangeRatesUpdate = QDate::currentDate();
-                database->setSettingSlot(set);
+void MainWindow::requestData(const QString &url, void (MainWindow::*handler)(const QByteArray, QString), const eDOWNLOADPRIORITY &priority)
+{
+    // Each request has its own handle, so the answers of the overlapping requests can not be mixed
+    DownloadReply *reply = downloadManager->execute(url, priority);
 
-                setStatus("The exchange rates have been updated!");
-                QApplication::restoreOverrideCursor();
-            }
-            else
+    connect(reply, &DownloadReply::finished, this, [this, reply, handler]()
             {
-                QJsonObject error = jsonObject["error"].toObject();
-                setStatus(QString("The exchange rates have not been updated because of the following error: %1: %2").arg(error["code"].toString()).arg(error["info"].toString()));
+                (this->*handler)(reply->getBody(), reply->getStatus());
             }
-        }
-        else
-        {
-            QApplication::restoreOverrideCursor();
-            setStatus(QString("The exchange rates have not been updated because of the following error: %1: %2").arg(error.error).arg(error.errorString()));
-        }
-    }
+            );
 }
 
 void MainWindow::on_actionCheck_version_triggered()
 {
-    connect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::checkVersion);
-    downloadManager.get()->execute("http://ado.4fan.cz/SPM/version.txt");
+    requestData("http://ado.4fan.cz/SPM/version.txt", &MainWindow::checkVersion);
 }
 
 void MainWindow::checkVersion(const QByteArray data, QString statusCode)
 {
-    disconnect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::checkVersion);
-
     if (!statusCode.contains("200"))
     {
         qDebug() << QString("There is something wrong with the check version request! %1").arg(statusCode);
@@ -530,7 +520,7 @@ void MainWindow::checkVersion(const QByteArray data, QString statusCode)
 void MainWindow::setOverviewHeader()
 {
     QStringList header;
-    header << "ISIN" << "Ticker" << "Name" << "Sector" << "%" << "Count" << "Average price" << "Total price" << "Fees" << "Current price" << "Total current price" << "Netto dividend";
+    header << "ISIN" << "Ticker" << "Name" << "Sector" << "%" << "Count" << "Average price" << "Total price" << "Fees" << "Current price" << "Total current price" << "Netto dividend" << "Realized" << "Unrealized" << "XIRR" << "Beta";
     ui->tableOverview->setColumnCount(header.count());
 
     ui->tableOverview->setRowCount(0);
@@ -548,11 +538,33 @@ void MainWindow::setOverviewHeader()
 
 void MainWindow::fillOverviewTable()
 {
+    // The previous request is still being calculated, it will be restarted with the current dates once it is done
+    if (overviewTableWatcher.isRunning())
+    {
+        overviewTablePending = true;
+        return;
+    }
+
     QDate from = ui->deOverviewFrom->date();
     QDate to = ui->deOverviewTo->date();
 
-    QVector<sOVERVIEWTABLE> table = calculation->getOverviewTable(from, to);
+    overviewTableWatcher.setFuture(calculation->getOverviewTableAsync(from, to));
+}
+
+void MainWindow::overviewTableFinished()
+{
+    if (overviewTablePending)   // the result is already stale, drop it
+    {
+        overviewTablePending = false;
+        fillOverviewTable();
+        return;
+    }
+
+    showOverviewTable(overviewTableWatcher.result());
+}
 
+void MainWindow::showOverviewTable(const QVector<sOVERVIEWTABLE> &table)
+{
     if (table.isEmpty())
     {
         return;
@@ -564,7 +576,7 @@ void MainWindow::fillOverviewTable()
     ui->tableOverview->setRowCount(0);
     ui->tableOverview->setSortingEnabled(false);
 
-    for (const sOVERVIEWTABLE &row : qAsConst(table))
+    for (const sOVERVIEWTABLE &row : table)
     {
         ui->tableOverview->insertRow(pos);
 
@@ -580,6 +592,10 @@ void MainWindow::fillOverviewTable()
         ui->tableOverview->setItem(pos, 9, new QTableWidgetItem(QString("%L1").arg(row.onlineStockPrice, 0, 'f', 2) + " " + currencySign));
         ui->tableOverview->setItem(pos, 10, new QTableWidgetItem(QString("%L1").arg(row.totalOnlinePrice, 0, 'f', 2) + " " + currencySign));
         ui->tableOverview->setItem(pos, 11, new QTableWidgetItem(QString("%L1").arg(row.dividend, 0, 'f', 2) + " " + currencySign));
+        ui->tableOverview->setItem(pos, 12, new QTableWidgetItem(QString("%L1").arg(row.realized, 0, 'f', 2) + " " + currencySign));
+        ui->tableOverview->setItem(pos, 13, new QTableWidgetItem(QString("%L1").arg(row.unrealized, 0, 'f', 2) + " " + currencySign));
+        ui->tableOverview->setItem(pos, 14, new QTableWidgetItem(std::isnan(row.XIRR) ? QString("-") : QString("%L1 %").arg(row.XIRR, 0, 'f', 2)));
+        ui->tableOverview->setItem(pos, 15, new QTableWidgetItem(std::isnan(row.beta) ? QString("-") : QString("%L1").arg(row.beta, 0, 'f', 2)));
 
         QLinearGradient greenGradient(-400, -400, 400, 400);
         greenGradient.setColorAt(0, QColor(124, 252, 0));
@@ -613,6 +629,15 @@ void MainWindow::fillOverviewTable()
             ui->tableOverview->item(pos, 6)->setBackground(redGradient);
         }
 
+        if (row.unrealized > 0.0)
+        {
+            ui->tableOverview->item(pos, 13)->setBackground(greenGradient);
+        }
+        else if (row.unrealized < 0.0)
+        {
+            ui->tableOverview->item(pos, 13)->setBackground(redGradient);
+        }
+
         pos++;
     }
     ui->tableOverview->setSortingEnabled(true);
@@ -925,10 +950,33 @@ void MainWindow::on_tableOverview_cellDoubleClicked(int row, int column)
 
 void MainWindow::fillOverviewSlot()
 {
+    // The previous request is still being calculated, it will be restarted with the current dates once it is done
+    if (overviewInfoWatcher.isRunning())
+    {
+        overviewInfoPending = true;
+        return;
+    }
+
     QDate from = ui->deOverviewFrom->date();
     QDate to = ui->deOverviewTo->date();
-    sOVERVIEWINFO info = calculation->getOverviewInfo(from, to);
 
+    overviewInfoWatcher.setFuture(calculation->getOverviewInfoAsync(from, to));
+}
+
+void MainWindow::overviewInfoFinished()
+{
+    if (overviewInfoPending)    // the result is already stale, drop it
+    {
+        overviewInfoPending = false;
+        fillOverviewSlot();
+        return;
+    }
+
+    showOverviewInfo(overviewInfoWatcher.result());
+}
+
+void MainWindow::showOverviewInfo(const sOVERVIEWINFO &info)
+{
     QString currencySign = database->getCurrencySign(database->getSetting().currency);
 
     double deposit = abs(info.deposit);
@@ -952,6 +1000,13 @@ void MainWindow::fillOverviewSlot()
     ui->leSell->setText(QString("%L1").arg(sell, 0, 'f', 2) + " " + currencySign);
     ui->lePortfolio->setText(QString("%L1").arg(info.portfolio, 0, 'f', 2) + " " + currencySign);
     ui->lePerformance->setText(QString("%L1 %").arg(info.performance, 0, 'f', 2));
+    ui->leTWR->setText(std::isnan(info.TWR) ? QString("-") : QString("%L1 %").arg(info.TWR, 0, 'f', 2));
+    ui->leXIRR->setText(std::isnan(info.XIRR) ? QString("-") : QString("%L1 %").arg(info.XIRR, 0, 'f', 2));
+    ui->leVolatility->setText(std::isnan(info.risk.volatility) ? QString("-") : QString("%L1 %").arg(info.risk.volatility, 0, 'f', 2));
+    ui->leMaxDrawdown->setText(QString("%L1 %").arg(info.risk.maxDrawdown, 0, 'f', 2));
+    ui->leSharpe->setText(std::isnan(info.risk.sharpe) ? QString("-") : QString("%L1").arg(info.risk.sharpe, 0, 'f', 2));
+    ui->leSortino->setText(std::isnan(info.risk.sortino) ? QString("-") : QString("%L1").arg(info.risk.sortino, 0, 'f', 2));
+    ui->leBeta->setText(std::isnan(info.beta) ? QString("-") : QString("%L1").arg(info.beta, 0, 'f', 2));
 }
 
 void MainWindow::on_pbShowGraph_clicked()
@@ -960,6 +1015,12 @@ void MainWindow::on_pbShowGraph_clicked()
     QDate to = ui->deGraphTo->date();
     eCHARTTYPE type = static_cast<eCHARTTYPE>(ui->cmGraphType->currentIndex());
 
+    if (type == CORRELATIONCHART)
+    {
+        showCorrelation(from, to);
+        return;
+    }
+
     QChartView *chartView = calculation->getChartView(type, from, to);
 
     if (chartView == nullptr)
@@ -997,7 +1058,10 @@ void MainWindow::on_pbShowGraph_clicked()
                                 border-color: navy;                                                         \
                             }";
 
-    if (type != SECTORCHART && type != STOCKCHART)
+    const bool isPieChart = (type == SECTORCHART || type == STOCKCHART || type == INDUSTRYCHART ||
+                             type == COUNTRYCHART || type == CURRENCYCHART || type == BROKERCHART);
+
+    if (!isPieChart)
     {
         QPushButton *zoomReset = new QPushButton("Zoom reset", chartWidget);
         zoomReset->setStyleSheet(pbStyle);
@@ -1152,6 +1216,46 @@ void MainWindow::on_pbShowGraph_clicked()
     chartWidget->setVisible(true);
 }
 
+void MainWindow::showCorrelation(const QDate &from, const QDate &to)
+{
+    const sCORRELATION correlation = calculation->getCorrelation(from, to);
+
+    if (correlation.tickers.count() < 2)
+    {
+        QMessageBox::information(this,
+                                 "Correlation",
+                                 "At least two open positions are needed.",
+                                 QMessageBox::Ok);
+        return;
+    }
+
+    const bool hasDays = std::any_of(correlation.days.cbegin(), correlation.days.cend(), [](const int &days)
+                                     {
+                                         return days >= 2;
+                                     }
+                                     );
+
+    if (!hasDays)
+    {
+        QMessageBox::information(this,
+                                 "Correlation",
+                                 "Not enough recorded prices within the range, the prices are recorded with each refresh of the online data.",
+                                 QMessageBox::Ok);
+        return;
+    }
+
+    QWidget *heatmapWidget = new QWidget(this, Qt::Dialog);
+    heatmapWidget->setWindowTitle("Correlation");
+
+    QVBoxLayout *VB = new QVBoxLayout(heatmapWidget);
+    VB->addWidget(new CorrelationHeatmap(correlation, heatmapWidget));
+
+    heatmapWidget->setLayout(VB);
+    heatmapWidget->setAttribute(Qt::WA_DeleteOnClose);
+    heatmapWidget->resize(800, 800);
+    heatmapWidget->setVisible(true);
+}
+
 void MainWindow::on_pbPDFExport_clicked()
 {
     QString customText;
@@ -1435,17 +1539,11 @@ void MainWindow::on_pbAddRecord_clicked()
             {
                 if (leISIN->text().isEmpty())
                 {
-                    QVector<sISINDATA> isin = database->getIsinList();
+                    const sISINDATA *record = database->findTicker(leTicker->text());
 
-                    auto it = std::find_if (isin.begin(), isin.end(), [leTicker](sISINDATA a)
-                                           {
-                                               return a.ticker == leTicker->text();
-                                           }
-                                           );
-
-                    if (it != isin.end())
+                    if (record != nullptr)
                     {
-                        leISIN->setText(it->ISIN);
+                        leISIN->setText(record->ISIN);
                     }
                 }
             });
@@ -1455,17 +1553,11 @@ void MainWindow::on_pbAddRecord_clicked()
             {
                 if (leTicker->text().isEmpty())
                 {
-                    QVector<sISINDATA> isin = database->getIsinList();
-
-                    auto it = std::find_if (isin.begin(), isin.end(), [leISIN](sISINDATA a)
-                                           {
-                                               return a.ISIN == leISIN->text();
-                                           }
-                                           );
+                    const sISINDATA *record = database->findIsin(leISIN->text());
 
-                    if (it != isin.end())
+                    if (record != nullptr)
                     {
-                        leTicker->setText(it->ticker);
+                        leTicker->setText(record->ticker);
                     }
                 }
             });
@@ -1527,8 +1619,7 @@ void MainWindow::on_pbAddRecord_clicked()
                     QApplication::setOverrideCursor(Qt::WaitCursor);
 
                     lastRequestSource = FINVIZ;
-                    connect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::addRecord);
-                    downloadManager.get()->execute("https://finviz.com/quote.ashx?t=" + leTicker->text());
+                    requestData("https://finviz.com/quote.ashx?t=" + leTicker->text(), &MainWindow::addRecord, HIGHPRIORITY);
                 }
             }
             );
@@ -1551,8 +1642,6 @@ void MainWindow::on_pbAddRecord_clicked()
 
 void MainWindow::addRecord(const QByteArray data, QString statusCode)
 {
-    disconnect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::addRecord);
-
     if (!statusCode.contains("200"))
     {
         qDebug() << QString("There is something wrong with the request! %1").arg(statusCode);
@@ -1572,7 +1661,7 @@ void MainWindow::addRecord(const QByteArray data, QString statusCode)
         valueRow.source = MANUALLY;
 
 
-        sONLINEDATA table = screener->finvizParse(QString(data));
+        sONLINEDATA table = screener->finvizParse(data);
         valueRow.stockName = table.info.stockName;
 
         StockDataType stockList = stockData->getStockData();
@@ -1582,14 +1671,8 @@ void MainWindow::addRecord(const QByteArray data, QString statusCode)
         vector.append(valueRow);
 
         // The record is not in the ISIN list, add it
-        QVector<sISINDATA> isinList = database->getIsinList();
-        auto it = std::find_if (isinList.begin(), isinList.end(), [this](sISINDATA rec)
-                            {
-                                return rec.ISIN == manualAddedRecord.ISIN;
-                            });
-
-        if (it == isinList.end())
-        {            
+        if (database->findIsin(manualAddedRecord.ISIN) == nullptr)
+        {
             sISINDATA record;
             record.ISIN = manualAddedRecord.ISIN;
             record.ticker = manualAddedRecord.ticker;
@@ -1598,8 +1681,7 @@ void MainWindow::addRecord(const QByteArray data, QString statusCode)
             record.industry = table.info.industry;
             record.lastUpdate = QDateTime(QDate(2000, 2, 31), QTime(0, 0, 0));      // should always return invalid date
 
-            isinList.push_back(record);
-            database->setIsinList(isinList);
+            database->addIsin(record);
 
             fillISINTable();
         }
@@ -1626,6 +1708,13 @@ void MainWindow::on_cbHideValues_toggled(bool checked)
         ui->leFees->setEchoMode(QLineEdit::Password);
         ui->lePortfolio->setEchoMode(QLineEdit::Password);
         ui->lePerformance->setEchoMode(QLineEdit::Password);
+        ui->leTWR->setEchoMode(QLineEdit::Password);
+        ui->leXIRR->setEchoMode(QLineEdit::Password);
+        ui->leVolatility->setEchoMode(QLineEdit::Password);
+        ui->leMaxDrawdown->setEchoMode(QLineEdit::Password);
+        ui->leSharpe->setEchoMode(QLineEdit::Password);
+        ui->leSortino->setEchoMode(QLineEdit::Password);
+        ui->leBeta->setEchoMode(QLineEdit::Password);
         ui->leSell->setEchoMode(QLineEdit::Password);
         ui->leDividends->setEchoMode(QLineEdit::Password);
         ui->leDivTax->setEchoMode(QLineEdit::Password);
@@ -1662,6 +1751,13 @@ void MainWindow::on_cbHideValues_toggled(bool checked)
         ui->leFees->setEchoMode(QLineEdit::Normal);
         ui->lePortfolio->setEchoMode(QLineEdit::Normal);
         ui->lePerformance->setEchoMode(QLineEdit::Normal);
+        ui->leTWR->setEchoMode(QLineEdit::Normal);
+        ui->leXIRR->setEchoMode(QLineEdit::Normal);
+        ui->leVolatility->setEchoMode(QLineEdit::Normal);
+        ui->leMaxDrawdown->setEchoMode(QLineEdit::Normal);
+        ui->leSharpe->setEchoMode(QLineEdit::Normal);
+        ui->leSortino->setEchoMode(QLineEdit::Normal);
+        ui->leBeta->setEchoMode(QLineEdit::Normal);
         ui->leSell->setEchoMode(QLineEdit::Normal);
         ui->leDividends->setEchoMode(QLineEdit::Normal);
         ui->leDivTax->setEchoMode(QLineEdit::Normal);
@@ -1742,6 +1838,7 @@ void MainWindow::setDegiroDataSlot(StockDataType newStockData)
 
     // Insert new DeGiro data
     QVector<sISINDATA> isinList = database->getIsinList();
+    QSet<QString> addedISIN;
     QList<QString> keys = newStockData.keys();
 
     for (const QString &key : qAsConst(keys))
@@ -1756,15 +1853,9 @@ void MainWindow::setDegiroDataSlot(StockDataType newStockData)
             QString ISIN = newStockData.value(key).first().ISIN;
             QString stockName = newStockData.value(key).first().stockName;
 
-            if (ISIN.isEmpty() || stockName.isEmpty() || stockName.toLower().contains("fundshare")) continue;
+            if (ISIN.isEmpty() || stockName.isEmpty() || (StockData::getFlags(newStockData.value(key).first()) & MONEYMARKETFLAG)) continue;
 
-            auto iter = std::find_if (isinList.begin(), isinList.end(), [ISIN](sISINDATA a)
-                                  {
-                                      return a.ISIN == ISIN;
-                                  }
-                                  );
-
-            if (iter == isinList.end())
+            if (database->findIsin(ISIN) == nullptr && !addedISIN.contains(ISIN))
             {
                 sISINDATA record;
                 record.ISIN = ISIN;
@@ -1772,6 +1863,7 @@ void MainWindow::setDegiroDataSlot(StockDataType newStockData)
                 record.lastUpdate = QDateTime(QDate(2000, 2, 31), QTime(0, 0, 0));
 
                 isinList.push_back(record);
+                addedISIN.insert(ISIN);
             }
         }
         else
@@ -1781,22 +1873,18 @@ void MainWindow::setDegiroDataSlot(StockDataType newStockData)
     }
 
 
-    // Assign tickers to ISIN
+    // Assign tickers to ISIN, the newly added ISINs do not have any ticker yet
     QList<QString> isinKeys = stockList.keys();
 
     for (const QString &key : qAsConst(isinKeys))
     {
-        auto isinIt = std::find_if (isinList.begin(), isinList.end(), [key](sISINDATA a)
-                                   {
-                                       return a.ISIN == key;
-                                   }
-                                   );
+        const sISINDATA *record = database->findIsin(key);
 
         QString ticker;
 
-        if (isinIt != isinList.end())
+        if (record != nullptr)
         {
-            ticker = isinIt->ticker;
+            ticker = record->ticker;
         }
 
         QVector<sSTOCKDATA> vector = stockList.value(key);
@@ -1938,14 +2026,11 @@ void MainWindow::loadOnlineParametersSlot()
     screenerParams.clear();
     database->setScreenerParams(screenerParams);
 
-    connect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::parseOnlineParameters);
-    downloadManager.get()->execute("https://finviz.com/quote.ashx?t=T");
+    requestData("https://finviz.com/quote.ashx?t=T", &MainWindow::parseOnlineParameters);
 }
 
 void MainWindow::parseOnlineParameters(const QByteArray data, QString statusCode)
 {
-    disconnect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::parseOnlineParameters);
-
     if (!statusCode.contains("200"))
     {
         qDebug() << QString("There is something wrong with the request! %1").arg(statusCode);
@@ -1975,11 +2060,11 @@ void MainWindow::parseOnlineParameters(const QByteArray data, QString statusCode
         switch (lastRequestSource)
         {
             case FINVIZ:
-                table = screener->finvizParse(QString(data));
+                table = screener->finvizParse(data);
                 param.name = "FINVIZ";
                 break;
             case YAHOO:
-                table = screener->yahooParse(QString(data));
+                table = screener->yahooParse(data);
                 param.name = "YAHOO";
                 break;
         }
@@ -1999,8 +2084,7 @@ void MainWindow::parseOnlineParameters(const QByteArray data, QString statusCode
         if (lastRequestSource == FINVIZ)
         {
             lastRequestSource = YAHOO;
-            connect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::parseOnlineParameters);
-            downloadManager.get()->execute("https://finance.yahoo.com/quote/T/key-statistics");
+            requestData("https://finance.yahoo.com/quote/T/key-statistics", &MainWindow::parseOnlineParameters);
         }
         else        // end
         {       
@@ -2080,9 +2164,8 @@ void MainWindow::on_pbAddTicker_clicked()
 
     lastLoadedTableData.row.clear();
     lastRequestSource = FINVIZ;
-    connect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::getData);
     QString request = QString("https://finviz.com/quote.ashx?t=%1").arg(ticker);
-    downloadManager->execute(request);
+    requestData(request, &MainWindow::getData, HIGHPRIORITY);
 }
 
 void MainWindow::getData(const QByteArray data, QString statusCode)
@@ -2106,12 +2189,12 @@ void MainWindow::getData(const QByteArray data, QString statusCode)
         switch (lastRequestSource)
         {
             case FINVIZ:
-                table = screener->finvizParse(QString(data));
+                table = screener->finvizParse(data);
                 table.info.ticker = ticker;
                 lastLoadedTableData.info = table.info;
                 break;
             case YAHOO:
-                table = screener->yahooParse(QString(data));
+                table = screener->yahooParse(data);
                 break;
         }
 
@@ -2124,30 +2207,21 @@ void MainWindow::getData(const QByteArray data, QString statusCode)
         {
             lastRequestSource = YAHOO;
             QString request = QString("https://finance.yahoo.com/quote/%1/key-statistics").arg(ticker);
-            downloadManager->execute(request);
+            requestData(request, &MainWindow::getData, HIGHPRIORITY);
         }
         else    // end
         {
-            disconnect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::getData);
-
             QString ISIN;
-            QVector<sISINDATA> isinList = database->getIsinList();
-
-            auto it = std::find_if (isinList.begin(), isinList.end(),
-                                   [ticker](sISINDATA a)
-                                   {
-                                       return a.ticker == ticker;
-                                   } );
+            const sISINDATA *record = database->findTicker(ticker);
 
-            if (it != isinList.end())
+            if (record != nullptr)
             {
-                ISIN = it->ISIN;
+                ISIN = record->ISIN;
             }
 
             stockData->saveOnlineStockInfo(ISIN, lastLoadedTableData);
             updateStockDataSlot(ISIN, lastLoadedTableData);
             dataLoaded();
-            emit refreshTickers(ticker);
             setStatus(QString("Ticker %1 has been updated.").arg(ticker));
         }
     }
@@ -2155,73 +2229,18 @@ void MainWindow::getData(const QByteArray data, QString statusCode)
 
 void MainWindow::dataLoaded()
 {
-    QStringList screenerParams = database->getEnabledScreenerParams();
+    applyScreenerData(ui->leTicker->text().trimmed(), lastLoadedTableData);
 
-    TickerDataType tickerLine;
-
-    QString ticker = ui->leTicker->text().trimmed();
+    ui->leTicker->clear();
+}
 
+void MainWindow::applyScreenerData(const QString &ticker, const sONLINEDATA &data, const bool &save)
+{
     if (ticker.isEmpty()) return;
 
-    QStringList infoData;
-    infoData << "Ticker" << "Stock name" << "Sector" << "Industry" << "Country";
-
-    bool bParamFound = false;
-
-    for (int param = 0; param<screenerParams.count(); ++param)
-    {
-        bParamFound = false;
-
-        for (int table = 0; table<lastLoadedTableData.row.count() && !bParamFound; ++table)
-        {
-            for (int info = 0; info<infoData.count() && !bParamFound; ++info)
-            {
-                if (screenerParams.at(param).toLower() == infoData.at(info).toLower())
-                {
-                    if (infoData.at(info) == "Industry")
-                    {
-                        tickerLine.push_back(qMakePair(infoData.at(info), lastLoadedTableData.info.industry));
-                    }
-                    else if (infoData.at(info) == "Ticker")
-                    {
-                        tickerLine.push_back(qMakePair(infoData.at(info), lastLoadedTableData.info.ticker));
-                    }
-                    else if (infoData.at(info) == "Stock name")
-                    {
-                        tickerLine.push_back(qMakePair(infoData.at(info), lastLoadedTableData.info.stockName));
-                    }
-                    else if (infoData.at(info) == "Sector")
-                    {
-                        tickerLine.push_back(qMakePair(infoData.at(info), lastLoadedTableData.info.sector));
-                    }
-                    else if (infoData.at(info) == "Country")
-                    {
-                        tickerLine.push_back(qMakePair(infoData.at(info), lastLoadedTableData.info.country));
-                    }
-
-                    bParamFound = true;
-                }
-            }
-        }
-    }
-
-
-    bParamFound = false;
-
-    for (int param = 0; param<screenerParams.count(); ++param)
-    {
-        bParamFound = false;
-
-        for (int table = 0; table<lastLoadedTableData.row.count() && !bParamFound; ++table)
-        {
-            if (lastLoadedTableData.row.contains(screenerParams.at(param)))
-            {
-                tickerLine.push_back(qMakePair(screenerParams.at(param), lastLoadedTableData.row.value(screenerParams.at(param))));
+    QStringList screenerParams = database->getEnabledScreenerParams();
 
-                bParamFound = true;
-            }
-        }
-    }
+    TickerDataType tickerLine = getTickerLine(screenerParams, data);
 
     if (tickerLine.isEmpty()) return;
 
@@ -2241,7 +2260,7 @@ void MainWindow::dataLoaded()
 
         QVector<sSCREENER> allScreenerData = screener->getAllScreenerData();
 
-        if (currentScreenerIndex < allScreenerData.count())
+        if (save && currentScreenerIndex < allScreenerData.count())
         {
             allScreenerData[currentScreenerIndex] = currentScreenerData;
             screener->setAllScreenerData(allScreenerData);
@@ -2261,8 +2280,11 @@ void MainWindow::dataLoaded()
 
         if (currentScreenerIndex < allScreenerData.count())
         {
-            allScreenerData[currentScreenerIndex] = currentScreenerData;
-            screener->setAllScreenerData(allScreenerData);
+            if (save)
+            {
+                allScreenerData[currentScreenerIndex] = currentScreenerData;
+                screener->setAllScreenerData(allScreenerData);
+            }
 
             screenerTabs.at(currentScreenerIndex)->setScreenerData(currentScreenerData);
 
@@ -2283,7 +2305,7 @@ void MainWindow::dataLoaded()
             {
                 for (int col = 0; col<tab->getScreenerTable()->columnCount()-1 && !found; ++col)
                 {
-                    if (tab->getScreenerTable()->item(row, col) && tab->getScreenerTable()->item(row, col)->text() == ui->leTicker->text())
+                    if (tab->getScreenerTable()->item(row, col) && tab->getScreenerTable()->item(row, col)->text() == ticker)
                     {
                         currentRowInTable = row;
                         found = true;
@@ -2363,8 +2385,73 @@ void MainWindow::dataLoaded()
             }
         }
     }
+}
 
-    ui->leTicker->clear();
+TickerDataType MainWindow::getTickerLine(const QStringList &screenerParams, const sONLINEDATA &data)
+{
+    TickerDataType tickerLine;
+
+    QStringList infoData;
+    infoData << "Ticker" << "Stock name" << "Sector" << "Industry" << "Country";
+
+    bool bParamFound = false;
+
+    for (int param = 0; param<screenerParams.count(); ++param)
+    {
+        bParamFound = false;
+
+        for (int table = 0; table<data.row.count() && !bParamFound; ++table)
+        {
+            for (int info = 0; info<infoData.count() && !bParamFound; ++info)
+            {
+                if (screenerParams.at(param).toLower() == infoData.at(info).toLower())
+                {
+                    if (infoData.at(info) == "Industry")
+                    {
+                        tickerLine.push_back(qMakePair(infoData.at(info), data.info.industry));
+                    }
+                    else if (infoData.at(info) == "Ticker")
+                    {
+                        tickerLine.push_back(qMakePair(infoData.at(info), data.info.ticker));
+                    }
+                    else if (infoData.at(info) == "Stock name")
+                    {
+                        tickerLine.push_back(qMakePair(infoData.at(info), data.info.stockName));
+                    }
+                    else if (infoData.at(info) == "Sector")
+                    {
+                        tickerLine.push_back(qMakePair(infoData.at(info), data.info.sector));
+                    }
+                    else if (infoData.at(info) == "Country")
+                    {
+                        tickerLine.push_back(qMakePair(infoData.at(info), data.info.country));
+                    }
+
+                    bParamFound = true;
+                }
+            }
+        }
+    }
+
+
+    bParamFound = false;
+
+    for (int param = 0; param<screenerParams.count(); ++param)
+    {
+        bParamFound = false;
+
+        for (int table = 0; table<data.row.count() && !bParamFound; ++table)
+        {
+            if (data.row.contains(screenerParams.at(param)))
+            {
+                tickerLine.push_back(qMakePair(screenerParams.at(param), data.row.value(screenerParams.at(param))));
+
+                bParamFound = true;
+            }
+        }
+    }
+
+    return tickerLine;
 }
 
 // Return a row for specific ticker
@@ -2866,60 +2953,367 @@ void MainWindow::on_pbRefresh_clicked()
 
     if (!currentTickers.isEmpty())
     {
+        refreshScreenerIndex = currentScreenerIndex;
+        refreshErrors.clear();
+
         createProgressDialog(0, currentTickers.count());
 
-        connect(this, &MainWindow::refreshTickers, this, &MainWindow::refreshTickersSlot);
+        setStatus(QString("Refreshing %1 tickers").arg(currentTickers.count()));
+        refreshEngine->start(currentTickers);
+    }
+}
+
+void MainWindow::on_pbBulkImport_clicked()
+{
+    if (currentScreenerIndex >= screenerTabs.count() || currentScreenerIndex < 0)
+    {
+        QMessageBox::warning(this,
+                             "Screener",
+                             "Please create at least one screener!",
+                             QMessageBox::Ok);
+
+        setStatus("Please create at least one screener!");
+
+        return;
+    }
+
+    bool ok;
+    QString text = QInputDialog::getText(this,
+                                         "Bulk import",
+                                         "Finviz screener filters (e.g. idx_sp500,sec_technology) or the path of a saved finviz export file:",
+                                         QLineEdit::Normal,
+                                         QString(),
+                                         &ok).trimmed();
+
+    if (!ok || text.isEmpty()) return;
+
+    // A saved export is imported as it is, e.g. to check the parsing without the network
+    QFile file(text);
+
+    if (file.exists())
+    {
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            setStatus(QString("The file %1 could not be opened!").arg(text));
+            return;
+        }
+
+        bulkImportScreenerIndex = currentScreenerIndex;
+        bulkImportData(file.readAll(), "200");
+        file.close();
 
-        ui->leTicker->setText(currentTickers.first());
-        ui->pbAddTicker->click();
+        return;
     }
+
+    QStringList columns;
+
+    for (int col = 0; col<=EXPORTCOLUMNS; ++col)
+    {
+        columns << QString::number(col);
+    }
+
+    bulkImportScreenerIndex = currentScreenerIndex;
+    setStatus("Downloading the finviz export");
+
+    QString request = QString("https://finviz.com/export.ashx?v=152&f=%1&c=%2").arg(text, columns.join(","));
+    requestData(request, &MainWindow::bulkImportData, HIGHPRIORITY);
 }
 
-void MainWindow::refreshTickersSlot(QString ticker)
+void MainWindow::bulkImportData(const QByteArray data, QString statusCode)
 {
-    int pos = currentTickers.indexOf(ticker);
+    if (!statusCode.contains("200"))
+    {
+        qDebug() << QString("There is something wrong with the request! %1").arg(statusCode);
+        setStatus(QString("There is something wrong with the request! %1").arg(statusCode));
+        return;
+    }
 
-    if (pos == -1)   // error
+    QVector<sONLINEDATA> rows = Screener::finvizExportParse(data);
+
+    if (rows.isEmpty())
     {
-        disconnect(this, &MainWindow::refreshTickers, this, &MainWindow::refreshTickersSlot);
+        setStatus("The finviz export does not contain any ticker!");
+        return;
+    }
 
-        if (refreshProgressDlg)
+    // The rows belong to the screener where the import has been started
+    const int screenerIndex = currentScreenerIndex;
+    currentScreenerIndex = bulkImportScreenerIndex;
+
+    importScreenerRows(rows);
+
+    currentScreenerIndex = screenerIndex;
+}
+
+void MainWindow::importScreenerRows(const QVector<sONLINEDATA> &rows)
+{
+    if (currentScreenerIndex >= screenerTabs.count() || currentScreenerIndex < 0) return;
+
+    QStringList screenerParams = database->getEnabledScreenerParams();
+    sSCREENER currentScreenerData = screenerTabs.at(currentScreenerIndex)->getScreenerData();
+
+    // Ticker -> row, one lookup per imported ticker instead of a scan of the whole screener
+    QHash<QString, int> tickerRows;
+    tickerRows.reserve(currentScreenerData.screenerData.count() + rows.count());
+
+    for (int row = 0; row<currentScreenerData.screenerData.count(); ++row)
+    {
+        for (const QPair<QString, QString> &item : currentScreenerData.screenerData.at(row))
+        {
+            if (item.first == "Ticker")
+            {
+                tickerRows.insert(item.second, row);
+                break;
+            }
+        }
+    }
+
+    int added = 0;
+    int updated = 0;
+    QVector<sISINDATA> isinRecords;
+
+    for (const sONLINEDATA &data : rows)
+    {
+        TickerDataType tickerLine = getTickerLine(screenerParams, data);
+
+        if (tickerLine.isEmpty()) continue;
+
+        auto it = tickerRows.constFind(data.info.ticker);
+
+        if (it == tickerRows.constEnd())
+        {
+            tickerRows.insert(data.info.ticker, currentScreenerData.screenerData.count());
+            currentScreenerData.screenerData.push_back(tickerLine);
+            added++;
+        }
+        else
         {
-            disconnect(refreshProgressDlg, &QProgressDialog::canceled, this, &MainWindow::refreshTickersCanceled);
-            updateProgressDialog(pos+1);
-            refreshProgressDlg->close();
+            currentScreenerData.screenerData[it.value()] = tickerLine;
+            updated++;
         }
 
-        setStatus("An error appeard during the refresh");
+        // Only the owned stocks keep the online info, so the export does not flood the stock data
+        const sISINDATA *record = database->findTicker(data.info.ticker);
+
+        if (record != nullptr)
+        {
+            stockData->saveOnlineStockInfo(record->ISIN, data);
+
+            sISINDATA isinRecord;
+
+            if (getUpdatedIsinRecord(record->ISIN, data, &isinRecord))
+            {
+                isinRecords.push_back(isinRecord);
+            }
+        }
     }
-    else if (pos == (currentTickers.count() - 1))  // last
+
+    // The ISIN and the screener files are written and the tables are filled once for the whole export
+    const bool isinUpdated = database->updateIsins(isinRecords) > 0;
+    QVector<sSCREENER> allScreenerData = screener->getAllScreenerData();
+
+    if (currentScreenerIndex < allScreenerData.count())
     {
-        if (refreshProgressDlg)
+        allScreenerData[currentScreenerIndex] = currentScreenerData;
+        screener->setAllScreenerData(allScreenerData);
+    }
+
+    screenerTabs.at(currentScreenerIndex)->setScreenerData(currentScreenerData);
+    fillScreenerTable(screenerTabs.at(currentScreenerIndex));
+
+    if (isinUpdated)
+    {
+        fillISINTable();
+        fillOverviewTable();
+    }
+
+    setStatus(QString("%1 tickers have been added, %2 tickers have been updated").arg(added).arg(updated));
+}
+
+void MainWindow::refreshResultsSlot(QVector<sREFRESHRESULT> results)
+{
+    // The results belong to the screener where the refresh has been started
+    const int screenerIndex = currentScreenerIndex;
+    currentScreenerIndex = refreshScreenerIndex;
+
+    QVector<sISINDATA> isinRecords;
+
+    for (const sREFRESHRESULT &result : qAsConst(results))
+    {
+        if (!result.error.isEmpty())
         {
-            disconnect(refreshProgressDlg, &QProgressDialog::canceled, this, &MainWindow::refreshTickersCanceled);
-            updateProgressDialog(pos+1);
+            qDebug() << QString("Ticker %1 has not been refreshed! %2").arg(result.ticker, result.error);
+            refreshErrors << result.ticker;
+            continue;
         }
 
-        disconnect(this, &MainWindow::refreshTickers, this, &MainWindow::refreshTickersSlot);
-        setStatus("All tickers have been refreshed");
+        QString ISIN;
+        const sISINDATA *record = database->findTicker(result.ticker);
+
+        if (record != nullptr)
+        {
+            ISIN = record->ISIN;
+        }
+
+        stockData->saveOnlineStockInfo(ISIN, result.data);
+
+        sISINDATA isinRecord;
+
+        if (getUpdatedIsinRecord(ISIN, result.data, &isinRecord))
+        {
+            isinRecords.push_back(isinRecord);
+        }
+
+        applyScreenerData(result.ticker, result.data, false);
     }
-    else
+
+    // The ISIN and the screener files are written once per batch
+    const bool isinUpdated = database->updateIsins(isinRecords) > 0;
+
+    QVector<sSCREENER> allScreenerData = screener->getAllScreenerData();
+
+    if (refreshScreenerIndex >= 0 && refreshScreenerIndex < allScreenerData.count() && refreshScreenerIndex < screenerTabs.count())
     {
-        if (refreshProgressDlg)
+        allScreenerData[refreshScreenerIndex] = screenerTabs.at(refreshScreenerIndex)->getScreenerData();
+        screener->setAllScreenerData(allScreenerData);
+    }
+
+    currentScreenerIndex = screenerIndex;
+
+    if (isinUpdated)
+    {
+        fillISINTable();
+        fillOverviewTable();
+    }
+}
+
+void MainWindow::prefetchResultsSlot(QVector<sREFRESHRESULT> results)
+{
+    QVector<sISINDATA> isinRecords;
+    bool screenerUpdated = false;
+
+    for (const sREFRESHRESULT &result : qAsConst(results))
+    {
+        const sISINDATA *record = database->findTicker(result.ticker);
+
+        if (record != nullptr)
+        {
+            const QString ISIN = record->ISIN;
+
+            stockData->saveOnlineStockInfo(ISIN, result.data);
+
+            sISINDATA isinRecord;
+
+            if (getUpdatedIsinRecord(ISIN, result.data, &isinRecord))
+            {
+                isinRecords.push_back(isinRecord);
+            }
+        }
+
+        // The prefetch only updates the tickers which are already in the screener
+        if (findScreenerTicker(result.ticker) >= 0)
         {
-            updateProgressDialog(pos+1);
+            applyScreenerData(result.ticker, result.data, false);
+            screenerUpdated = true;
+        }
+    }
+
+    if (screenerUpdated)
+    {
+        QVector<sSCREENER> allScreenerData = screener->getAllScreenerData();
+
+        if (currentScreenerIndex >= 0 && currentScreenerIndex < allScreenerData.count() && currentScreenerIndex < screenerTabs.count())
+        {
+            allScreenerData[currentScreenerIndex] = screenerTabs.at(currentScreenerIndex)->getScreenerData();
+            screener->setAllScreenerData(allScreenerData);
+        }
+    }
+
+    // The ISIN file is written once per batch
+    if (database->updateIsins(isinRecords) > 0)
+    {
+        fillISINTable();
+        fillOverviewTable();
+    }
+
+    setStatus(QString("%1 tickers have been refreshed in the background").arg(results.count()));
+}
+
+QVector<sPREFETCHITEM> MainWindow::getPrefetchItems()
+{
+    QVector<sPREFETCHITEM> items;
+
+    // The user refresh has the whole budget of the hosts
+    if (refreshEngine->isRunning()) return items;
+
+    // The held positions come from the nearest checkpoint, not from a scan of all transactions per ISIN
+    const QHash<QString, sHOLDING> holdings = calculation->getHoldings(QDate::currentDate());
+
+    for (auto it = holdings.constBegin(); it != holdings.constEnd(); ++it)
+    {
+        const sISINDATA *record = database->findIsin(it.key());
+
+        // The ETFs are not on finviz, they are updated from their row only
+        if (it.value().count <= 0 || record == nullptr || record->ticker.isEmpty() || record->sector == "ETF") continue;
+
+        items.push_back({record->ticker, record->lastUpdate, HELDTIER});
+    }
+
+    if (currentScreenerIndex >= 0 && currentScreenerIndex < screenerTabs.count())
+    {
+        const sSCREENER currentScreenerData = screenerTabs.at(currentScreenerIndex)->getScreenerData();
+
+        for (const TickerDataType &line : currentScreenerData.screenerData)
+        {
+            for (const QPair<QString, QString> &item : line)
+            {
+                if (item.first == "Ticker")
+                {
+                    const sISINDATA *record = database->findTicker(item.second);
+                    items.push_back({item.second, record ? record->lastUpdate : QDateTime(), SCREENERTIER});
+                    break;
+                }
+            }
         }
+    }
+
+    return items;
+}
+
+void MainWindow::refreshProgressSlot(int done, int total)
+{
+    Q_UNUSED(total)
+
+    if (refreshProgressDlg)
+    {
+        updateProgressDialog(done);
+    }
+}
 
-        QString next = currentTickers.at(pos + 1);
+void MainWindow::refreshFinishedSlot(int failed)
+{
+    if (refreshProgressDlg)
+    {
+        disconnect(refreshProgressDlg, &QProgressDialog::canceled, this, &MainWindow::refreshTickersCanceled);
+        updateProgressDialog(currentTickers.count());
+    }
 
-        ui->leTicker->setText(next);
-        ui->pbAddTicker->click();
+    if (failed == 0)
+    {
+        setStatus("All tickers have been refreshed");
+    }
+    else
+    {
+        setStatus(QString("%1 tickers have not been refreshed: %2").arg(failed).arg(refreshErrors.join(", ")));
     }
+
+    refreshErrors.clear();
 }
 
 void MainWindow::refreshTickersCanceled()
 {
-    disconnect(this, &MainWindow::refreshTickers, this, &MainWindow::refreshTickersSlot);
+    refreshEngine->cancel();
+    refreshErrors.clear();
 
     if (refreshProgressDlg)
     {
@@ -3048,19 +3442,9 @@ void MainWindow::on_pbISINAdd_clicked()
     record.industry = ui->leISINIndustry->text();
     record.lastUpdate = QDateTime(QDate(2000, 2, 31), QTime(0, 0, 0));
 
-    QVector<sISINDATA> isin = database->getIsinList();
-
-    auto it = std::find_if (isin.begin(), isin.end(),
-                           [record](sISINDATA a)
-                           {
-                               return a.ISIN == record.ISIN;
-                           }
-                           );
-
-    if (it != isin.end())
+    if (database->addIsin(record))
     {
-        isin.push_back(record);
-        database->setIsinList(isin);
+        fillISINTable();
     }
     else
     {
@@ -3144,8 +3528,6 @@ void MainWindow::fillISINTable()
                         {
                             lastLoadedTableData.row.clear();
 
-                            connect(downloadManager.get(), &DownloadManager::sendData, this, &MainWindow::getData);
-
                             QString request;
 
                             if (isinList.at(row).sector == "ETF")
@@ -3159,7 +3541,7 @@ void MainWindow::fillISINTable()
                                 request = QString("https://finviz.com/quote.ashx?t=%1").arg(ticker);
                             }
 
-                            downloadManager->execute(request);
+                            requestData(request, &MainWindow::getData, HIGHPRIORITY);
                         }
                     }
                 }
@@ -3267,29 +3649,25 @@ void MainWindow::on_tableISIN_cellDoubleClicked(int row, int column)
     {
         clickedItem->setText(newText);
 
-        QVector<sISINDATA> isinList = database->getIsinList();
         QString ISIN = ui->tableISIN->item(row, 0)->text();
+        const sISINDATA *found = database->findIsin(ISIN);
 
-        auto it = std::find_if (isinList.begin(), isinList.end(),
-                               [ISIN](sISINDATA a)
-                               {
-                                   return a.ISIN == ISIN;
-                               } );
-
-        if (it != isinList.end())
+        if (found != nullptr)
         {
+            sISINDATA record = *found;
+
             switch(column)
             {
-                case 0: it->ISIN = newText;
+                case 0: record.ISIN = newText;
                     break;
 
                 case 1:
                 {
-                    it->ticker = newText;
+                    record.ticker = newText;
 
                     if (previousText != newText)             // ticker was changed so it should be possible to update the data and not wait to the next day
                     {
-                        it->lastUpdate = QDateTime();
+                        record.lastUpdate = QDateTime();
 
                         QTableWidgetItem *dateItem = ui->tableISIN->item(row, 5);
 
@@ -3301,17 +3679,17 @@ void MainWindow::on_tableISIN_cellDoubleClicked(int row, int column)
                 }
                 break;
 
-                case 2: it->name = newText;
+                case 2: record.name = newText;
                     break;
 
-                case 3: it->sector = newText;
+                case 3: record.sector = newText;
                     break;
 
-                case 4: it->industry = newText;
+                case 4: record.industry = newText;
                     break;
             }
 
-            database->setIsinList(isinList);
+            database->updateIsin(ISIN, record);
         }
 
 
@@ -3340,29 +3718,42 @@ void MainWindow::on_tableISIN_cellDoubleClicked(int row, int column)
 
 void MainWindow::updateStockDataSlot(QString ISIN, sONLINEDATA table)
 {
-    QVector<sISINDATA> isinList = database->getIsinList();
+    if (updateIsinRecord(ISIN, table))
+    {
+        fillISINTable();
+        fillOverviewTable();
+    }
+}
 
-    auto it = std::find_if (isinList.begin(), isinList.end(), [ISIN](sISINDATA a)
-                        {
-                            return ISIN == a.ISIN;
-                        }
-                        );
+bool MainWindow::updateIsinRecord(const QString &ISIN, const sONLINEDATA &table)
+{
+    sISINDATA record;
 
-    if (it != isinList.end())
-    {
-        it->lastUpdate = QDateTime::currentDateTime();
+    if (!getUpdatedIsinRecord(ISIN, table, &record)) return false;
 
-        if (it->sector != "ETF")
-        {
-            it->sector = table.info.sector;
-            it->industry = table.info.industry;
-        }
+    database->updateIsin(ISIN, record);
 
-        database->setIsinList(isinList);
+    return true;
+}
 
-        fillISINTable();
-        fillOverviewTable();
+bool MainWindow::getUpdatedIsinRecord(const QString &ISIN, const sONLINEDATA &table, sISINDATA *record)
+{
+    Q_ASSERT(record);
+
+    const sISINDATA *found = database->findIsin(ISIN);
+
+    if (found == nullptr) return false;
+
+    *record = *found;
+    record->lastUpdate = QDateTime::currentDateTime();
+
+    if (record->sector != "ETF")
+    {
+        record->sector = table.info.sector;
+        record->industry = table.info.industry;
     }
+
+    return true;
 }
 
 
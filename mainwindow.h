@@ -2,6 +2,7 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QFutureWatcher>
 #include <QProgressDialog>
 #include <QPointer>
 
@@ -9,7 +10,10 @@
 #include "database.h"
 #include "degiro.h"
 #include "downloadmanager.h"
+#include "fxservice.h"
 #include "global.h"
+#include "prefetchscheduler.h"
+#include "refreshengine.h"
 #include "screener.h"
 #include "screenertab.h"
 #include "stockdata.h"
@@ -33,6 +37,7 @@ public:
 public Q_SLOTS:
     void checkVersion(const QByteArray data, QString statusCode);
     void getData(const QByteArray data, QString statusCode);
+    void bulkImportData(const QByteArray data, QString statusCode);
     void parseOnlineParameters(const QByteArray data, QString statusCode);
     void loadOnlineParametersSlot();
     void setScreenerParamsSlot(QVector<sSCREENERPARAM> params);
@@ -40,7 +45,8 @@ public Q_SLOTS:
     void loadTastyworksCSVslot();
     void setStatus(QString text);
     void setFilterSlot(QVector<sFILTER> list);
-    void updateExchangeRates(const QByteArray data, QString statusCode);
+    void exchangeRatesReadySlot(sFXRATES rates);
+    void exchangeRatesFailedSlot(QString error);
     void setDegiroDataSlot(StockDataType newStockData);
     void fillOverviewSlot();
     void addRecord(const QByteArray data, QString statusCode);
@@ -59,9 +65,13 @@ private slots:
     void on_pbFilter_clicked();
     void on_cbFilter_clicked(bool checked);
     void on_pbRefresh_clicked();
+    void on_pbBulkImport_clicked();
 
-    void refreshTickersSlot(QString ticker = QString());
+    void refreshResultsSlot(QVector<sREFRESHRESULT> results);
+    void refreshProgressSlot(int done, int total);
+    void refreshFinishedSlot(int failed);
     void refreshTickersCanceled();
+    void prefetchResultsSlot(QVector<sREFRESHRESULT> results);
     void on_pbDeleteTickers_clicked();
 
     void clickedScreenerTabSlot(int index);
@@ -93,7 +103,6 @@ private slots:
 
 signals:
     void updateScreenerParams(QVector<sSCREENERPARAM> params);
-    void refreshTickers(QString ticker);
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event);
@@ -106,11 +115,24 @@ private:
     std::unique_ptr<DeGiro> degiro;
     std::unique_ptr<Tastyworks> tastyworks;
     std::unique_ptr<DownloadManager> downloadManager;
+    std::unique_ptr<RefreshEngine> refreshEngine;
+    std::unique_ptr<FxService> fxService;
+    std::unique_ptr<PrefetchScheduler> prefetchScheduler;
     std::unique_ptr<Screener> screener;
     std::unique_ptr<StockData> stockData;
 
     QPointer<QProgressDialog> refreshProgressDlg;
 
+    /**
+     * @brief overviewTableWatcher, overviewInfoWatcher
+     * @details the overview calculations run on the calculation pool, only one job per view is in flight,
+     *          a request during the running job is remembered and the stale result is dropped
+     */
+    QFutureWatcher<QVector<sOVERVIEWTABLE>> overviewTableWatcher;
+    QFutureWatcher<sOVERVIEWINFO> overviewInfoWatcher;
+    bool overviewTablePending;
+    bool overviewInfoPending;
+
     eSCREENSOURCE lastRequestSource;
 
     /**
@@ -122,6 +144,9 @@ private:
     QVector<ScreenerTab*> screenerTabs;
     int currentScreenerIndex;
     QStringList currentTickers;
+    int refreshScreenerIndex;       // screener of the running refresh
+    QStringList refreshErrors;      // tickers which have failed in the running refresh
+    int bulkImportScreenerIndex;    // screener of the running bulk import
 
     QVector<sFILTER> filterList;
 
@@ -138,6 +163,15 @@ private:
      *  Overview tab
      */
     void setOverviewHeader();
+    void showOverviewTable(const QVector<sOVERVIEWTABLE> &table);
+    void showOverviewInfo(const sOVERVIEWINFO &info);
+    void overviewTableFinished();
+    void overviewInfoFinished();
+
+    /**
+     * @brief showCorrelation - heatmap dialog of the correlation of the open positions
+     */
+    void showCorrelation(const QDate &from, const QDate &to);
 
     /*
      *  DeGiro tab
@@ -157,7 +191,28 @@ private:
      */
     void setScreenerHeader(ScreenerTab *st);
     void dataLoaded();
+
+    /**
+     * @brief applyScreenerData - add or update the ticker in the current screener
+     * @param save - write the screener file, the batch refresh writes it once for all tickers
+     */
+    void applyScreenerData(const QString &ticker, const sONLINEDATA &data, const bool &save = true);
     int findScreenerTicker(QString ticker);
+
+    /**
+     * @brief getTickerLine - the values of the enabled screener params, in the order of the params
+     */
+    TickerDataType getTickerLine(const QStringList &screenerParams, const sONLINEDATA &data);
+
+    /**
+     * @brief importScreenerRows - add or update all rows in the current screener, the screener is saved and filled once
+     */
+    void importScreenerRows(const QVector<sONLINEDATA> &rows);
+
+    /**
+     * @brief getPrefetchItems - the held positions and the tickers of the current screener for the background refresh
+     */
+    QVector<sPREFETCHITEM> getPrefetchItems();
     void insertScreenerRow(TickerDataType tickerData);
     void fillScreenerTable(ScreenerTab *st);
     void applyFilter(ScreenerTab *st);
@@ -182,6 +237,23 @@ private:
      */
     void eraseISIN(QString ISIN);
 
+    /**
+     * @brief updateIsinRecord - store the sector, the industry and the update time of the downloaded ticker
+     * @return false if the ISIN is not in the list
+     */
+    bool updateIsinRecord(const QString &ISIN, const sONLINEDATA &table);
+
+    /**
+     * @brief getUpdatedIsinRecord - the record of the ISIN with the downloaded data, for a batch of Database::updateIsins
+     * @return false if the ISIN is not in the list
+     */
+    bool getUpdatedIsinRecord(const QString &ISIN, const sONLINEDATA &table, sISINDATA *record);
+
+    /**
+     * @brief requestData - download the URL and pass the body and the status to the handler
+     */
+    void requestData(const QString &url, void (MainWindow::*handler)(const QByteArray, QString), const eDOWNLOADPRIORITY &priority = NORMALPRIORITY);
+
     void createProgressDialog(int min, int max);
     void updateProgressDialog(int val);
 };
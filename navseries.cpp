@@ -0,0 +1,331 @@
+#include "navseries.h"
+#include "portfoliostate.h"
+
+#include <algorithm>
+#include <cmath>
+
+NavSeries::NavSeries(QObject *parent) : QObject(parent), pricesDirty(false), total(0.0), next(0), nextPrice(0), generation(0), todayValue(0.0)
+{
+
+}
+
+void NavSeries::update(const StockDataType &stockList, const QHash<QString, double> &quotes, const QHash<QString, QMap<QDate, double>> &history, const QVector<double> &rates)
+{
+    QMutexLocker locker(&mutex);
+
+    QDate earliest;
+
+    for(auto it = stockList.cbegin(); it != stockList.cend(); ++it)
+    {
+        const QVector<sSTOCKDATA> oldVector = source.value(it.key());
+
+        if(oldVector.constData() == it.value().constData() && oldVector.count() == it.value().count())
+        {
+            continue;
+        }
+
+        const QDate date = PortfolioState::getEarliestChange(oldVector, it.value());
+
+        if(date.isValid() && (!earliest.isValid() || date < earliest))
+        {
+            earliest = date;
+        }
+    }
+
+    for(auto it = source.cbegin(); it != source.cend(); ++it)
+    {
+        if(!stockList.contains(it.key()))
+        {
+            const QDate date = PortfolioState::getEarliestChange(it.value(), QVector<sSTOCKDATA>());
+
+            if(date.isValid() && (!earliest.isValid() || date < earliest))
+            {
+                earliest = date;
+            }
+        }
+    }
+
+    source = stockList;
+
+    if(earliest.isValid())
+    {
+        trades.clear();
+
+        for(auto it = source.cbegin(); it != source.cend(); ++it)
+        {
+            for(const sSTOCKDATA &stock : it.value())
+            {
+                if( (stock.type == BUY || stock.type == SELL) && !(stock.flags & EXCLUDEDFLAG) )
+                {
+                    trades.push_back(stock);
+                }
+            }
+        }
+
+        std::stable_sort(trades.begin(), trades.end(),
+                         [](const sSTOCKDATA &a, const sSTOCKDATA &b)
+                         {
+                             return a.dateTime < b.dateTime;
+                         }
+                         );
+
+        // Trades after the finished days are just appended, the older ones need the full pass
+        if(values.isEmpty() || earliest <= origin.addDays(values.count() - 1))
+        {
+            reset();
+        }
+    }
+
+    // A refresh records the price of today, the finished days are recalculated only if an older price has changed
+    QDate earliestPrice;
+
+    auto setEarliestPrice = [&earliestPrice](const QDate &date)
+    {
+        if(date.isValid() && (!earliestPrice.isValid() || date < earliestPrice))
+        {
+            earliestPrice = date;
+        }
+    };
+
+    for(auto it = history.cbegin(); it != history.cend(); ++it)
+    {
+        setEarliestPrice(getEarliestChange(this->history.value(it.key()), it.value()));
+    }
+
+    for(auto it = this->history.cbegin(); it != this->history.cend(); ++it)
+    {
+        if(!history.contains(it.key()))
+        {
+            setEarliestPrice(getEarliestChange(it.value(), QMap<QDate, double>()));
+        }
+    }
+
+    this->history = history;
+
+    if(earliestPrice.isValid())
+    {
+        pricesDirty = true;
+
+        if(!values.isEmpty() && earliestPrice <= origin.addDays(values.count() - 1))
+        {
+            reset();
+        }
+    }
+
+    // The exchange rates are not historical, all days use the current ones
+    if(this->rates != rates)
+    {
+        this->rates = rates;
+        reset();
+    }
+
+    today = QDate::currentDate();
+    extend(today.addDays(-1));
+
+    // Today uses the online prices and is recalculated on each update
+    QHash<QString, sNAVPOSITION> todayPositions = positions;
+
+    for(int i = next; i < trades.count() && trades.at(i).dateTime.date() <= today; ++i)
+    {
+        apply(todayPositions, trades.at(i));
+    }
+
+    for(auto it = quotes.cbegin(); it != quotes.cend(); ++it)
+    {
+        auto position = todayPositions.find(it.key());
+
+        if(position != todayPositions.end())
+        {
+            position->price = it.value();
+        }
+    }
+
+    todayValue = getTotal(todayPositions);
+}
+
+QVector<QPair<QDate, double>> NavSeries::getSeries(const QDate &from, const QDate &to, quint64 *generation) const
+{
+    QMutexLocker locker(&mutex);
+
+    if(generation != nullptr)
+    {
+        *generation = this->generation;
+    }
+
+    QVector<QPair<QDate, double>> series;
+
+    if(!origin.isValid())
+    {
+        return series;
+    }
+
+    const QDate first = qMax(from, origin);
+    const QDate last = qMin(to, origin.addDays(values.count() - 1));
+
+    for(QDate date = first; date <= last; date = date.addDays(1))
+    {
+        series.push_back(qMakePair(date, values.at(static_cast<int>(origin.daysTo(date)))));
+    }
+
+    if(today >= from && today <= to && today >= origin)
+    {
+        series.push_back(qMakePair(today, todayValue));
+    }
+
+    return series;
+}
+
+void NavSeries::reset()
+{
+    values.clear();
+    positions.clear();
+    total = 0.0;
+    next = 0;
+    nextPrice = 0;
+    origin = trades.isEmpty() ? QDate() : trades.first().dateTime.date();
+    generation++;
+}
+
+void NavSeries::buildPrices()
+{
+    prices.clear();
+
+    for(auto it = history.cbegin(); it != history.cend(); ++it)
+    {
+        for(auto price = it->cbegin(); price != it->cend(); ++price)
+        {
+            prices.push_back({price.key(), it.key(), price.value()});
+        }
+    }
+
+    std::sort(prices.begin(), prices.end(),
+              [](const sNAVPRICE &a, const sNAVPRICE &b)
+              {
+                  return (a.date != b.date) ? a.date < b.date : a.ISIN < b.ISIN;
+              }
+              );
+
+    // The finished days have used the same prices, the next one is the first after them
+    const QDate finished = values.isEmpty() ? QDate() : origin.addDays(values.count() - 1);
+
+    nextPrice = 0;
+
+    while(finished.isValid() && nextPrice < prices.count() && prices.at(nextPrice).date <= finished)
+    {
+        nextPrice++;
+    }
+
+    pricesDirty = false;
+}
+
+void NavSeries::extend(const QDate &date)
+{
+    if(!origin.isValid() || origin.addDays(values.count()) > date)
+    {
+        return;
+    }
+
+    if(pricesDirty)
+    {
+        buildPrices();
+    }
+
+    values.reserve(static_cast<int>(origin.daysTo(date)) + 1);
+
+    // One pass over the days merging the trades and the recorded prices,
+    // the total is summed again only on the days with a change, so no rounding error is carried over
+    for(QDate day = origin.addDays(values.count()); day <= date; day = day.addDays(1))
+    {
+        bool touched = false;
+
+        while(next < trades.count() && trades.at(next).dateTime.date() <= day)
+        {
+            apply(positions, trades.at(next));
+            next++;
+            touched = true;
+        }
+
+        // The recorded price is the last one of the day, it replaces the price of the trades of the day
+        while(nextPrice < prices.count() && prices.at(nextPrice).date <= day)
+        {
+            const sNAVPRICE &price = prices.at(nextPrice);
+            auto position = positions.find(price.ISIN);
+
+            if(position != positions.end())
+            {
+                position->price = price.price;
+                touched = true;
+            }
+
+            nextPrice++;
+        }
+
+        if(touched)
+        {
+            total = getTotal(positions);
+        }
+
+        values.push_back(total);
+    }
+}
+
+void NavSeries::apply(QHash<QString, sNAVPOSITION> &positions, const sSTOCKDATA &stock) const
+{
+    sNAVPOSITION &position = positions[stock.ISIN];
+
+    position.count += (stock.type == BUY) ? stock.count : -stock.count;
+    position.price = std::abs(stock.price);
+    position.currency = stock.currency;
+}
+
+QDate NavSeries::getEarliestChange(const QMap<QDate, double> &oldPrices, const QMap<QDate, double> &newPrices)
+{
+    // The same shared data is the usual case
+    if(oldPrices == newPrices)
+    {
+        return QDate();
+    }
+
+    auto oldIt = oldPrices.cbegin();
+    auto newIt = newPrices.cbegin();
+
+    while(oldIt != oldPrices.cend() && newIt != newPrices.cend())
+    {
+        if(oldIt.key() != newIt.key())
+        {
+            return qMin(oldIt.key(), newIt.key());
+        }
+
+        if(oldIt.value() != newIt.value())
+        {
+            return oldIt.key();
+        }
+
+        ++oldIt;
+        ++newIt;
+    }
+
+    return (oldIt != oldPrices.cend()) ? oldIt.key() : newIt.key();
+}
+
+double NavSeries::getTotal(const QHash<QString, sNAVPOSITION> &positions) const
+{
+    double sum = 0.0;
+
+    for(const sNAVPOSITION &position : positions)
+    {
+        sum += getValue(position);
+    }
+
+    return sum;
+}
+
+double NavSeries::getValue(const sNAVPOSITION &position) const
+{
+    if(position.count <= 0)
+    {
+        return 0.0;
+    }
+
+    return position.count * position.price * rates.value(position.currency, 1.0);
+}
@@ -0,0 +1,83 @@
+#ifndef NAVSERIES_H
+#define NAVSERIES_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "global.h"
+#include "stockdata.h"
+
+class NavSeries : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NavSeries(QObject *parent = nullptr);
+
+    /**
+     * @brief update - bring the daily portfolio value up to date
+     * @param stockList - all transactions
+     * @param quotes - ISIN, current online price in the stock currency
+     * @param history - ISIN, date, recorded online price at the end of the day; a day without it keeps the last known price
+     * @param rates - value of one unit of each eCURRENCY in the selected currency
+     * New days, trades and prices after the last calculated day extend the series, older changes recalculate it
+     */
+    void update(const StockDataType &stockList, const QHash<QString, double> &quotes, const QHash<QString, QMap<QDate, double>> &history, const QVector<double> &rates);
+
+    /**
+     * @brief getSeries - portfolio value at the end of each day within the range
+     * @param generation - if set, the generation of the finished days of the series
+     */
+    QVector<QPair<QDate, double>> getSeries(const QDate &from, const QDate &to, quint64 *generation = nullptr) const;
+
+private:
+    struct sNAVPOSITION
+    {
+        int count = 0;
+        double price = 0.0;         // last known price, in the stock currency
+        eCURRENCY currency = CZK;
+    };
+
+    struct sNAVPRICE
+    {
+        QDate date;
+        QString ISIN;
+        double price;
+    };
+
+    StockDataType source;                       // shallow copy of the processed transactions
+    QVector<sSTOCKDATA> trades;                 // buys and sells sorted by date
+    QHash<QString, QMap<QDate, double>> history;    // shallow copy of the processed price history
+    QVector<sNAVPRICE> prices;                  // recorded prices sorted by date, built again when the history changes
+    bool pricesDirty;
+    QVector<double> rates;
+
+    QDate origin;                               // day of the first trade
+    QVector<double> values;                     // value at the end of origin + index, finished days only
+    QHash<QString, sNAVPOSITION> positions;     // positions at the end of the last finished day
+    double total;                               // value of the positions, summed from them on each changed day
+    int next;                                   // first trade after the last finished day
+    int nextPrice;                              // first recorded price after the last finished day
+    quint64 generation;                         // increased when the finished days are recalculated
+
+    QDate today;
+    double todayValue;
+
+    mutable QMutex mutex;
+
+    void reset();
+    void buildPrices();
+    void extend(const QDate &date);
+
+    /**
+     * @brief getEarliestChange - earliest date with a different price in the two versions of the history of an ISIN
+     * @return invalid date if the content is the same
+     */
+    static QDate getEarliestChange(const QMap<QDate, double> &oldPrices, const QMap<QDate, double> &newPrices);
+    void apply(QHash<QString, sNAVPOSITION> &positions, const sSTOCKDATA &stock) const;
+    double getTotal(const QHash<QString, sNAVPOSITION> &positions) const;
+    double getValue(const sNAVPOSITION &position) const;
+};
+
+#endif // NAVSERIES_H
@@ -0,0 +1,195 @@
+#include "networkfixture.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+namespace
+{
+    const quint32 FIXTUREMAGIC = 0x53504d46;    // "SPMF"
+    const quint32 FIXTUREVERSION = 1;
+}
+
+NetworkFixture::NetworkFixture(const QString &path, const eFIXTUREMODE &mode) : path(path), mode(mode), random(DEFAULTSEED)
+{
+    dirty = false;
+    latency = 0;
+    jitter = 0;
+    errorRate = 0.0;
+
+    // The recording goes on with the previous archive, so the runs can be recorded in parts
+    if (!load() && mode == REPLAYFIXTURE)
+    {
+        qWarning() << QString("The fixture %1 could not be loaded, all requests will fail").arg(path);
+    }
+}
+
+NetworkFixture::~NetworkFixture()
+{
+    if (dirty)
+    {
+        save();
+    }
+}
+
+void NetworkFixture::setLatency(const int &latency, const int &jitter)
+{
+    this->latency = qMax(0, latency);
+    this->jitter = qMax(0, jitter);
+}
+
+void NetworkFixture::setErrorRate(const double &rate)
+{
+    errorRate = qBound(0.0, rate, 1.0);
+}
+
+void NetworkFixture::setSeed(const quint32 &seed)
+{
+    random.seed(seed);
+}
+
+bool NetworkFixture::find(const QUrl &url, sFIXTURERESPONSE *response) const
+{
+    Q_ASSERT(response);
+
+    auto it = responses.constFind(getKey(url));
+
+    if (it == responses.constEnd())
+    {
+        return false;
+    }
+
+    *response = it.value();
+
+    return true;
+}
+
+void NetworkFixture::record(const QUrl &url, const sFIXTURERESPONSE &response)
+{
+    const QString key = getKey(url);
+
+    auto it = responses.constFind(key);
+
+    if (it != responses.constEnd() && it.value().errorType == NODOWNLOADERROR && response.errorType != NODOWNLOADERROR)
+    {
+        return;
+    }
+
+    responses.insert(key, response);
+    dirty = true;
+}
+
+bool NetworkFixture::save()
+{
+    QSaveFile file(path);
+
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << QString("Couldn't open the fixture %1.").arg(path);
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << FIXTUREMAGIC << FIXTUREVERSION << quint32(responses.count());
+
+    for (auto it = responses.constBegin(); it != responses.constEnd(); ++it)
+    {
+        const sFIXTURERESPONSE &response = it.value();
+
+        out << it.key() << qint32(response.statusCode) << response.status << qint32(response.errorType) << response.headers << qCompress(response.body);
+    }
+
+    if (!file.commit())
+    {
+        qWarning() << QString("Couldn't write the fixture %1.").arg(path);
+        return false;
+    }
+
+    dirty = false;
+
+    qDebug() << QString("The fixture %1 has been saved, %2 responses").arg(path).arg(responses.count());
+
+    return true;
+}
+
+int NetworkFixture::getDelay()
+{
+    return latency + ((jitter > 0) ? static_cast<int>(random.bounded(jitter + 1)) : 0);
+}
+
+eDOWNLOADERROR NetworkFixture::injectError()
+{
+    if (errorRate <= 0.0 || random.generateDouble() >= errorRate)
+    {
+        return NODOWNLOADERROR;
+    }
+
+    static const eDOWNLOADERROR errors[] = {NETWORKERROR, SERVERERROR, RATELIMITERROR};
+
+    return errors[random.bounded(3)];
+}
+
+quint32 NetworkFixture::getRandom(const quint32 &highest)
+{
+    return (highest > 0) ? random.bounded(highest) : 0;
+}
+
+QString NetworkFixture::getKey(const QUrl &url)
+{
+    return url.toString(QUrl::FullyEncoded);
+}
+
+bool NetworkFixture::load()
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic;
+    quint32 version;
+    quint32 count;
+
+    in >> magic >> version >> count;
+
+    if (magic != FIXTUREMAGIC || version != FIXTUREVERSION)
+    {
+        qWarning() << QString("The fixture %1 has an unknown format.").arg(path);
+        return false;
+    }
+
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        QString key;
+        qint32 statusCode;
+        qint32 errorType;
+        QByteArray body;
+        sFIXTURERESPONSE response;
+
+        in >> key >> statusCode >> response.status >> errorType >> response.headers >> body;
+
+        response.statusCode = statusCode;
+        response.errorType = static_cast<eDOWNLOADERROR>(errorType);
+        response.body = qUncompress(body);
+
+        responses.insert(key, response);
+    }
+
+    file.close();
+
+    if (in.status() != QDataStream::Ok)
+    {
+        qWarning() << QString("The fixture %1 is damaged.").arg(path);
+        responses.clear();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef NETWORKFIXTURE_H
+#define NETWORKFIXTURE_H
+
+#include <QHash>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QUrl>
+
+#include "global.h"
+
+/**
+ * @brief The NetworkFixture class - recorded responses for the runs without the network
+ * In the record mode the DownloadManager stores the response of each request (status, headers, body) and the archive
+ * is written when the fixture is closed. In the replay mode the responses are served from the archive with an artificial
+ * latency and randomly injected transient errors. The random generator is seeded, so the same seed gives the same run.
+ */
+class NetworkFixture
+{
+public:
+    NetworkFixture(const QString &path, const eFIXTUREMODE &mode);
+    ~NetworkFixture();
+
+    enum
+    {
+        DEFAULTSEED = 1
+    };
+
+    eFIXTUREMODE getMode() const { return mode; }
+    QString getPath() const { return path; }
+    int count() const { return responses.count(); }
+    QStringList getUrls() const { return responses.keys(); }
+
+    /**
+     * @brief setLatency - delay of each replayed response, latency + random(0, jitter) ms
+     */
+    void setLatency(const int &latency, const int &jitter);
+
+    /**
+     * @brief setErrorRate - probability (0 - 1) of a transient error instead of the replayed response
+     */
+    void setErrorRate(const double &rate);
+    void setSeed(const quint32 &seed);
+
+    bool find(const QUrl &url, sFIXTURERESPONSE *response) const;
+
+    /**
+     * @brief record - store the response, the last one of the URL is kept, but a failure does not replace a success
+     */
+    void record(const QUrl &url, const sFIXTURERESPONSE &response);
+
+    /**
+     * @brief save - write the archive at once (a crash keeps the previous one)
+     */
+    bool save();
+
+    int getDelay();
+
+    /**
+     * @brief injectError - NODOWNLOADERROR or the type of the injected error (network, 5xx or 429)
+     */
+    eDOWNLOADERROR injectError();
+
+    /**
+     * @brief getRandom - random value from 0 to highest - 1 of the seeded generator, e.g. the backoff jitter of the retries
+     */
+    quint32 getRandom(const quint32 &highest);
+
+private:
+    QString path;
+    eFIXTUREMODE mode;
+    QHash<QString, sFIXTURERESPONSE> responses;     // URL
+    bool dirty;
+
+    int latency;            // ms
+    int jitter;             // ms
+    double errorRate;
+    QRandomGenerator random;
+
+    static QString getKey(const QUrl &url);
+    bool load();
+};
+
+#endif // NETWORKFIXTURE_H
@@ -0,0 +1,305 @@
+#include "pagetemplate.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+
+PageTemplate::PageTemplate()
+{
+    version = 0;
+}
+
+const PageTemplate &PageTemplate::get(const eSCREENSOURCE &source)
+{
+    // Initialized once, also when the first parse runs on a worker thread
+    static const PageTemplate finviz = load("finviz");
+    static const PageTemplate yahoo = load("yahoo");
+
+    return (source == FINVIZ) ? finviz : yahoo;
+}
+
+PageTemplate PageTemplate::load(const QString &name)
+{
+    PageTemplate builtIn;
+    QString error;
+
+    QFile resource(QString(":/templates/%1.json").arg(name));
+
+    if (!resource.open(QIODevice::ReadOnly) || !compile(resource.readAll(), &builtIn, &error))
+    {
+        qWarning() << QString("The built-in template %1 is not valid: %2").arg(name, error);
+    }
+
+    QFile file(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + TEMPLATEDIR + name + ".json");
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return builtIn;
+    }
+
+    PageTemplate user;
+
+    if (!compile(file.readAll(), &user, &error))
+    {
+        qWarning() << QString("The template %1 is not valid, the built-in one is used: %2").arg(file.fileName(), error);
+        return builtIn;
+    }
+
+    return (user.version >= builtIn.version) ? user : builtIn;
+}
+
+bool PageTemplate::compile(const QByteArray &json, PageTemplate *pageTemplate, QString *error)
+{
+    Q_ASSERT(pageTemplate);
+    Q_ASSERT(error);
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &parseError);
+
+    if (parseError.error != QJsonParseError::NoError)
+    {
+        *error = parseError.errorString();
+        return false;
+    }
+
+    const QJsonObject object = document.object();
+
+    PageTemplate result;
+    result.source = object["source"].toString();
+    result.version = object["version"].toInt();
+
+    const QJsonArray layouts = object["layouts"].toArray();
+
+    for (const QJsonValue &value : layouts)
+    {
+        const QJsonObject layoutObject = value.toObject();
+
+        sLAYOUT layout;
+        layout.name = layoutObject["name"].toString();
+        layout.detect = layoutObject["detect"].toString().toUtf8();
+        layout.detectWithin = qMax(1, layoutObject["detectWithin"].toInt(DETECTWINDOW));
+
+        if (!compileSteps(layoutObject["steps"].toArray(), &layout.steps, error))
+        {
+            *error = QString("layout %1: %2").arg(layout.name, *error);
+            return false;
+        }
+
+        result.layouts.push_back(layout);
+    }
+
+    if (result.layouts.empty())
+    {
+        *error = "no layout";
+        return false;
+    }
+
+    *pageTemplate = result;
+
+    return true;
+}
+
+bool PageTemplate::compileSteps(const QJsonArray &array, std::vector<sSTEP> *steps, QString *error)
+{
+    static const QHash<QString, eOP> ops = {{"skipTo", SKIPTOOP}, {"skipPast", SKIPPASTOP}, {"read", READOP}, {"within", WITHINOP},
+                                            {"each", EACHOP}, {"pairs", PAIRSOP}, {"choose", CHOOSEOP}};
+
+    static const QHash<QString, eTARGET> targets = {{"name", NAMETARGET}, {"value", VALUETARGET}, {"stockName", STOCKNAMETARGET},
+                                                    {"sector", SECTORTARGET}, {"industry", INDUSTRYTARGET}, {"country", COUNTRYTARGET}};
+
+    for (const QJsonValue &value : array)
+    {
+        const QJsonObject object = value.toObject();
+        const QString op = object["op"].toString();
+
+        if (!ops.contains(op))
+        {
+            *error = QString("unknown operation \"%1\"").arg(op);
+            return false;
+        }
+
+        sSTEP step;
+        step.op = ops.value(op);
+        step.text = object["text"].toString().toUtf8();
+        step.prefix = object["prefix"].toString().toUtf8();
+        step.entities = object["entities"].toBool();
+        step.optional = object["optional"].toBool();
+
+        if (step.text.isEmpty() && step.op != CHOOSEOP)
+        {
+            *error = QString("\"%1\" without the text").arg(op);
+            return false;
+        }
+
+        switch (step.op)
+        {
+            case READOP:
+                if (!targets.contains(object["into"].toString()))
+                {
+                    *error = QString("unknown target \"%1\"").arg(object["into"].toString());
+                    return false;
+                }
+
+                step.target = targets.value(object["into"].toString());
+                break;
+            case WITHINOP:
+            case EACHOP:
+                if (!compileSteps(object["steps"].toArray(), &step.steps, error)) return false;
+                break;
+            case PAIRSOP:
+                if (!compileSteps(object["name"].toArray(), &step.steps, error)) return false;
+                if (!compileSteps(object["value"].toArray(), &step.valueSteps, error)) return false;
+                break;
+            case CHOOSEOP:
+            {
+                const QJsonArray options = object["options"].toArray();
+
+                for (const QJsonValue &option : options)
+                {
+                    std::vector<sSTEP> optionSteps;
+
+                    if (!compileSteps(option.toObject()["steps"].toArray(), &optionSteps, error)) return false;
+
+                    step.contains.push_back(option.toObject()["contains"].toString().toUtf8());
+                    step.options.push_back(optionSteps);
+                }
+
+                break;
+            }
+            default:
+                break;
+        }
+
+        steps->push_back(step);
+    }
+
+    return true;
+}
+
+sONLINEDATA PageTemplate::extract(const QByteArray &data) const
+{
+    sONLINEDATA table;
+
+    for (const sLAYOUT &layout : layouts)
+    {
+        HtmlScanner scanner(data);
+
+        // The steps go on from the anchor, so the detection is the beginning of the scan, not a pass of its own
+        if (!layout.detect.isEmpty() && !scanner.skipToWithin(view(layout.detect), static_cast<std::size_t>(layout.detectWithin))) continue;
+
+        sSTATE state;
+        state.table = &table;
+
+        run(layout.steps, scanner, state);
+
+        return table;
+    }
+
+    qDebug() << QString("No layout of the %1 template (version %2) matches the page").arg(source).arg(version);
+
+    return table;
+}
+
+void PageTemplate::run(const std::vector<sSTEP> &steps, HtmlScanner &scanner, sSTATE &state)
+{
+    for (const sSTEP &step : steps)
+    {
+        switch (step.op)
+        {
+            case SKIPTOOP:
+                scanner.skipTo(view(step.text));
+                break;
+            case SKIPPASTOP:
+            {
+                const HtmlScanner start = scanner;
+
+                if (!scanner.skipPast(view(step.text)) && step.optional)
+                {
+                    scanner = start;
+                }
+
+                break;
+            }
+            case READOP:
+            {
+                const QString text = HtmlScanner::toText(scanner.readUntil(view(step.text)), step.entities);
+
+                switch (step.target)
+                {
+                    case NAMETARGET:
+                        state.name = text;
+                        break;
+                    case VALUETARGET:
+                        state.table->row.insert(state.name, text);
+                        break;
+                    case STOCKNAMETARGET:
+                        state.table->info.stockName = text;
+                        break;
+                    case SECTORTARGET:
+                        state.table->info.sector = text;
+                        break;
+                    case INDUSTRYTARGET:
+                        state.table->info.industry = text;
+                        break;
+                    case COUNTRYTARGET:
+                        state.table->info.country = text;
+                        break;
+                }
+
+                break;
+            }
+            case WITHINOP:
+            {
+                HtmlScanner section = scanner.section(view(step.text));
+                run(step.steps, section, state);
+                break;
+            }
+            case EACHOP:
+            {
+                HtmlScanner element;
+
+                while (scanner.nextElement(view(step.text), &element))
+                {
+                    if (!step.prefix.isEmpty() && !element.startsWith(view(step.prefix))) continue;
+
+                    run(step.steps, element, state);
+                }
+
+                break;
+            }
+            case PAIRSOP:
+            {
+                HtmlScanner name;
+                HtmlScanner value;
+
+                while (scanner.nextElement(view(step.text), &name) && scanner.nextElement(view(step.text), &value))
+                {
+                    if (!step.prefix.isEmpty() && !name.startsWith(view(step.prefix))) continue;
+
+                    run(step.steps, name, state);
+                    run(step.valueSteps, value, state);
+                }
+
+                break;
+            }
+            case CHOOSEOP:
+            {
+                // Only the text at the cursor is tested, e.g. the rest of a table cell, not the rest of the page
+                const std::string_view window = scanner.peek(view(step.text), CHOOSEWINDOW);
+
+                for (std::size_t option = 0; option < step.options.size(); ++option)
+                {
+                    if (step.contains.at(option).isEmpty() || window.find(view(step.contains.at(option))) != std::string_view::npos)
+                    {
+                        run(step.options.at(option), scanner, state);
+                        break;
+                    }
+                }
+
+                break;
+            }
+        }
+    }
+}
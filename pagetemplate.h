@@ -0,0 +1,113 @@
+#ifndef PAGETEMPLATE_H
+#define PAGETEMPLATE_H
+
+#include <QByteArray>
+#include <QJsonArray>
+#include <QString>
+
+#include <vector>
+
+#include "global.h"
+#include "htmlscanner.h"
+
+/**
+ * @brief The PageTemplate class - extraction of a quote page driven by a template file
+ * The template (JSON, see templates/*.json) has a version and one or more layouts. A layout is selected by its
+ * "detect" anchor, searched only in the first "detectWithin" bytes, and is a list of scanner steps, which is compiled
+ * once into a plan. The plan runs from the anchor as one forward scan of the page, so a changed markup needs
+ * a new template file, not a new build.
+ * The built-in templates are in the resources, a file with the same name and a higher or equal version
+ * in the application data directory (TEMPLATEDIR) replaces the built-in one.
+ */
+class PageTemplate
+{
+public:
+    PageTemplate();
+
+    /**
+     * @brief get - compiled template of the source, loaded on the first use, then read-only (thread safe)
+     */
+    static const PageTemplate &get(const eSCREENSOURCE &source);
+
+    /**
+     * @brief compile - parse the template file into the plan
+     * @return false with the error if the template is not valid
+     */
+    static bool compile(const QByteArray &json, PageTemplate *pageTemplate, QString *error);
+
+    sONLINEDATA extract(const QByteArray &data) const;
+
+    enum
+    {
+        DETECTWINDOW = 512*1024,    // bytes of the page searched for the anchor of a layout
+        CHOOSEWINDOW = 4096         // bytes from the cursor tested by the options of "choose"
+    };
+
+    QString getSource() const { return source; }
+    int getVersion() const { return version; }
+
+private:
+    enum eOP
+    {
+        SKIPTOOP = 0,       // cursor to the text
+        SKIPPASTOP,         // cursor behind the text, "optional" keeps the cursor if there is no text
+        READOP,             // text up to the "text" into the target
+        WITHINOP,           // run the steps on the slice up to the "text"
+        EACHOP,             // run the steps on each element "text" starting with the "prefix"
+        PAIRSOP,            // run the "name" and "value" steps on the pairs of the elements "text", the name starts with the "prefix"
+        CHOOSEOP            // run the steps of the first option the text from the cursor up to the "text" "contains"
+    };
+
+    enum eTARGET
+    {
+        NAMETARGET = 0,     // name of the next row value
+        VALUETARGET,        // row value of the last name
+        STOCKNAMETARGET,
+        SECTORTARGET,
+        INDUSTRYTARGET,
+        COUNTRYTARGET
+    };
+
+    struct sSTEP
+    {
+        eOP op;
+        QByteArray text;
+        QByteArray prefix;
+        eTARGET target = NAMETARGET;
+        bool entities = false;
+        bool optional = false;
+        std::vector<sSTEP> steps;                   // nested steps, the name steps of PAIRSOP
+        std::vector<sSTEP> valueSteps;              // PAIRSOP
+        std::vector<QByteArray> contains;           // CHOOSEOP, empty - always
+        std::vector<std::vector<sSTEP>> options;    // CHOOSEOP
+    };
+
+    struct sLAYOUT
+    {
+        QString name;
+        QByteArray detect;
+        int detectWithin = DETECTWINDOW;
+        std::vector<sSTEP> steps;
+    };
+
+    struct sSTATE
+    {
+        sONLINEDATA *table;
+        QString name;
+    };
+
+    QString source;
+    int version;
+    std::vector<sLAYOUT> layouts;
+
+    static PageTemplate load(const QString &name);
+    static bool compileSteps(const QJsonArray &array, std::vector<sSTEP> *steps, QString *error);
+    static void run(const std::vector<sSTEP> &steps, HtmlScanner &scanner, sSTATE &state);
+
+    static inline std::string_view view(const QByteArray &text)
+    {
+        return std::string_view(text.constData(), static_cast<std::size_t>(text.size()));
+    }
+};
+
+#endif // PAGETEMPLATE_H
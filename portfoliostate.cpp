@@ -0,0 +1,285 @@
+#include "portfoliostate.h"
+
+#include <algorithm>
+#include <cmath>
+
+PortfolioState::PortfolioState(QObject *parent) : QObject(parent), timelineDirty(false)
+{
+
+}
+
+void PortfolioState::update(const StockDataType &stockList)
+{
+    QMutexLocker locker(&mutex);
+
+    QDate earliest;
+
+    auto setEarliest = [&earliest](const QDate &date)
+    {
+        if(date.isValid() && (!earliest.isValid() || date < earliest))
+        {
+            earliest = date;
+        }
+    };
+
+    for(auto it = stockList.cbegin(); it != stockList.cend(); ++it)
+    {
+        const QVector<sSTOCKDATA> oldVector = source.value(it.key());
+
+        // The vector is implicitly shared with the processed one, nothing has changed
+        if(oldVector.constData() == it.value().constData() && oldVector.count() == it.value().count())
+        {
+            continue;
+        }
+
+        setEarliest(getEarliestChange(oldVector, it.value()));
+    }
+
+    // Removed ISINs
+    for(auto it = source.cbegin(); it != source.cend(); ++it)
+    {
+        if(!stockList.contains(it.key()))
+        {
+            setEarliest(getEarliestChange(it.value(), QVector<sSTOCKDATA>()));
+        }
+    }
+
+    source = stockList;
+
+    // Same content (e.g. a detached copy)
+    if(!earliest.isValid())
+    {
+        return;
+    }
+
+    // Lazy invalidation, the checkpoints are rebuilt once somebody asks for them
+    while(!checkpoints.isEmpty() && checkpoints.last().state.date >= earliest)
+    {
+        checkpoints.removeLast();
+    }
+
+    timelineDirty = true;
+}
+
+sPORTFOLIOSTATE PortfolioState::getState(const QDate &date)
+{
+    QMutexLocker locker(&mutex);
+
+    return findState(date);
+}
+
+QHash<QString, int> PortfolioState::getCounts(const QDate &from, const QDate &to)
+{
+    QMutexLocker locker(&mutex);
+
+    const sPORTFOLIOSTATE end = findState(to);
+    const sPORTFOLIOSTATE begin = findState(from.addDays(-1));
+
+    QHash<QString, int> counts;
+
+    for(auto it = end.holdings.cbegin(); it != end.holdings.cend(); ++it)
+    {
+        counts.insert(it.key(), it.value().count - begin.holdings.value(it.key()).count);
+    }
+
+    for(auto it = begin.holdings.cbegin(); it != begin.holdings.cend(); ++it)
+    {
+        if(!end.holdings.contains(it.key()))
+        {
+            counts.insert(it.key(), -it.value().count);
+        }
+    }
+
+    return counts;
+}
+
+void PortfolioState::buildTimeline()
+{
+    timeline.clear();
+
+    for(auto it = source.cbegin(); it != source.cend(); ++it)
+    {
+        timeline.append(it.value());
+    }
+
+    std::stable_sort(timeline.begin(), timeline.end(),
+                     [](const sSTOCKDATA &a, const sSTOCKDATA &b)
+                     {
+                         return a.dateTime < b.dateTime;
+                     }
+                     );
+
+    timelineDirty = false;
+}
+
+void PortfolioState::extendCheckpoints(const QDate &date)
+{
+    if(timeline.isEmpty())
+    {
+        return;
+    }
+
+    if(checkpoints.isEmpty())
+    {
+        sCHECKPOINT checkpoint;
+        checkpoint.state.date = getMonthEnd(timeline.first().dateTime.date().addMonths(-1));
+        checkpoint.state.cash = QVector<double>(CAD + 1, 0.0);
+        checkpoint.next = 0;
+
+        checkpoints.push_back(checkpoint);
+    }
+
+    // Nothing changes after the last event, there is no need for more checkpoints
+    while(checkpoints.last().next < timeline.count())
+    {
+        sCHECKPOINT checkpoint = checkpoints.last();
+        const QDate monthEnd = getMonthEnd(checkpoint.state.date.addDays(1));
+
+        if(monthEnd > date)
+        {
+            break;
+        }
+
+        while(checkpoint.next < timeline.count() && timeline.at(checkpoint.next).dateTime.date() <= monthEnd)
+        {
+            apply(checkpoint.state, timeline.at(checkpoint.next));
+            checkpoint.next++;
+        }
+
+        checkpoint.state.date = monthEnd;
+        checkpoints.push_back(checkpoint);
+    }
+}
+
+sPORTFOLIOSTATE PortfolioState::findState(const QDate &date)
+{
+    if(timelineDirty)
+    {
+        buildTimeline();
+    }
+
+    extendCheckpoints(date);
+
+    sPORTFOLIOSTATE state;
+    state.date = date;
+    state.cash = QVector<double>(CAD + 1, 0.0);
+
+    // Last checkpoint on or before the date
+    auto it = std::upper_bound(checkpoints.cbegin(), checkpoints.cend(), date,
+                               [](const QDate &d, const sCHECKPOINT &c)
+                               {
+                                   return d < c.state.date;
+                               }
+                               );
+
+    if(it == checkpoints.cbegin())
+    {
+        return state;
+    }
+
+    --it;
+
+    state = it->state;
+    state.date = date;
+
+    // Replay the tail
+    for(int i = it->next; i < timeline.count() && timeline.at(i).dateTime.date() <= date; ++i)
+    {
+        apply(state, timeline.at(i));
+    }
+
+    return state;
+}
+
+void PortfolioState::apply(sPORTFOLIOSTATE &state, const sSTOCKDATA &stock)
+{
+    // Cash follows the signed cash movements as they are imported, i.e. buy and withdrawal are negative
+    switch(stock.type)
+    {
+        case BUY:
+        case SELL:
+        case DIVIDEND:
+        {
+            state.cash[stock.currency] += stock.price * stock.count + stock.fee;
+        }
+        break;
+
+        default:
+        {
+            state.cash[stock.currency] += stock.price;
+        }
+        break;
+    }
+
+    if(stock.type != BUY && stock.type != SELL)
+    {
+        return;
+    }
+
+    sHOLDING holding = state.holdings.value(stock.ISIN);
+
+    if(stock.type == BUY)
+    {
+        holding.count += stock.count;
+        holding.cost += stock.count * std::abs(stock.price);
+    }
+    else
+    {
+        if(holding.count > 0)
+        {
+            const int sold = qMin(stock.count, holding.count);
+            holding.cost -= holding.cost * sold / holding.count;
+        }
+
+        holding.count -= stock.count;
+
+        if(holding.count <= 0)
+        {
+            holding.cost = 0.0;
+        }
+    }
+
+    if(holding.count == 0)
+    {
+        state.holdings.remove(stock.ISIN);
+    }
+    else
+    {
+        state.holdings.insert(stock.ISIN, holding);
+    }
+}
+
+QDate PortfolioState::getMonthEnd(const QDate &date)
+{
+    return QDate(date.year(), date.month(), date.daysInMonth());
+}
+
+QDate PortfolioState::getEarliestChange(const QVector<sSTOCKDATA> &oldVector, const QVector<sSTOCKDATA> &newVector)
+{
+    // Skip the common prefix, the records are not sorted so every record behind it may be the earliest one
+    // Invalid date is returned for the same content
+    int first = 0;
+
+    while(first < oldVector.count() && first < newVector.count() && oldVector.at(first) == newVector.at(first))
+    {
+        first++;
+    }
+
+    QDate earliest;
+
+    for(const QVector<sSTOCKDATA> *vector : {&oldVector, &newVector})
+    {
+        for(int i = first; i < vector->count(); ++i)
+        {
+            // Record without a date is sorted first, everything has to be recalculated
+            const QDate date = vector->at(i).dateTime.date().isValid() ? vector->at(i).dateTime.date() : QDate(1900, 1, 1);
+
+            if(!earliest.isValid() || date < earliest)
+            {
+                earliest = date;
+            }
+        }
+    }
+
+    return earliest;
+}
@@ -0,0 +1,64 @@
+#ifndef PORTFOLIOSTATE_H
+#define PORTFOLIOSTATE_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "global.h"
+#include "stockdata.h"
+
+class PortfolioState : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PortfolioState(QObject *parent = nullptr);
+
+    /**
+     * @brief update - compare the transactions with the last known ones
+     * @param stockList - all transactions
+     * The checkpoints from the earliest changed date are dropped, they are recalculated on the next query
+     */
+    void update(const StockDataType &stockList);
+
+    /**
+     * @brief getState - holdings, cost basis and cash at the end of the day
+     * @return state replayed from the nearest month end checkpoint
+     */
+    sPORTFOLIOSTATE getState(const QDate &date);
+
+    /**
+     * @brief getCounts - bought minus sold shares of each ISIN within the range
+     * @return ISIN, count; the same values as StockData::getTotalCount
+     */
+    QHash<QString, int> getCounts(const QDate &from, const QDate &to);
+
+    /**
+     * @brief getEarliestChange - earliest date touched by the difference of two versions of an ISIN vector
+     * @return invalid date if the content is the same
+     */
+    static QDate getEarliestChange(const QVector<sSTOCKDATA> &oldVector, const QVector<sSTOCKDATA> &newVector);
+
+private:
+    struct sCHECKPOINT
+    {
+        sPORTFOLIOSTATE state;      // state at the end of the month
+        int next;                   // index of the first timeline event after the month end
+    };
+
+    StockDataType source;                   // shallow copy of the processed transactions
+    QVector<sSTOCKDATA> timeline;           // all transactions sorted by date
+    QVector<sCHECKPOINT> checkpoints;       // consecutive month ends
+    bool timelineDirty;
+    QMutex mutex;
+
+    void buildTimeline();
+    void extendCheckpoints(const QDate &date);
+    sPORTFOLIOSTATE findState(const QDate &date);
+
+    static void apply(sPORTFOLIOSTATE &state, const sSTOCKDATA &stock);
+    static QDate getMonthEnd(const QDate &date);
+};
+
+#endif // PORTFOLIOSTATE_H
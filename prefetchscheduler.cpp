@@ -0,0 +1,209 @@
+#include "prefetchscheduler.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QEvent>
+
+#include <algorithm>
+
+PrefetchScheduler::PrefetchScheduler(DownloadManager *downloadManager, QObject *parent) : QObject(parent), engine(downloadManager)
+{
+    enabled = true;
+
+    // The user requests go first and the background one does not use the whole rate of a host
+    engine.setPriority(LOWPRIORITY);
+    engine.setHostLimit("finviz.com", 1, 0.5, 1);
+    engine.setHostLimit("finance.yahoo.com", 1, 1.0, 2);
+
+    idleTimer.setSingleShot(true);
+
+    connect(&idleTimer, &QTimer::timeout, this, &PrefetchScheduler::run);
+    connect(&engine, &RefreshEngine::resultsReady, this, &PrefetchScheduler::engineResults);
+    connect(&engine, &RefreshEngine::finished, this, &PrefetchScheduler::engineFinished);
+
+    QCoreApplication::instance()->installEventFilter(this);
+
+    idleTimer.start(IDLEDELAY);
+}
+
+void PrefetchScheduler::setEnabled(const bool &enabled)
+{
+    this->enabled = enabled;
+
+    if (enabled)
+    {
+        idleTimer.start(IDLEDELAY);
+    }
+    else
+    {
+        idleTimer.stop();
+        engine.cancel();
+    }
+}
+
+void PrefetchScheduler::pause()
+{
+    if (engine.isRunning())
+    {
+        engine.cancel();
+    }
+
+    if (enabled)
+    {
+        idleTimer.start(IDLEDELAY);
+    }
+}
+
+bool PrefetchScheduler::eventFilter(QObject *obj, QEvent *event)
+{
+    switch (event->type())
+    {
+        case QEvent::KeyPress:
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonDblClick:
+        case QEvent::Wheel:
+        case QEvent::TouchBegin:
+            pause();
+            break;
+        default:
+            break;
+    }
+
+    return QObject::eventFilter(obj, event);
+}
+
+void PrefetchScheduler::run()
+{
+    if (!enabled || engine.isRunning() || !provider) return;
+
+    const int budget = qMin(int(BATCHSIZE), getBudget());
+
+    if (budget <= 0)
+    {
+        // The oldest spent ticker leaves the window
+        idleTimer.start(static_cast<int>(qMax(qint64(BATCHDELAY), spent.head() + 60*60*1000 - QDateTime::currentMSecsSinceEpoch())));
+        return;
+    }
+
+    const QStringList tickers = rank(provider()).mid(0, budget);
+
+    // Nothing is stale, the next check after the next idle time
+    if (tickers.isEmpty()) return;
+
+    qDebug() << QString("Prefetching %1 stale tickers").arg(tickers.count());
+
+    engine.start(tickers);
+}
+
+int PrefetchScheduler::getBudget()
+{
+    const qint64 hourAgo = QDateTime::currentMSecsSinceEpoch() - 60*60*1000;
+
+    while (!spent.isEmpty() && spent.head() < hourAgo)
+    {
+        spent.dequeue();
+    }
+
+    return HOURLYBUDGET - spent.count();
+}
+
+QStringList PrefetchScheduler::rank(const QVector<sPREFETCHITEM> &items) const
+{
+    const QDateTime now = QDateTime::currentDateTime();
+
+    // One item per ticker, the most important tier and the newest update of the ticker
+    QHash<QString, sPREFETCHITEM> unique;
+
+    for (const sPREFETCHITEM &item : items)
+    {
+        const QString ticker = item.ticker.trimmed().toUpper();
+
+        if (ticker.isEmpty()) continue;
+
+        sPREFETCHITEM candidate = item;
+        candidate.ticker = ticker;
+
+        const QDateTime lastFetched = fetched.value(ticker);
+
+        if (lastFetched.isValid() && (!candidate.lastUpdate.isValid() || lastFetched > candidate.lastUpdate))
+        {
+            candidate.lastUpdate = lastFetched;
+        }
+
+        auto it = unique.find(ticker);
+
+        if (it == unique.end())
+        {
+            unique.insert(ticker, candidate);
+            continue;
+        }
+
+        it.value().tier = qMin(it.value().tier, candidate.tier);
+
+        if (candidate.lastUpdate.isValid() && (!it.value().lastUpdate.isValid() || candidate.lastUpdate > it.value().lastUpdate))
+        {
+            it.value().lastUpdate = candidate.lastUpdate;
+        }
+    }
+
+    QVector<sPREFETCHITEM> stale;
+
+    for (const sPREFETCHITEM &item : qAsConst(unique))
+    {
+        if (!item.lastUpdate.isValid() || item.lastUpdate.secsTo(now) >= STALEAGE)
+        {
+            stale.push_back(item);
+        }
+    }
+
+    // The tier first, then the stalest (never updated before all others)
+    std::sort(stale.begin(), stale.end(), [](const sPREFETCHITEM &a, const sPREFETCHITEM &b)
+              {
+                  if (a.tier != b.tier) return a.tier < b.tier;
+                  if (a.lastUpdate.isValid() != b.lastUpdate.isValid()) return !a.lastUpdate.isValid();
+                  return a.lastUpdate < b.lastUpdate;
+              }
+              );
+
+    QStringList tickers;
+    tickers.reserve(stale.count());
+
+    for (const sPREFETCHITEM &item : qAsConst(stale))
+    {
+        tickers << item.ticker;
+    }
+
+    return tickers;
+}
+
+void PrefetchScheduler::engineResults(const QVector<sREFRESHRESULT> &results)
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    QVector<sREFRESHRESULT> refreshed;
+
+    for (const sREFRESHRESULT &result : results)
+    {
+        // A failed ticker counts as fetched too, so it does not take the budget of the others until it is stale again
+        spent.enqueue(now.toMSecsSinceEpoch());
+        fetched.insert(result.ticker, now);
+
+        if (result.error.isEmpty())
+        {
+            refreshed.push_back(result);
+        }
+    }
+
+    if (!refreshed.isEmpty())
+    {
+        emit resultsReady(refreshed);
+    }
+}
+
+void PrefetchScheduler::engineFinished()
+{
+    // Still idle, so the next batch
+    if (enabled)
+    {
+        idleTimer.start(BATCHDELAY);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef PREFETCHSCHEDULER_H
+#define PREFETCHSCHEDULER_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QQueue>
+#include <QTimer>
+
+#include <functional>
+
+#include "downloadmanager.h"
+#include "global.h"
+#include "refreshengine.h"
+
+/**
+ * @brief The PrefetchScheduler class - refresh of the stale data while the user is idle
+ * When there has been no user input for IDLEDELAY, the stalest items are refreshed in small batches with the low priority:
+ * the held positions first, then the tickers of the active screener. Any user input cancels the running batch,
+ * the prefetch goes on after the next idle time. The number of the tickers per hour is limited by HOURLYBUDGET.
+ */
+class PrefetchScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PrefetchScheduler(DownloadManager *downloadManager, QObject *parent = nullptr);
+
+    enum
+    {
+        IDLEDELAY = 60000,          // ms without the user input
+        BATCHDELAY = 5000,          // ms between the batches of one idle time
+        STALEAGE = 12*60*60,        // s, the newer data is not prefetched
+        BATCHSIZE = 10,             // tickers
+        HOURLYBUDGET = 60           // tickers
+    };
+
+    typedef std::function<QVector<sPREFETCHITEM>()> ProviderType;
+
+    /**
+     * @brief setProvider - the items are collected before each batch, an empty list skips the batch (e.g. while the user refresh runs)
+     */
+    void setProvider(const ProviderType &provider) { this->provider = provider; }
+
+    void setEnabled(const bool &enabled);
+    bool isEnabled() const { return enabled; }
+
+    /**
+     * @brief pause - cancel the running batch, the prefetch starts again after IDLEDELAY
+     */
+    void pause();
+
+signals:
+    /**
+     * @brief resultsReady - the refreshed tickers, the failed ones are left out
+     */
+    void resultsReady(QVector<sREFRESHRESULT> results);
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *event) override;
+
+private:
+    RefreshEngine engine;
+    ProviderType provider;
+    QTimer idleTimer;
+    QQueue<qint64> spent;                   // ms since epoch of the prefetched tickers within the last hour
+    QHash<QString, QDateTime> fetched;      // tickers prefetched in this session, also the failed ones
+    bool enabled;
+
+    void run();
+    int getBudget();
+    QStringList rank(const QVector<sPREFETCHITEM> &items) const;
+
+    void engineResults(const QVector<sREFRESHRESULT> &results);
+    void engineFinished();
+};
+
+#endif // PREFETCHSCHEDULER_H
@@ -0,0 +1,359 @@
+#include "refreshengine.h"
+
+#include <QtConcurrent>
+
+#include <cmath>
+
+#include "screener.h"
+
+RefreshEngine::RefreshEngine(DownloadManager *downloadManager, QObject *parent) : QObject(parent), downloadManager(downloadManager)
+{
+    Q_ASSERT(downloadManager);
+
+    priority = NORMALPRIORITY;
+    total = 0;
+    done = 0;
+    failed = 0;
+    generation = 0;
+    retryPass = false;
+
+    // finviz blocks the clients with too many requests, Yahoo is more tolerant
+    setHostLimit(getHost(FINVIZ), 4, 2.0, 4);
+    setHostLimit(getHost(YAHOO), 4, 4.0, 8);
+
+    pumpTimer.setSingleShot(true);
+    batchTimer.setSingleShot(true);
+    batchTimer.setInterval(BATCHINTERVAL);
+
+    connect(&pumpTimer, &QTimer::timeout, this, &RefreshEngine::pump);
+    connect(&batchTimer, &QTimer::timeout, this, &RefreshEngine::flush);
+}
+
+void RefreshEngine::setHostLimit(const QString &host, const int &concurrency, const double &rate, const int &burst)
+{
+    sHOST &state = getHostState(host);
+    state.limit.concurrency = qMax(1, concurrency);
+    state.limit.rate = qMax(0.01, rate);
+    state.limit.burst = qMax(1, burst);
+    state.tokens = qMin(state.tokens, double(state.limit.burst));
+}
+
+void RefreshEngine::start(const QStringList &tickers)
+{
+    cancel();
+
+    for (const QString &item : tickers)
+    {
+        const QString ticker = item.trimmed().toUpper();
+
+        if(ticker.isEmpty() || this->tickers.contains(ticker)) continue;
+
+        enqueue(ticker);
+    }
+
+    total = this->tickers.count();
+
+    if(total == 0)
+    {
+        emit finished(0);
+        return;
+    }
+
+    emit progress(0, total);
+
+    pump();
+}
+
+void RefreshEngine::cancel()
+{
+    generation++;
+
+    // cancel() emits finished() immediately, the reply has to be forgotten first
+    const QList<DownloadReply*> running = replies.keys();
+    replies.clear();
+
+    for (DownloadReply *reply : running)
+    {
+        reply->cancel();
+    }
+
+    for (auto it = hosts.begin(); it != hosts.end(); ++it)
+    {
+        it.value().queue.clear();
+        it.value().running = 0;
+    }
+
+    tickers.clear();
+    batch.clear();
+    retryTickers.clear();
+    pumpTimer.stop();
+    batchTimer.stop();
+
+    total = 0;
+    done = 0;
+    failed = 0;
+    retryPass = false;
+}
+
+void RefreshEngine::enqueue(const QString &ticker)
+{
+    tickers.insert(ticker, sTICKER());
+    getHostState(getHost(FINVIZ)).queue.enqueue(qMakePair(ticker, FINVIZ));
+    getHostState(getHost(YAHOO)).queue.enqueue(qMakePair(ticker, YAHOO));
+}
+
+QString RefreshEngine::getHost(const eSCREENSOURCE &source)
+{
+    return getUrl(QString("A"), source).host();
+}
+
+QUrl RefreshEngine::getUrl(const QString &ticker, const eSCREENSOURCE &source)
+{
+    switch(source)
+    {
+        case FINVIZ:
+            return QUrl(QString("https://finviz.com/quote.ashx?t=%1").arg(ticker));
+        case YAHOO:
+            return QUrl(QString("https://finance.yahoo.com/quote/%1/key-statistics").arg(ticker));
+    }
+
+    return QUrl();
+}
+
+RefreshEngine::sHOST &RefreshEngine::getHostState(const QString &host)
+{
+    auto it = hosts.find(host);
+
+    if(it == hosts.end())
+    {
+        sHOST state;
+        state.limit = {2, 1.0, 2};
+        it = hosts.insert(host, state);
+    }
+
+    return it.value();
+}
+
+void RefreshEngine::pump()
+{
+    int wait = -1;
+
+    for (auto it = hosts.begin(); it != hosts.end(); ++it)
+    {
+        sHOST &host = it.value();
+
+        while(!host.queue.isEmpty() && host.running < host.limit.concurrency)
+        {
+            int hostWait = 0;
+
+            if(!takeToken(host, &hostWait))
+            {
+                wait = (wait < 0) ? hostWait : qMin(wait, hostWait);
+                break;
+            }
+
+            const QPair<QString, eSCREENSOURCE> job = host.queue.dequeue();
+
+            DownloadReply *reply = downloadManager->execute(getUrl(job.first, job.second).toString(), priority);
+            connect(reply, &DownloadReply::finished, this, [this, reply]() { replyFinished(reply); });
+
+            replies.insert(reply, job);
+            host.running++;
+        }
+    }
+
+    if(wait >= 0 && (!pumpTimer.isActive() || pumpTimer.remainingTime() > wait))
+    {
+        pumpTimer.start(qMax(1, wait));
+    }
+}
+
+bool RefreshEngine::takeToken(sHOST &host, int *wait)
+{
+    if(!host.refill.isValid())
+    {
+        host.tokens = host.limit.burst;
+        host.refill.start();
+    }
+    else
+    {
+        host.tokens = qMin(double(host.limit.burst), host.tokens + host.refill.restart()*host.limit.rate/1000.0);
+    }
+
+    if(host.tokens >= 1.0)
+    {
+        host.tokens -= 1.0;
+        return true;
+    }
+
+    *wait = static_cast<int>(std::ceil((1.0 - host.tokens)*1000.0/host.limit.rate));
+
+    return false;
+}
+
+void RefreshEngine::replyFinished(DownloadReply *reply)
+{
+    auto it = replies.find(reply);
+
+    if(it == replies.end())     // canceled
+    {
+        return;
+    }
+
+    const QPair<QString, eSCREENSOURCE> job = it.value();
+    replies.erase(it);
+
+    sHOST &host = getHostState(getHost(job.second));
+    host.running = qMax(0, host.running - 1);
+
+    const QString error = reply->isSuccess() ? QString() : reply->getStatus();
+    const QByteArray data = reply->getBody();
+
+    // The free slot is used before the parsing
+    pump();
+
+    if(!error.isEmpty())
+    {
+        parsed(job.first, job.second, sONLINEDATA(), error, reply->isTransient());
+        return;
+    }
+
+    const quint64 current = generation;
+    QFutureWatcher<sONLINEDATA> *watcher = new QFutureWatcher<sONLINEDATA>(this);
+
+    connect(watcher, &QFutureWatcher<sONLINEDATA>::finished, this, [this, watcher, current, job]()
+            {
+                if(current == generation)
+                {
+                    parsed(job.first, job.second, watcher->result(), QString(), false);
+                }
+
+                watcher->deleteLater();
+            }
+            );
+
+    const eSCREENSOURCE source = job.second;
+
+    watcher->setFuture(QtConcurrent::run([data, source]()
+                                         {
+                                             return (source == FINVIZ) ? Screener::finvizParse(data) : Screener::yahooParse(data);
+                                         }
+                                         ));
+}
+
+void RefreshEngine::parsed(const QString &ticker, const eSCREENSOURCE &source, const sONLINEDATA &data, const QString &error, const bool &transient)
+{
+    auto it = tickers.find(ticker);
+
+    if(it == tickers.end())
+    {
+        return;
+    }
+
+    sTICKER &state = it.value();
+
+    if(!error.isEmpty())
+    {
+        if(state.error.isEmpty())
+        {
+            state.error = QString("%1: %2").arg(source == FINVIZ ? "Finviz" : "Yahoo", error);
+        }
+
+        state.transient |= transient;
+    }
+    else if(source == FINVIZ)
+    {
+        state.finviz = data;
+    }
+    else
+    {
+        state.yahoo = data;
+    }
+
+    if(--state.pending > 0)
+    {
+        return;
+    }
+
+    // Same merge as the single ticker download, Yahoo overwrites the same parameters
+    sREFRESHRESULT result;
+    result.ticker = ticker;
+    result.error = state.error;
+    result.data = state.finviz;
+    result.data.info.ticker = ticker;
+
+    for (auto row = state.yahoo.row.constBegin(); row != state.yahoo.row.constEnd(); ++row)
+    {
+        result.data.row.insert(row.key(), row.value());
+    }
+
+    const bool retry = !result.error.isEmpty() && state.transient && !retryPass;
+
+    tickers.erase(it);
+
+    if(retry)
+    {
+        // Collected for the retry pass, the others do not wait for it
+        retryTickers << ticker;
+    }
+    else
+    {
+        done++;
+
+        if(!result.error.isEmpty())
+        {
+            failed++;
+        }
+
+        batch.push_back(result);
+    }
+
+    if(done + retryTickers.count() == total && !retryTickers.isEmpty())
+    {
+        // The paused hosts are available again when the retried requests are sent
+        retryPass = true;
+
+        const QStringList retried = retryTickers;
+        retryTickers.clear();
+
+        for (const QString &item : retried)
+        {
+            enqueue(item);
+        }
+
+        pump();
+    }
+    else if(done == total)
+    {
+        batchTimer.stop();
+        flush();
+    }
+    else if(!batchTimer.isActive())
+    {
+        batchTimer.start();
+    }
+}
+
+void RefreshEngine::flush()
+{
+    if(!batch.isEmpty())
+    {
+        QVector<sREFRESHRESULT> results;
+        results.swap(batch);
+
+        emit resultsReady(results);
+        emit progress(done, total);
+    }
+
+    if(total > 0 && done == total)
+    {
+        const int failedCount = failed;
+
+        total = 0;
+        done = 0;
+        failed = 0;
+        retryPass = false;
+
+        emit finished(failedCount);
+    }
+}
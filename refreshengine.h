@@ -0,0 +1,126 @@
+#ifndef REFRESHENGINE_H
+#define REFRESHENGINE_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QQueue>
+#include <QTimer>
+#include <QVector>
+
+#include "downloadmanager.h"
+#include "global.h"
+
+/**
+ * @brief The RefreshEngine class - downloads the screener data of many tickers at once
+ * The finviz and Yahoo pages of a ticker are requested in parallel through the DownloadManager. Each host has its own queue with
+ * a limit of the running requests and a token bucket of the request rate. The pages are parsed on the
+ * global thread pool and the finished tickers are sent in batches, so the UI is not updated per request.
+ * A ticker which has failed with a transient error (after the retries of the DownloadManager) does not stop the refresh,
+ * it is downloaded once more after all other tickers.
+ */
+class RefreshEngine : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RefreshEngine(DownloadManager *downloadManager, QObject *parent = nullptr);
+
+    /**
+     * @brief setHostLimit - limits of one host, the new limits are used by the next request
+     * @param concurrency - maximum of the running requests
+     * @param rate - requests per second
+     * @param burst - requests which can be sent at once after an idle time
+     */
+    void setHostLimit(const QString &host, const int &concurrency, const double &rate, const int &burst);
+
+    /**
+     * @brief setPriority - priority of the requests in the DownloadManager, e.g. low for the background refresh
+     */
+    void setPriority(const eDOWNLOADPRIORITY &priority) { this->priority = priority; }
+
+    /**
+     * @brief start - queue the tickers, the running refresh is canceled
+     */
+    void start(const QStringList &tickers);
+
+    /**
+     * @brief cancel - abort the running requests and drop the queued ones, nothing else is sent
+     */
+    void cancel();
+
+    bool isRunning() const { return total > 0; }
+
+signals:
+    /**
+     * @brief resultsReady - finished tickers since the last batch, in the order of the completion
+     */
+    void resultsReady(QVector<sREFRESHRESULT> results);
+    void progress(int done, int total);
+    void finished(int failed);
+
+private:
+    enum
+    {
+        BATCHINTERVAL = 250         // ms
+    };
+
+    struct sLIMIT
+    {
+        int concurrency;
+        double rate;
+        int burst;
+    };
+
+    struct sHOST
+    {
+        sLIMIT limit;
+        int running = 0;
+        double tokens = 0.0;
+        QElapsedTimer refill;
+        QQueue<QPair<QString, eSCREENSOURCE>> queue;    // ticker, source
+    };
+
+    struct sTICKER
+    {
+        int pending = 2;            // both sources
+        sONLINEDATA finviz;
+        sONLINEDATA yahoo;
+        QString error;
+        bool transient = false;     // the error can disappear with a later retry
+    };
+
+    DownloadManager *downloadManager;
+    eDOWNLOADPRIORITY priority;
+    QHash<QString, sHOST> hosts;
+    QHash<QString, sTICKER> tickers;
+    QHash<DownloadReply*, QPair<QString, eSCREENSOURCE>> replies;
+    QVector<sREFRESHRESULT> batch;
+    QStringList retryTickers;       // failed in the first pass, waiting for the retry pass
+
+    QTimer pumpTimer;
+    QTimer batchTimer;
+
+    int total;
+    int done;
+    int failed;
+    quint64 generation;             // the parse results of a canceled refresh are dropped
+    bool retryPass;
+
+    static QString getHost(const eSCREENSOURCE &source);
+    static QUrl getUrl(const QString &ticker, const eSCREENSOURCE &source);
+
+    sHOST &getHostState(const QString &host);
+
+    /**
+     * @brief pump - send the queued requests allowed by the host limits, plan the next pump if a token is missing
+     */
+    void pump();
+    bool takeToken(sHOST &host, int *wait);
+
+    void enqueue(const QString &ticker);
+    void replyFinished(DownloadReply *reply);
+    void parsed(const QString &ticker, const eSCREENSOURCE &source, const sONLINEDATA &data, const QString &error, const bool &transient);
+    void flush();
+};
+
+#endif // REFRESHENGINE_H
@@ -0,0 +1,303 @@
+#include "returns.h"
+
+#include <cmath>
+#include <limits>
+
+Returns::Returns(QObject *parent) : QObject(parent)
+{
+
+}
+
+double Returns::getXIRR(const QString &key, const QVector<sCASHFLOW> &flows)
+{
+    QVector<double> inputs;
+    inputs.reserve(flows.count()*2);
+
+    for(const sCASHFLOW &flow : flows)
+    {
+        inputs << flow.date.toJulianDay() << flow.amount;
+    }
+
+    double value;
+
+    if(getCached(key, inputs, &value))
+    {
+        return value;
+    }
+
+    value = solveXIRR(flows) * 100.0;
+    setCached(key, inputs, value);
+
+    return value;
+}
+
+double Returns::getTWR(const QString &key, const QVector<QPair<QDate, double>> &values, const QMap<QDate, double> &flows)
+{
+    // The count of the values separates them from the flows
+    QVector<double> inputs;
+    inputs.reserve(1 + values.count()*2 + flows.count()*2);
+    inputs << values.count();
+
+    for(const QPair<QDate, double> &value : values)
+    {
+        inputs << value.first.toJulianDay() << value.second;
+    }
+
+    for(auto it = flows.cbegin(); it != flows.cend(); ++it)
+    {
+        inputs << it.key().toJulianDay() << it.value();
+    }
+
+    double value;
+
+    if(getCached(key, inputs, &value))
+    {
+        return value;
+    }
+
+    // Chain the daily returns, the flow of the day is removed from the end value
+    double growth = 1.0;
+    double previous = 0.0;
+    bool hasPeriod = false;
+
+    for(const QPair<QDate, double> &day : values)
+    {
+        if(previous > 0.0)
+        {
+            growth *= (day.second - flows.value(day.first, 0.0)) / previous;
+            hasPeriod = true;
+        }
+
+        previous = day.second;
+    }
+
+    value = hasPeriod ? (growth - 1.0) * 100.0 : std::numeric_limits<double>::quiet_NaN();
+    setCached(key, inputs, value);
+
+    return value;
+}
+
+double Returns::solveXIRR(const QVector<sCASHFLOW> &flows)
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    // Merge the flows of the same day, QMap keeps them sorted
+    QMap<QDate, double> merged;
+
+    for(const sCASHFLOW &flow : flows)
+    {
+        merged[flow.date] += flow.amount;
+    }
+
+    bool hasPositive = false;
+    bool hasNegative = false;
+
+    for(const double &amount : qAsConst(merged))
+    {
+        hasPositive |= amount > 0.0;
+        hasNegative |= amount < 0.0;
+    }
+
+    if(!hasPositive || !hasNegative)
+    {
+        return nan;
+    }
+
+    // Pre-discounted form: amounts and their distance from the first flow in years
+    QVector<double> amounts;
+    QVector<double> years;
+    amounts.reserve(merged.count());
+    years.reserve(merged.count());
+
+    const QDate first = merged.firstKey();
+
+    for(auto it = merged.cbegin(); it != merged.cend(); ++it)
+    {
+        amounts.push_back(it.value());
+        years.push_back(first.daysTo(it.key()) / 365.0);
+    }
+
+    // Newton
+    double rate = 0.1;
+
+    for(int iteration = 0; iteration < 50; ++iteration)
+    {
+        const double logBase = std::log1p(rate);
+        double npv = 0.0;
+        double derivative = 0.0;
+
+        for(int i = 0; i < amounts.count(); ++i)
+        {
+            const double discounted = amounts.at(i) * std::exp(-years.at(i) * logBase);
+            npv += discounted;
+            derivative -= years.at(i) * discounted / (1.0 + rate);
+        }
+
+        if(!std::isfinite(npv) || qFuzzyIsNull(derivative))
+        {
+            break;
+        }
+
+        const double newRate = rate - npv / derivative;
+
+        if(!std::isfinite(newRate) || newRate <= -1.0)
+        {
+            break;
+        }
+
+        if(std::abs(newRate - rate) < 1e-10)
+        {
+            return newRate;
+        }
+
+        rate = newRate;
+    }
+
+    // Brent on the first bracket with a sign change
+    const QVector<double> grid = {-0.9999, -0.9, -0.5, 0.0, 0.5, 1.0, 2.0, 5.0, 10.0, 100.0};
+
+    for(int i = 0; i + 1 < grid.count(); ++i)
+    {
+        const double a = getNPV(amounts, years, grid.at(i));
+        const double b = getNPV(amounts, years, grid.at(i + 1));
+
+        if(std::isfinite(a) && std::isfinite(b) && ((a <= 0.0 && b >= 0.0) || (a >= 0.0 && b <= 0.0)))
+        {
+            return brent(amounts, years, grid.at(i), grid.at(i + 1));
+        }
+    }
+
+    return nan;
+}
+
+bool Returns::getCached(const QString &key, const QVector<double> &inputs, double *value)
+{
+    QMutexLocker locker(&mutex);
+
+    auto it = cache.constFind(key);
+
+    if(it != cache.cend() && it->inputs == inputs)
+    {
+        *value = it->value;
+        return true;
+    }
+
+    return false;
+}
+
+void Returns::setCached(const QString &key, const QVector<double> &inputs, const double &value)
+{
+    QMutexLocker locker(&mutex);
+
+    sCACHEDRESULT result;
+    result.inputs = inputs;
+    result.value = value;
+
+    cache.insert(key, result);
+}
+
+double Returns::getNPV(const QVector<double> &amounts, const QVector<double> &years, const double &rate)
+{
+    const double logBase = std::log1p(rate);
+    double npv = 0.0;
+
+    for(int i = 0; i < amounts.count(); ++i)
+    {
+        npv += amounts.at(i) * std::exp(-years.at(i) * logBase);
+    }
+
+    return npv;
+}
+
+double Returns::brent(const QVector<double> &amounts, const QVector<double> &years, double a, double b)
+{
+    const double tolerance = 1e-10;
+
+    double fa = getNPV(amounts, years, a);
+    double fb = getNPV(amounts, years, b);
+    double c = b;
+    double fc = fb;
+    double d = b - a;
+    double e = d;
+
+    for(int iteration = 0; iteration < 100; ++iteration)
+    {
+        if((fb > 0.0 && fc > 0.0) || (fb < 0.0 && fc < 0.0))
+        {
+            c = a;
+            fc = fa;
+            d = b - a;
+            e = d;
+        }
+
+        if(std::abs(fc) < std::abs(fb))
+        {
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+
+        const double tol = 2.0 * std::numeric_limits<double>::epsilon() * std::abs(b) + 0.5 * tolerance;
+        const double xm = 0.5 * (c - b);
+
+        if(std::abs(xm) <= tol || qFuzzyIsNull(fb))
+        {
+            return b;
+        }
+
+        if(std::abs(e) >= tol && std::abs(fa) > std::abs(fb))
+        {
+            // Inverse quadratic interpolation
+            const double s = fb / fa;
+            double p;
+            double q;
+
+            if(a == c)
+            {
+                p = 2.0 * xm * s;
+                q = 1.0 - s;
+            }
+            else
+            {
+                const double qa = fa / fc;
+                const double r = fb / fc;
+                p = s * (2.0 * xm * qa * (qa - r) - (b - a) * (r - 1.0));
+                q = (qa - 1.0) * (r - 1.0) * (s - 1.0);
+            }
+
+            if(p > 0.0)
+            {
+                q = -q;
+            }
+
+            p = std::abs(p);
+
+            if(2.0 * p < qMin(3.0 * xm * q - std::abs(tol * q), std::abs(e * q)))
+            {
+                e = d;
+                d = p / q;
+            }
+            else
+            {
+                d = xm;
+                e = d;
+            }
+        }
+        else
+        {
+            // Bisection
+            d = xm;
+            e = d;
+        }
+
+        a = b;
+        fa = fb;
+        b += (std::abs(d) > tol) ? d : std::copysign(tol, xm);
+        fb = getNPV(amounts, years, b);
+    }
+
+    return b;
+}
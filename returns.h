@@ -0,0 +1,56 @@
+#ifndef RETURNS_H
+#define RETURNS_H
+
+#include <QObject>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QVector>
+
+#include "global.h"
+
+class Returns : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Returns(QObject *parent = nullptr);
+
+    /**
+     * @brief getXIRR - money-weighted annual return of the cash flows
+     * @param key - cache slot, e.g. the ISIN; one result per slot, it is reused while the flows are the same
+     * @return % p.a., NaN if there is no solution
+     */
+    double getXIRR(const QString &key, const QVector<sCASHFLOW> &flows);
+
+    /**
+     * @brief getTWR - time-weighted return of the daily values
+     * @param values - value at the end of each day
+     * @param flows - date, money moved into (positive) or out of (negative) the valued holdings
+     * @return %, NaN if there is no period with a value
+     */
+    double getTWR(const QString &key, const QVector<QPair<QDate, double>> &values, const QMap<QDate, double> &flows);
+
+    /**
+     * @brief solveXIRR - Newton method over the pre-discounted flows, Brent method if Newton does not converge
+     * @return annual rate (0.1 = 10 %), NaN if there is no solution
+     */
+    static double solveXIRR(const QVector<sCASHFLOW> &flows);
+
+private:
+    struct sCACHEDRESULT
+    {
+        QVector<double> inputs;     // days and amounts the value was computed from, compared as a whole
+        double value;
+    };
+
+    QHash<QString, sCACHEDRESULT> cache;
+    QMutex mutex;
+
+    bool getCached(const QString &key, const QVector<double> &inputs, double *value);
+    void setCached(const QString &key, const QVector<double> &inputs, const double &value);
+
+    static double getNPV(const QVector<double> &amounts, const QVector<double> &years, const double &rate);
+    static double brent(const QVector<double> &amounts, const QVector<double> &years, double a, double b);
+};
+
+#endif // RETURNS_H
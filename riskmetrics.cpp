@@ -0,0 +1,211 @@
+#include "riskmetrics.h"
+
+#include <cmath>
+#include <limits>
+
+RiskMetrics::RiskMetrics(const int &window, QObject *parent) : QObject(parent), window(window)
+{
+    reset(0, QDate());
+}
+
+void RiskMetrics::update(const quint64 &generation, const QVector<QPair<QDate, double>> &values, const QMap<QDate, double> &flows)
+{
+    QMutexLocker locker(&mutex);
+
+    if(values.isEmpty())
+    {
+        reset(generation, QDate());
+        return;
+    }
+
+    // The finished days are not recalculated within a generation, the last committed value has to be the same bit for bit
+    if(generation != this->generation || values.first().first != first || values.count() <= committed ||
+       (committed > 0 && values.at(committed - 1).second != lastValue))
+    {
+        reset(generation, values.first().first);
+    }
+
+    for(int i = committed; i < values.count() - 1; ++i)
+    {
+        commit(values.at(i).first, values.at(i).second, flows.value(values.at(i).first, 0.0));
+    }
+
+    setCurrent(values.last().first, values.last().second, flows.value(values.last().first, 0.0));
+}
+
+sRISKMETRICS RiskMetrics::getMetrics() const
+{
+    QMutexLocker locker(&mutex);
+
+    return current;
+}
+
+QVector<QPair<QDate, sRISKMETRICS>> RiskMetrics::getRolling() const
+{
+    QMutexLocker locker(&mutex);
+
+    QVector<QPair<QDate, sRISKMETRICS>> series = rolling;
+
+    if(currentDate.isValid())
+    {
+        series.push_back(qMakePair(currentDate, currentRolling));
+    }
+
+    return series;
+}
+
+void RiskMetrics::reset(const quint64 &generation, const QDate &first)
+{
+    this->generation = generation;
+    this->first = first;
+    committed = 0;
+    lastValue = 0.0;
+
+    returns.clear();
+    levels.clear();
+
+    moments = sMOMENTS();
+    rollingMoments = sMOMENTS();
+    peaks.clear();
+    head = 0;
+    peak = 1.0;
+    maxDrawdown = 0.0;
+    rolling.clear();
+
+    current = getMetrics(sMOMENTS(), 0.0);
+    currentDate = QDate();
+    currentRolling = current;
+}
+
+void RiskMetrics::commit(const QDate &date, const double &value, const double &flow)
+{
+    double dayReturn;
+
+    if(committed > 0 && getReturn(value, flow, &dayReturn))
+    {
+        const int position = returns.count();
+        const double level = (levels.isEmpty() ? 1.0 : levels.last()) * (1.0 + dayReturn);
+
+        returns.push_back(dayReturn);
+        levels.push_back(level);
+
+        moments.add(dayReturn);
+        peak = qMax(peak, level);
+        maxDrawdown = qMax(maxDrawdown, 1.0 - level/peak);
+
+        if(rollingMoments.count < window)
+        {
+            rollingMoments.add(dayReturn);
+        }
+        else
+        {
+            rollingMoments.replace(returns.at(position - window), dayReturn);
+        }
+
+        // Monotonic queue of the window maximum, each position is pushed and removed once
+        while(peaks.count() > head && levels.at(peaks.last()) <= level)
+        {
+            peaks.removeLast();
+        }
+
+        peaks.push_back(position);
+
+        while(peaks.at(head) <= position - window)
+        {
+            head++;
+        }
+
+        if(head > 1024 && head*2 > peaks.count())
+        {
+            peaks.remove(0, head);
+            head = 0;
+        }
+
+        if(rollingMoments.count == window)
+        {
+            rolling.push_back(qMakePair(date, getMetrics(rollingMoments, 1.0 - level/levels.at(peaks.at(head)))));
+        }
+    }
+
+    lastValue = value;
+    committed++;
+}
+
+void RiskMetrics::setCurrent(const QDate &date, const double &value, const double &flow)
+{
+    double dayReturn;
+
+    currentDate = QDate();
+
+    if(committed == 0 || !getReturn(value, flow, &dayReturn))
+    {
+        current = getMetrics(moments, maxDrawdown);
+        return;
+    }
+
+    // The accumulators are small, the day is added to their copies
+    sMOMENTS all = moments;
+    sMOMENTS last = rollingMoments;
+
+    const double level = (levels.isEmpty() ? 1.0 : levels.last()) * (1.0 + dayReturn);
+
+    all.add(dayReturn);
+    current = getMetrics(all, qMax(maxDrawdown, 1.0 - level/qMax(peak, level)));
+
+    if(last.count < window)
+    {
+        last.add(dayReturn);
+    }
+    else
+    {
+        last.replace(returns.at(returns.count() - window), dayReturn);
+    }
+
+    if(last.count == window)
+    {
+        currentDate = date;
+        currentRolling = getMetrics(last, 1.0 - level/getRollingPeak(returns.count(), level));
+    }
+}
+
+bool RiskMetrics::getReturn(const double &value, const double &flow, double *dayReturn) const
+{
+    if(lastValue <= 0.0)
+    {
+        return false;
+    }
+
+    *dayReturn = (value - flow)/lastValue - 1.0;
+
+    return true;
+}
+
+double RiskMetrics::getRollingPeak(const int &position, const double &level) const
+{
+    for(int i = head; i < peaks.count(); ++i)
+    {
+        if(peaks.at(i) > position - window)
+        {
+            return qMax(level, levels.at(peaks.at(i)));
+        }
+    }
+
+    return level;
+}
+
+sRISKMETRICS RiskMetrics::getMetrics(const sMOMENTS &moments, const double &drawdown)
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double annual = std::sqrt(365.0);     // the series has all calendar days
+
+    const double deviation = (moments.count > 1) ? std::sqrt(qMax(0.0, moments.M2)/(moments.count - 1)) : 0.0;
+    const double downside = (moments.count > 0) ? std::sqrt(qMax(0.0, moments.downSquares)/moments.count) : 0.0;
+
+    sRISKMETRICS metrics;
+    metrics.volatility = (moments.count > 1) ? deviation*annual*100.0 : nan;
+    metrics.maxDrawdown = drawdown*100.0;
+    metrics.sharpe = (deviation > 0.0) ? moments.mean/deviation*annual : nan;
+    metrics.sortino = (downside > 0.0) ? moments.mean/downside*annual : nan;
+
+    return metrics;
+}
@@ -0,0 +1,116 @@
+#ifndef RISKMETRICS_H
+#define RISKMETRICS_H
+
+#include <QObject>
+#include <QDate>
+#include <QMap>
+#include <QMutex>
+#include <QVector>
+
+#include "global.h"
+
+class RiskMetrics : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @param window - days of the rolling metrics
+     */
+    explicit RiskMetrics(const int &window = 91, QObject *parent = nullptr);
+
+    /**
+     * @brief update - add the days after the processed ones, each day is O(1)
+     * @param generation - NavSeries generation, the series is processed again if it or the first day changes
+     * @param values - value at the end of each day, the last day may change with each update
+     * @param flows - date, money moved into (positive) or out of (negative) the valued holdings
+     */
+    void update(const quint64 &generation, const QVector<QPair<QDate, double>> &values, const QMap<QDate, double> &flows);
+
+    /**
+     * @brief getMetrics - metrics of all the days of the series
+     */
+    sRISKMETRICS getMetrics() const;
+
+    /**
+     * @brief getRolling - metrics of the last "window" days, for each day with a full window
+     * The drawdown is the fall from the highest value within the window
+     */
+    QVector<QPair<QDate, sRISKMETRICS>> getRolling() const;
+
+    int getWindow() const { return window; }
+
+private:
+    /**
+     * @brief The sMOMENTS struct - Welford running mean and sum of squared deviations
+     */
+    struct sMOMENTS
+    {
+        int count = 0;
+        double mean = 0.0;
+        double M2 = 0.0;
+        double downSquares = 0.0;   // squared negative returns
+
+        inline void add(const double &x)
+        {
+            count++;
+
+            const double delta = x - mean;
+            mean += delta/count;
+            M2 += delta*(x - mean);
+            downSquares += (x < 0.0) ? x*x : 0.0;
+        }
+
+        // The oldest value leaves the full window, the count does not change
+        inline void replace(const double &oldX, const double &x)
+        {
+            const double oldMean = mean;
+            const double delta = x - oldX;
+            mean += delta/count;
+            M2 += delta*(x - mean + oldX - oldMean);
+            downSquares += ((x < 0.0) ? x*x : 0.0) - ((oldX < 0.0) ? oldX*oldX : 0.0);
+        }
+    };
+
+    int window;
+
+    quint64 generation;
+    QDate first;
+    int committed;                  // values processed, the last value is never committed
+    double lastValue;               // value of the last committed day
+
+    QVector<double> returns;        // daily returns of the committed days
+    QVector<double> levels;         // growth of 1 after each return
+
+    sMOMENTS moments;               // all returns
+    sMOMENTS rollingMoments;        // last "window" returns
+    QVector<int> peaks;             // positions in levels with decreasing levels, the window maximum is at "head"
+    int head;
+    double peak;
+    double maxDrawdown;
+    QVector<QPair<QDate, sRISKMETRICS>> rolling;    // days with a full window
+
+    // Metrics with the last, not committed, day
+    sRISKMETRICS current;
+    QDate currentDate;              // invalid if the last day has no full window
+    sRISKMETRICS currentRolling;
+
+    mutable QMutex mutex;
+
+    void reset(const quint64 &generation, const QDate &first);
+    void commit(const QDate &date, const double &value, const double &flow);
+    void setCurrent(const QDate &date, const double &value, const double &flow);
+
+    /**
+     * @brief getReturn - return of the day without the flow, false if there was no value the day before
+     */
+    bool getReturn(const double &value, const double &flow, double *dayReturn) const;
+
+    /**
+     * @brief getRollingPeak - highest level in the window ending with the level at the position
+     */
+    double getRollingPeak(const int &position, const double &level) const;
+
+    static sRISKMETRICS getMetrics(const sMOMENTS &moments, const double &drawdown);
+};
+
+#endif // RISKMETRICS_H
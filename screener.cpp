@@ -1,9 +1,111 @@
 #include "screener.h"
 
 #include <QCoreApplication>
+#include <QDebug>
 #include <QStandardPaths>
 #include <QFile>
 #include <QDataStream>
+#include <QHash>
+#include <QSet>
+
+#include "pagetemplate.h"
+
+namespace
+{
+    // Export header -> name of the same value on the quote page (the key of the screener params)
+    const QHash<QString, QString> EXPORTNAMES = {
+        {"Dividend Yield", "Dividend %"}, {"Shares Outstanding", "Shs Outstand"}, {"Shares Float", "Shs Float"},
+        {"Insider Ownership", "Insider Own"}, {"Insider Transactions", "Insider Trans"},
+        {"Institutional Ownership", "Inst Own"}, {"Institutional Transactions", "Inst Trans"},
+        {"Float Short", "Short Float"}, {"Return on Assets", "ROA"}, {"Return on Equity", "ROE"},
+        {"Return on Investment", "ROI"}, {"Gross Margin", "Gross Margin"}, {"Operating Margin", "Oper. Margin"},
+        {"Profit Margin", "Profit Margin"}, {"Relative Volume", "Rel Volume"}, {"Average Volume", "Avg Volume"},
+        {"Forward P/E", "Forward P/E"}, {"Total Debt/Equity", "Debt/Eq"}, {"LT Debt/Equity", "LT Debt/Eq"},
+        {"Current Ratio", "Current Ratio"}, {"Quick Ratio", "Quick Ratio"}, {"Payout Ratio", "Payout"},
+        {"EPS (ttm)", "EPS (ttm)"}, {"EPS growth this year", "EPS this Y"}, {"EPS growth next year", "EPS next Y"},
+        {"EPS growth past 5 years", "EPS past 5Y"}, {"EPS growth next 5 years", "EPS next 5Y"},
+        {"Sales growth past 5 years", "Sales past 5Y"}, {"EPS growth quarter over quarter", "EPS Q/Q"},
+        {"Sales growth quarter over quarter", "Sales Q/Q"}, {"Performance (Week)", "Perf Week"},
+        {"Performance (Month)", "Perf Month"}, {"Performance (Quarter)", "Perf Quarter"},
+        {"Performance (Half Year)", "Perf Half Y"}, {"Performance (Year)", "Perf Year"},
+        {"Performance (YTD)", "Perf YTD"}, {"Volatility (Week)", "Volatility W"}, {"Volatility (Month)", "Volatility M"},
+        {"20-Day Simple Moving Average", "SMA20"}, {"50-Day Simple Moving Average", "SMA50"},
+        {"200-Day Simple Moving Average", "SMA200"}, {"Relative Strength Index (14)", "RSI (14)"},
+        {"Analyst Recom", "Recom"}, {"Target Price", "Target Price"}, {"Earnings Date", "Earnings"}
+    };
+
+    // The export has these in millions, the quote page shows them as 1.23B / 456.78M
+    const QSet<QString> MILLIONS = {"Market Cap", "Shs Outstand", "Shs Float"};
+
+    // One CSV line from the position, the position moves to the next line; quoted fields may contain commas and "" quotes
+    QStringList readCsvLine(const QByteArray &data, int *position)
+    {
+        QStringList fields;
+        QByteArray field;
+        bool quoted = false;
+        int i = *position;
+
+        for (; i < data.size(); ++i)
+        {
+            const char c = data.at(i);
+
+            if (quoted)
+            {
+                if (c != '"')
+                {
+                    field.append(c);
+                }
+                else if (i + 1 < data.size() && data.at(i + 1) == '"')
+                {
+                    field.append('"');
+                    ++i;
+                }
+                else
+                {
+                    quoted = false;
+                }
+            }
+            else if (c == '"')
+            {
+                quoted = true;
+            }
+            else if (c == ',')
+            {
+                fields << QString::fromUtf8(field);
+                field.clear();
+            }
+            else if (c == '\n')
+            {
+                ++i;
+                break;
+            }
+            else if (c != '\r')
+            {
+                field.append(c);
+            }
+        }
+
+        fields << QString::fromUtf8(field);
+        *position = i;
+
+        return fields;
+    }
+
+    QString formatMillions(const QString &value)
+    {
+        bool ok;
+        const double millions = value.toDouble(&ok);
+
+        if (!ok) return value;
+
+        if (millions >= 1000.0)
+        {
+            return QString::number(millions / 1000.0, 'f', 2) + "B";
+        }
+
+        return QString::number(millions, 'f', 2) + "M";
+    }
+}
 
 Screener::Screener(QObject *parent) : QObject(parent)
 {
@@ -48,157 +150,91 @@ void Screener::setAllScreenerData(const QVector<sSCREENER> &value)
     saveAllScreenerData();
 }
 
-sONLINEDATA Screener::finvizParse(QString data)
+sONLINEDATA Screener::finvizParse(const QByteArray &data)
 {
-    sONLINEDATA table;
-    sTICKERINFO info;
-
-    int startB = data.indexOf("<body");
-    int endB = data.indexOf("</body");
-    QString body = data.mid(startB, endB-startB);
-
-    int startC = data.indexOf("fullview-title");
-    QString content = data.mid(startC, endB-startC);
-
-    int start1TR = content.indexOf("<tr", 0);
-    int start2TR = content.indexOf("<tr", start1TR+1);
-
-    int st = content.indexOf("<b>", start2TR);
-    st = content.indexOf(">", st);
-    int en = content.indexOf("</b>", st);
-    QString tmp = content.mid(st+1, en-st-1);
-    info.stockName = tmp.replace("&amp;", "&");
-
-    int start3TR = content.indexOf("<tr", start2TR+1);
+    return PageTemplate::get(FINVIZ).extract(data);
+}
 
-    st = content.indexOf("<a href", start3TR);
-    st = content.indexOf(">", st);
-    en = content.indexOf("</a>", st);
-    tmp = content.mid(st+1, en-st-1);
-    info.sector = tmp;
+sONLINEDATA Screener::yahooParse(const QByteArray &data)
+{
+    return PageTemplate::get(YAHOO).extract(data);
+}
 
-    st = content.indexOf("<a href", en);
-    st = content.indexOf(">", st);
-    en = content.indexOf("</a>", st);
-    tmp = content.mid( st+1, en-st-1);
-    info.industry = tmp.replace("&amp;", "&");
+QVector<sONLINEDATA> Screener::finvizExportParse(const QByteArray &data)
+{
+    QVector<sONLINEDATA> rows;
 
-    st = content.indexOf("<a href", en);
-    st = content.indexOf(">", st);
-    en = content.indexOf("</a>", st);
-    tmp = content.mid(st+1, en-st-1);
-    info.country = tmp;
+    int position = 0;
+    const QStringList header = readCsvLine(data, &position);
 
-    table.info = info;
+    QStringList names;
+    names.reserve(header.count());
 
-    int start21TR = content.indexOf("<tr", en+1);
+    for (QString name : header)
+    {
+        name = name.trimmed();
 
-    int startInnerTable = content.indexOf("<table", en);
-    int endInnderTable = content.indexOf("</table>", start21TR);
+        if (name.startsWith(QChar(0xFEFF)))     // BOM of the saved files
+        {
+            name.remove(0, 1);
+        }
 
-    QStringList TRvalues = content.mid(startInnerTable, endInnderTable-startInnerTable).split("<tr");
+        names << EXPORTNAMES.value(name, name);
+    }
 
-    for (const QString &TR : TRvalues)
+    if (!names.contains("Ticker"))
     {
-        if (!TR.startsWith(" class")) continue;
-
-        QStringList TDvalues = TR.split("<td");
-        TDvalues.removeFirst();
+        qDebug() << "The finviz export has no Ticker column";
+        return rows;
+    }
 
-        for (int a = 0; a<TDvalues.count(); a+=2)
-        {
-            if (!TDvalues.at(a).startsWith(" width")) continue;
+    while (position < data.size())
+    {
+        const QStringList fields = readCsvLine(data, &position);
 
-            QString name = TDvalues.at(a);
-            QString value = TDvalues.at(a+1);
+        if (fields.count() < names.count()) continue;       // empty or cut line
 
-            int startName = name.indexOf("delay", 0);
-            startName = name.indexOf(">", startName);
-            int endName = name.indexOf("</td>");
+        sONLINEDATA table;
 
-            name = name.mid(startName+1, endName-(startName+1));
+        for (int col = 0; col < names.count(); ++col)
+        {
+            const QString &name = names.at(col);
+            const QString value = fields.at(col).trimmed();
 
-            if (value.contains("<span"))
+            if (name == "Ticker")
             {
-                int startValue = value.indexOf("<span", 0);
-                startValue = value.indexOf(">", startValue);
-                int endValue = value.indexOf("</span>", startValue);
-
-                value = value.mid(startValue+1, endValue-(startValue+1));
+                table.info.ticker = value;
             }
-            else if (value.contains("<small>"))
+            else if (name == "Company")
             {
-                int startValue = value.indexOf("<small>", 0);
-                int endValue = value.indexOf("</small>", startValue);
-
-                value = value.mid(startValue+7, endValue-(startValue+7));
+                table.info.stockName = value;
             }
-            else if (value.contains("<b>"))
+            else if (name == "Sector")
             {
-                int startValue = value.indexOf("<b>", 0);
-                int endValue = value.indexOf("</b>", startValue);
-
-                value = value.mid(startValue+3, endValue-(startValue+3));
+                table.info.sector = value;
+            }
+            else if (name == "Industry")
+            {
+                table.info.industry = value;
+            }
+            else if (name == "Country")
+            {
+                table.info.country = value;
+            }
+            else if (name != "No.")
+            {
+                // The quote page shows the missing values as "-"
+                table.row.insert(name, value.isEmpty() ? "-" : (MILLIONS.contains(name) ? formatMillions(value) : value));
             }
-
-            table.row.insert(name, value);
         }
-    }
-
-    return table;
 
-}
-
-sONLINEDATA Screener::yahooParse(QString data)
-{
-    sONLINEDATA table;
-
-    int startB = data.indexOf("<body");
-    int endB = data.indexOf("</body");
-    QString body = data.mid(startB, endB-startB);
-
-    int lastEndT = body.lastIndexOf("</table");
-
-    int startT = 0, endT = 0;
-
-    do
-    {
-        startT = body.indexOf("<table", startT+1);
-
-        int startTB = body.indexOf("<tbody", startT);
-        startTB = body.indexOf(">", startTB);
-
-        int endTB = body.indexOf("</tbody>", startTB);
-
-        QStringList TRvalues = body.mid(startTB, endTB-startTB).split("<tr");
-
-        for (const QString &TR : TRvalues)
+        if (!table.info.ticker.isEmpty())
         {
-            if(!TR.startsWith(" class")) continue;
-
-            QString name;
-            QString value;
-
-            int TD = TR.indexOf("<td");
-            TD = TR.indexOf(">", TD);
-            TD = TR.indexOf("<span", TD);
-            TD = TR.indexOf(">", TD);
-            name = TR.mid(TD+1, TR.indexOf("</span>", TD)-TD-1);
-
-            TD = TR.indexOf("<td", TD);
-            TD = TR.indexOf(">", TD);
-            TD = TR.indexOf("<span", TD);
-            TD = TR.indexOf(">", TD);
-            value = TR.mid(TD+1, TR.indexOf("</span>", TD)-TD-1);
-
-            table.row.insert(name, value);
+            rows.push_back(table);
         }
+    }
 
-        endT = body.indexOf("</table>", endT+1);
-
-    }while(endT != lastEndT);
-
-    return table;
+    return rows;
 }
 
 QDataStream &operator<<(QDataStream &out, const sSCREENER &param)
@@ -11,8 +11,18 @@ class Screener : public QObject
 public:
     explicit Screener(QObject *parent = nullptr);
 
-    sONLINEDATA yahooParse(QString data);
-    sONLINEDATA finvizParse(QString data);
+    /**
+     * @brief yahooParse, finvizParse - parse the downloaded page, no member is used, so the call is thread safe
+     * The raw reply is scanned once by the plan of the page template, only the extracted texts are decoded
+     */
+    static sONLINEDATA yahooParse(const QByteArray &data);
+    static sONLINEDATA finvizParse(const QByteArray &data);
+
+    /**
+     * @brief finvizExportParse - parse the CSV of the finviz screener export (export.ashx), one row per ticker
+     * The columns are renamed to the names of the quote page, so the rows fit the enabled screener params
+     */
+    static QVector<sONLINEDATA> finvizExportParse(const QByteArray &data);
 
     QVector<sSCREENER> getAllScreenerData() const;
     void setAllScreenerData(const QVector<sSCREENER> &value);
@@ -25,6 +25,8 @@ SettingsForm::SettingsForm(sSETTINGS set, QWidget *parent) :
     ui->lePosY->setText(QString::number(setting.yPos));
 
     ui->cbSoldPositions->setChecked(setting.showSoldPositions);
+    ui->cmCostBasis->setCurrentIndex(static_cast<int>(setting.costBasisMethod));
+    ui->leExclusionRules->setText(setting.exclusionRules.join(", "));
 
     ui->leDegiroCSV->setText(setting.degiroCSV);
     ui->cmDegiroCSV->setCurrentIndex(setting.degiroCSVdelimeter);
@@ -195,3 +197,29 @@ void SettingsForm::on_cbSoldPositions_clicked(bool checked)
     emit setSetting(setting);
     emit fillOverview();
 }
+
+void SettingsForm::on_cmCostBasis_currentIndexChanged(int index)
+{
+    setting.costBasisMethod = static_cast<eCOSTBASIS>(index);
+    emit setSetting(setting);
+    emit fillOverview();
+}
+
+void SettingsForm::on_leExclusionRules_editingFinished()
+{
+    QStringList rules;
+
+    for (const QString &rule : ui->leExclusionRules->text().split(',', Qt::SkipEmptyParts))
+    {
+        if (!rule.trimmed().isEmpty())
+        {
+            rules << rule.trimmed();
+        }
+    }
+
+    if (rules == setting.exclusionRules) return;
+
+    setting.exclusionRules = rules;
+    emit setSetting(setting);
+    emit fillOverview();
+}
@@ -44,6 +44,10 @@ private slots:
 
     void on_cbSoldPositions_clicked(bool checked);
 
+    void on_cmCostBasis_currentIndexChanged(int index);
+
+    void on_leExclusionRules_editingFinished();
+
 signals:
     void setSetting(sSETTINGS);
     void setScreenerParams(QVector<sSCREENERPARAM> params);
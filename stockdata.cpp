@@ -1,8 +1,10 @@
 #include "stockdata.h"
 
+#include <algorithm>
 #include <cmath>
 #include <QDebug>
 #include <QDir>
+#include <QFileInfo>
 #include <QStandardPaths>
 #include <QFile>
 #include <QDataStream>
@@ -11,15 +13,16 @@
 #include <QJsonDocument>
 
 
-StockData::StockData(QObject *parent) : QObject(parent)
+StockData::StockData(QObject *parent) : QObject(parent), snapshot(std::make_shared<const StockDataType>()), generation(0)
 {
     loadStockData();
+    loadPriceHistory();
 }
 
 
 int StockData::getTotalCount(const QString &ISIN, const QDate &from, const QDate &to)
 {
-    QVector<sSTOCKDATA> vector = stockData.value(ISIN);
+    const QVector<sSTOCKDATA> vector = getSnapshot()->value(ISIN);
 
     int count = 0.0;
 
@@ -40,9 +43,9 @@ int StockData::getTotalCount(const QString &ISIN, const QDate &from, const QDate
     return count;
 }
 
-double StockData::getTotalPrice(const QString &ISIN, const QDate &from, const QDate &to, const eCURRENCY selectedCurrency, ExchangeRatesFunctions echangeRates)
+double StockData::getTotalPrice(const StockDataType &stockList, const QString &ISIN, const QDate &from, const QDate &to, const sCALCULATIONCONTEXT &context)
 {
-    QVector<sSTOCKDATA> vector = stockData.value(ISIN);
+    const QVector<sSTOCKDATA> vector = stockList.value(ISIN);
 
     double price = 0.0;
 
@@ -52,49 +55,16 @@ double StockData::getTotalPrice(const QString &ISIN, const QDate &from, const QD
 
         if(stock.type == BUY || stock.type == SELL)
         {
-            QString rates;
-            eCURRENCY currencyFrom = stock.currency;
-
-            switch(currencyFrom)
-            {
-                case USD: rates = "USD";
-                    break;
-                case CZK: rates = "CZK";
-                    break;
-                case EUR: rates = "EUR";
-                    break;
-                case GBP: rates = "GBP";
-                    break;
-                case CAD: rates = "CAD";
-                    break;
-            }
-
-            rates += "2";
-
-            switch(selectedCurrency)
-            {
-                case USD: rates += "USD";
-                    break;
-                case CZK: rates += "CZK";
-                    break;
-                case EUR: rates += "EUR";
-                    break;
-                case GBP: rates += "GBP";
-                    break;
-                case CAD: rates += "CAD";
-                    break;
-            }
-
-            price += echangeRates[rates](stock.price) * stock.count;
+            price += context.toSelected(stock.currency, stock.price) * stock.count;
         }
     }
 
     return abs(price);
 }
 
-double StockData::getTotalFee(const QString &ISIN, const QDate &from, const QDate &to, const eCURRENCY selectedCurrency, ExchangeRatesFunctions echangeRates)
+double StockData::getTotalFee(const StockDataType &stockList, const QString &ISIN, const QDate &from, const QDate &to, const sCALCULATIONCONTEXT &context)
 {
-    QVector<sSTOCKDATA> vector = stockData.value(ISIN);
+    const QVector<sSTOCKDATA> vector = stockList.value(ISIN);
 
     double price = 0.0;
 
@@ -104,49 +74,16 @@ double StockData::getTotalFee(const QString &ISIN, const QDate &from, const QDat
 
         if (stock.type == BUY || stock.type == SELL)
         {
-            QString rates;
-            eCURRENCY currencyFrom = stock.currency;
-
-            switch (currencyFrom)
-            {
-                case USD: rates = "USD";
-                    break;
-                case CZK: rates = "CZK";
-                    break;
-                case EUR: rates = "EUR";
-                    break;
-                case GBP: rates = "GBP";
-                    break;
-                case CAD: rates = "CAD";
-                    break;
-            }
-
-            rates += "2";
-
-            switch (selectedCurrency)
-            {
-                case USD: rates += "USD";
-                    break;
-                case CZK: rates += "CZK";
-                    break;
-                case EUR: rates += "EUR";
-                    break;
-                case GBP: rates += "GBP";
-                    break;
-                case CAD: rates += "CAD";
-                    break;
-            }
-
-            price += echangeRates[rates](stock.fee);
+            price += context.toSelected(stock.currency, stock.fee);
         }
     }
 
     return abs(price);
 }
 
-double StockData::getReceivedDividend(const QString &ISIN, const QDate &from, const QDate &to, const eCURRENCY selectedCurrency, ExchangeRatesFunctions echangeRates)
+double StockData::getReceivedDividend(const StockDataType &stockList, const QString &ISIN, const QDate &from, const QDate &to, const sCALCULATIONCONTEXT &context)
 {
-    QVector<sSTOCKDATA> vector = stockData.value(ISIN);
+    const QVector<sSTOCKDATA> vector = stockList.value(ISIN);
 
     double price = 0.0;
 
@@ -156,40 +93,7 @@ double StockData::getReceivedDividend(const QString &ISIN, const QDate &from, co
 
         if(stock.type == DIVIDEND)
         {
-            QString rates;
-            eCURRENCY currencyFrom = stock.currency;
-
-            switch (currencyFrom)
-            {
-                case USD: rates = "USD";
-                    break;
-                case CZK: rates = "CZK";
-                    break;
-                case EUR: rates = "EUR";
-                    break;
-                case GBP: rates = "GBP";
-                    break;
-                case CAD: rates = "CAD";
-                    break;
-            }
-
-            rates += "2";
-
-            switch (selectedCurrency)
-            {
-                case USD: rates += "USD";
-                    break;
-                case CZK: rates += "CZK";
-                    break;
-                case EUR: rates += "EUR";
-                    break;
-                case GBP: rates += "GBP";
-                    break;
-                case CAD: rates += "CAD";
-                    break;
-            }
-
-            price += echangeRates[rates](stock.price) + echangeRates[rates](stock.fee);
+            price += context.toSelected(stock.currency, stock.price) + context.toSelected(stock.currency, stock.fee);
         }
     }
 
@@ -199,11 +103,12 @@ double StockData::getReceivedDividend(const QString &ISIN, const QDate &from, co
 double StockData::getTotalSell(const QDate &from, const QDate &to, double EUR2CZK, double USD2CZK, double GBP2CZK)
 {
     double price = 0.0;
-    QList<QString> keys = stockData.keys();
+    const StockDataSnapshot current = getSnapshot();
+    QList<QString> keys = current->keys();
 
     for (const QString &key : keys)
     {
-        for (const sSTOCKDATA &stock : stockData.value(key))
+        for (const sSTOCKDATA &stock : current->value(key))
         {
             if ( !(stock.dateTime.date() >= from && stock.dateTime.date() <= to) ) continue;
 
@@ -248,7 +153,7 @@ QVector<sPDFEXPORTDATA> StockData::prepareDataToExport(const QDate &from, const
         {
             if ( !(deg.dateTime.date() >= from && deg.dateTime.date() <= to) ) continue;
 
-            if ( deg.stockName.toLower().contains("fundshare") ) continue;
+            if ( deg.flags & EXCLUDEDFLAG ) continue;
 
 
             if(deg.type == SELL)
@@ -351,22 +256,50 @@ QVector<sPDFEXPORTDATA> StockData::prepareDataToExport(const QDate &from, const
 
 void StockData::setStockData(const StockDataType &value)
 {
-    stockData = value;
+    QMutexLocker locker(&writeMutex);
+
+    StockDataType next = value;
+    classifyStockData(next);
+    publish(next);
+
     saveStockData();
 }
 
 StockDataType StockData::getStockData() const
 {
-    return stockData;
+    return *getSnapshot();
+}
+
+StockDataSnapshot StockData::getSnapshot(quint64 *generation) const
+{
+    // The generation is read before the snapshot and increased after it is stored
+    if (generation)
+    {
+        *generation = this->generation.load();
+    }
+
+    return std::atomic_load(&snapshot);
+}
+
+void StockData::publish(const StockDataType &data)
+{
+    std::atomic_store(&snapshot, StockDataSnapshot(std::make_shared<const StockDataType>(data)));
+    ++generation;
 }
 
 bool StockData::updateStockDataVector(QString ISIN, QVector<sSTOCKDATA> vector)
 {
-    auto it = stockData.find(ISIN);
+    QMutexLocker locker(&writeMutex);
+
+    // The next version shares all other ISIN vectors with the current one
+    StockDataType next = *getSnapshot();
+    auto it = next.find(ISIN);
 
-    if (it != stockData.end())
+    if (it != next.end())
     {
-        stockData[ISIN] = vector;
+        it.value() = vector;
+        classifyStockData(next);
+        publish(next);
         saveStockData();
 
         return true;
@@ -377,7 +310,7 @@ bool StockData::updateStockDataVector(QString ISIN, QVector<sSTOCKDATA> vector)
 
 double StockData::getTax(const QString &ticker, const QDateTime &date, const eSTOCKEVENTTYPE &type)
 {
-    QVector<sSTOCKDATA> vector = stockData.value(ticker);
+    const QVector<sSTOCKDATA> vector = getSnapshot()->value(ticker);
 
     for(const sSTOCKDATA &data : vector)
     {
@@ -390,6 +323,75 @@ double StockData::getTax(const QString &ticker, const QDateTime &date, const eST
     return 0.0;
 }
 
+void StockData::setExclusionRules(const QStringList &rules)
+{
+    QStringList lowerRules;
+
+    for (const QString &rule : rules)
+    {
+        lowerRules << rule.trimmed().toLower();
+    }
+
+    QMutexLocker locker(&writeMutex);
+
+    if (lowerRules == exclusionRules) return;
+
+    exclusionRules = lowerRules;
+
+    StockDataType next = *getSnapshot();
+    classifyStockData(next);
+    publish(next);
+}
+
+quint8 StockData::getFlags(const sSTOCKDATA &stock, const QStringList &rules)
+{
+    quint8 flags = 0;
+    const QString name = stock.stockName.toLower();
+
+    if (name.contains("fundshare"))
+    {
+        flags |= MONEYMARKETFLAG | EXCLUDEDFLAG;
+
+        // The broker moves the free cash into the fund and back by the buys and sells
+        if (stock.type == BUY || stock.type == SELL)
+        {
+            flags |= CASHSWEEPFLAG;
+        }
+    }
+
+    for (const QString &rule : rules)
+    {
+        if (rule.isEmpty()) continue;
+
+        if (name.contains(rule) || stock.ISIN.compare(rule, Qt::CaseInsensitive) == 0 || stock.ticker.compare(rule, Qt::CaseInsensitive) == 0)
+        {
+            flags |= EXCLUDEDFLAG;
+            break;
+        }
+    }
+
+    return flags;
+}
+
+void StockData::classifyStockData(StockDataType &data) const
+{
+    for (auto it = data.begin(); it != data.end(); ++it)
+    {
+        // Read through the const reference first, the vector is detached only if some flags change
+        const QVector<sSTOCKDATA> &vector = it.value();
+
+        for (int i = 0; i < vector.count(); ++i)
+        {
+            const quint8 flags = getFlags(vector.at(i), exclusionRules);
+
+            if (flags != vector.at(i).flags)
+            {
+                it.value()[i].flags = flags;
+            }
+        }
+    }
+}
+
 bool StockData::loadStockData()
 {
     QFile qFile(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + STOCKFILE);
@@ -398,9 +400,12 @@ bool StockData::loadStockData()
     {
         if (qFile.open(QIODevice::ReadOnly))
         {
+            StockDataType data;
             QDataStream in(&qFile);
-            in >> stockData;
+            in >> data;
             qFile.close();
+            classifyStockData(data);
+            publish(data);
             return true;
         }
     }
@@ -415,28 +420,227 @@ void StockData::saveStockData()
     if (qFile.open(QIODevice::WriteOnly))
     {
         QDataStream out(&qFile);
-        out << stockData;
+        out << *getSnapshot();
         qFile.close();
     }
 }
 
-QString StockData::getCachedISINParam(const QString &ISIN, const QString &param)
+static const char *const QUOTEFIELDNAMES[QUOTEFIELDCOUNT] = {"Price", "Previous Close", "P/E", "Beta", "Dividend %"};
+
+double StockData::getQuote(const QString &ISIN, const eQUOTEFIELD &field) const
+{
+    QReadLocker locker(&quoteLock);
+
+    auto it = quotes.constFind(ISIN);
+
+    return (it == quotes.cend()) ? std::nan("") : it->fields[field];
+}
+
+double StockData::getPrice(const QString &ISIN) const
+{
+    QReadLocker locker(&quoteLock);
+
+    return getPriceUnlocked(ISIN);
+}
+
+QVector<double> StockData::getQuotes(const QList<QString> &ISINs, const eQUOTEFIELD &field) const
+{
+    QReadLocker locker(&quoteLock);
+
+    QVector<double> values;
+    values.reserve(ISINs.count());
+
+    for (const QString &ISIN : ISINs)
+    {
+        auto it = quotes.constFind(ISIN);
+        values.push_back((it == quotes.cend()) ? std::nan("") : it->fields[field]);
+    }
+
+    return values;
+}
+
+QVector<double> StockData::getPrices(const QList<QString> &ISINs) const
+{
+    QReadLocker locker(&quoteLock);
+
+    QVector<double> values;
+    values.reserve(ISINs.count());
+
+    for (const QString &ISIN : ISINs)
+    {
+        values.push_back(getPriceUnlocked(ISIN));
+    }
+
+    return values;
+}
+
+QStringList StockData::getCountries(const QList<QString> &ISINs) const
 {
-    auto it = std::find_if(cachedStockData.begin(), cachedStockData.end(), [ISIN](QPair<QString, sONLINEDATA> a)
-                           {
-                               return a.first == ISIN;
-                           }
-                           );
+    QReadLocker locker(&quoteLock);
+
+    QStringList countries;
+    countries.reserve(ISINs.count());
 
-    if (it != cachedStockData.end())
+    for (const QString &ISIN : ISINs)
     {
-        if (it->second.row. contains(param))
+        auto it = quotes.constFind(ISIN);
+        countries.push_back((it == quotes.cend()) ? QString() : it->country);
+    }
+
+    return countries;
+}
+
+QVector<QMap<QDate, double>> StockData::getPriceHistory(const QList<QString> &ISINs, const QDate &from, const QDate &to) const
+{
+    QReadLocker locker(&quoteLock);
+
+    QVector<QMap<QDate, double>> history;
+    history.reserve(ISINs.count());
+
+    for (const QString &ISIN : ISINs)
+    {
+        QMap<QDate, double> prices;
+        auto it = priceHistory.constFind(ISIN);
+
+        if (it != priceHistory.cend())
+        {
+            for (auto price = it->lowerBound(from); price != it->cend() && price.key() <= to; ++price)
+            {
+                prices.insert(price.key(), price.value());
+            }
+        }
+
+        history.push_back(prices);
+    }
+
+    return history;
+}
+
+QHash<QString, QMap<QDate, double>> StockData::getPriceHistory() const
+{
+    QReadLocker locker(&quoteLock);
+
+    return priceHistory;
+}
+
+void StockData::recordPrice(const QString &ISIN)
+{
+    QMap<QDate, double> prices;
+
+    {
+        QWriteLocker locker(&quoteLock);
+
+        auto it = quotes.constFind(ISIN);
+
+        if (it == quotes.cend() || std::isnan(it->fields[PRICEQUOTE])) return;
+
+        QMap<QDate, double> &history = priceHistory[ISIN];
+        history.insert(QDate::currentDate(), it->fields[PRICEQUOTE]);
+        prices = history;
+    }
+
+    QString path = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + PRICEHISTORYDIR;
+
+    QDir dir(path);
+
+    if (!dir.exists())
+    {
+        dir.mkpath(".");
+    }
+
+    QFile qFile(path + ISIN + ".bin");
+
+    if (qFile.open(QIODevice::WriteOnly))
+    {
+        QDataStream out(&qFile);
+        out << prices;
+        qFile.close();
+    }
+}
+
+void StockData::loadPriceHistory()
+{
+    QString path = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + PRICEHISTORYDIR;
+
+    QDir dir(path);
+
+    const QStringList files = dir.entryList(QStringList() << "*.bin", QDir::Files);
+
+    QWriteLocker locker(&quoteLock);
+
+    for (const QString &file : files)
+    {
+        QFile qFile(path + file);
+
+        if (qFile.open(QIODevice::ReadOnly))
+        {
+            QMap<QDate, double> prices;
+            QDataStream in(&qFile);
+            in >> prices;
+            qFile.close();
+
+            priceHistory.insert(QFileInfo(file).completeBaseName(), prices);
+        }
+    }
+}
+
+double StockData::getPriceUnlocked(const QString &ISIN) const
+{
+    auto it = quotes.constFind(ISIN);
+
+    if (it == quotes.cend())
+    {
+        return std::nan("");
+    }
+
+    // ToDo the return price might be in EUR or USD or whatever
+    return std::isnan(it->fields[PRICEQUOTE]) ? it->fields[PREVCLOSEQUOTE] : it->fields[PRICEQUOTE];
+}
+
+void StockData::setQuote(const QString &ISIN, const QHash<QString, QString> &row, const QString &country)
+{
+    QWriteLocker locker(&quoteLock);
+
+    sQUOTE quote;
+    quote.country = country;
+
+    for (int field = 0; field < QUOTEFIELDCOUNT; ++field)
+    {
+        quote.fields[field] = std::nan("");
+    }
+
+    for (auto it = row.cbegin(); it != row.cend(); ++it)
+    {
+        int field = 0;
+
+        while (field < QUOTEFIELDCOUNT && it.key() != QLatin1String(QUOTEFIELDNAMES[field]))
+        {
+            field++;
+        }
+
+        if (field < QUOTEFIELDCOUNT)
         {
-            return it->second.row.value(param);
+            quote.fields[field] = parseQuoteNumber(it.value());
         }
     }
 
-    return QString();
+    quotes.insert(ISIN, quote);
+}
+
+double StockData::parseQuoteNumber(const QString &value)
+{
+    QString number = value.trimmed();
+    number.remove(',');
+
+    if (number.endsWith('%'))
+    {
+        number.chop(1);
+    }
+
+    bool ok;
+    const double result = number.toDouble(&ok);
+
+    return ok ? result : std::nan("");
 }
 
 void StockData::loadOnlineStockInfo()
@@ -512,7 +716,7 @@ void StockData::loadOnlineStockInfo()
                 //qDebug() << "Key = " << key << ", Value = " << value.toString();
             }
 
-            cachedStockData.push_back(qMakePair(ISIN, table));
+            setQuote(ISIN, table.row, table.info.country);
             //emit updateStockData(ISIN, table);
         }
     }
@@ -522,18 +726,8 @@ void StockData::saveOnlineStockInfo(const QString &ISIN, const sONLINEDATA &tabl
 {
     if (table.row.isEmpty() || ISIN.isEmpty()) return;
 
-    auto it = std::find_if(cachedStockData.begin(), cachedStockData.end(), [ISIN](QPair<QString, sONLINEDATA> a)
-                           {
-                               return a.first == ISIN;
-                           }
-                           );
-
-    if(it != cachedStockData.end())
-    {
-        cachedStockData.erase(it);
-    }
-
-    cachedStockData.push_back(qMakePair(ISIN, table));
+    setQuote(ISIN, table.row, table.info.country);
+    recordPrice(ISIN);
 
     QJsonObject recordObject;
     recordObject.insert("Sector", table.info.sector);
@@ -618,3 +812,15 @@ QDataStream &operator>>(QDataStream &in, sSTOCKDATA &param)
 
     return in;
 }
+
+bool operator==(const sSTOCKDATA &a, const sSTOCKDATA &b)
+{
+    return a.dateTime == b.dateTime && a.type == b.type && a.ticker == b.ticker && a.ISIN == b.ISIN && a.stockName == b.stockName &&
+           a.currency == b.currency && a.count == b.count && a.price == b.price && a.balance == b.balance && a.fee == b.fee && a.source == b.source &&
+           a.flags == b.flags;
+}
+
+bool operator!=(const sSTOCKDATA &a, const sSTOCKDATA &b)
+{
+    return !(a == b);
+}
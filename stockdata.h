@@ -2,18 +2,38 @@
 #define STOCKDATA_H
 
 #include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+
+#include <atomic>
+#include <memory>
 
 #include "global.h"
 
+typedef std::shared_ptr<const StockDataType>    StockDataSnapshot;
+
 class StockData : public QObject
 {
     Q_OBJECT
 public:
     explicit StockData(QObject *parent = nullptr);
 
+    /**
+     * @brief setStockData - classify the records and publish them as the next snapshot
+     * Untouched ISIN vectors stay shared with the previous snapshot
+     */
     void setStockData(const StockDataType &value);
     StockDataType getStockData() const;
 
+    /**
+     * @brief getSnapshot - current immutable version of the transactions
+     * Lock free for the readers; the snapshot stays valid while it is held, even if a newer one is published
+     * @param generation - if set, the publish generation of the snapshot, a cache can be keyed by it instead of holding the snapshot;
+     * the snapshot is never older than the generation
+     */
+    StockDataSnapshot getSnapshot(quint64 *generation = nullptr) const;
+
     /**
      * @brief updateStockDataVector - set new "vector" for the specified ISIN
      * @param ISIN -
@@ -23,24 +43,90 @@ public:
     bool updateStockDataVector(QString ISIN, QVector<sSTOCKDATA> vector);
 
     double getTax(const QString &ticker, const QDateTime &date, const eSTOCKEVENTTYPE &type);
+
+    /**
+     * @brief setExclusionRules - parts of stock names, ISINs or tickers excluded from the statistics
+     * The records are classified again, only the ISINs with changed flags are touched
+     */
+    void setExclusionRules(const QStringList &rules);
+
+    /**
+     * @brief getFlags - classify the record
+     * @param rules - lower case exclusion rules
+     * @return eRECORDFLAG bits
+     */
+    static quint8 getFlags(const sSTOCKDATA &stock, const QStringList &rules = QStringList());
     void saveStockData();
 
     int getTotalCount(const QString &ISIN, const QDate &from, const QDate &to);
-    double getTotalPrice(const QString &ISIN, const QDate &from, const QDate &to, const eCURRENCY selectedCurrency, ExchangeRatesFunctions echangeRates);
-    double getTotalFee(const QString &ISIN, const QDate &from, const QDate &to, const eCURRENCY selectedCurrency, ExchangeRatesFunctions echangeRates);
-    double getReceivedDividend(const QString &ISIN, const QDate &from, const QDate &to, const eCURRENCY selectedCurrency, ExchangeRatesFunctions echangeRates);
+
+    /**
+     * @brief getTotalPrice, getTotalFee, getReceivedDividend - read the transactions of the snapshot the query works with
+     */
+    static double getTotalPrice(const StockDataType &stockList, const QString &ISIN, const QDate &from, const QDate &to, const sCALCULATIONCONTEXT &context);
+    static double getTotalFee(const StockDataType &stockList, const QString &ISIN, const QDate &from, const QDate &to, const sCALCULATIONCONTEXT &context);
+    static double getReceivedDividend(const StockDataType &stockList, const QString &ISIN, const QDate &from, const QDate &to, const sCALCULATIONCONTEXT &context);
     double getTotalSell(const QDate &from, const QDate &to, double EUR2CZK, double USD2CZK, double GBP2CZK);
 
     void loadOnlineStockInfo();
     void saveOnlineStockInfo(const QString &ISIN, const sONLINEDATA &table);
 
-    QString getCachedISINParam(const QString &ISIN, const QString &param);
+    /**
+     * @brief getQuote - numeric online parameter of the ISIN
+     * @return value in the stock currency, NaN if it is not available
+     */
+    double getQuote(const QString &ISIN, const eQUOTEFIELD &field) const;
+
+    /**
+     * @brief getPrice - online price, the previous close if the price is not available
+     * @return NaN if neither is available
+     */
+    double getPrice(const QString &ISIN) const;
+
+    /**
+     * @brief getQuotes, getPrices - one value per ISIN, in the same order, for the valuation loops
+     */
+    QVector<double> getQuotes(const QList<QString> &ISINs, const eQUOTEFIELD &field) const;
+    QVector<double> getPrices(const QList<QString> &ISINs) const;
+
+    /**
+     * @brief getCountries - country of each ISIN from the cached online info, empty if not known
+     */
+    QStringList getCountries(const QList<QString> &ISINs) const;
+
+    /**
+     * @brief getPriceHistory - online prices recorded by the refreshes within the range, one map per ISIN in the same order
+     * Only the days with a refresh have a price
+     */
+    QVector<QMap<QDate, double>> getPriceHistory(const QList<QString> &ISINs, const QDate &from, const QDate &to) const;
+
+    /**
+     * @brief getPriceHistory - all recorded prices, ISIN, date, price; a shallow copy
+     */
+    QHash<QString, QMap<QDate, double>> getPriceHistory() const;
     QVector<sPDFEXPORTDATA> prepareDataToExport(const QDate &from, const QDate &to, const double &USD2CZK, const double &EUR2CZK, const double &GBP2CZK);
 private:
-    StockDataType stockData;
-    QVector<QPair<QString, sONLINEDATA> > cachedStockData;
+    StockDataSnapshot snapshot;                 // published with std::atomic_store, read with std::atomic_load
+    std::atomic<quint64> generation;            // increased after each publish
+    QMutex writeMutex;                          // serializes the writers only
+    QStringList exclusionRules;                 // lower case
+    QHash<QString, sQUOTE> quotes;              // ISIN, cached online data
+    mutable QReadWriteLock quoteLock;           // the quotes are read from the calculation worker threads
+    QHash<QString, QMap<QDate, double>> priceHistory;  // ISIN, date, last online price of the day; guarded by quoteLock
 
     bool loadStockData();
+    void classifyStockData(StockDataType &data) const;
+    void publish(const StockDataType &data);
+    void setQuote(const QString &ISIN, const QHash<QString, QString> &row, const QString &country);
+    double getPriceUnlocked(const QString &ISIN) const;
+
+    /**
+     * @brief recordPrice - store the current online price as the price of today, one small file per ISIN
+     */
+    void recordPrice(const QString &ISIN);
+    void loadPriceHistory();
+
+    static double parseQuoteNumber(const QString &value);
 
 signals:
     void updateStockData(QString ISIN, sONLINEDATA table);
@@ -49,4 +135,7 @@ signals:
 QDataStream& operator<<(QDataStream& out, const sSTOCKDATA& param);
 QDataStream& operator>>(QDataStream& in, sSTOCKDATA& param);
 
+bool operator==(const sSTOCKDATA &a, const sSTOCKDATA &b);
+bool operator!=(const sSTOCKDATA &a, const sSTOCKDATA &b);
+
 #endif // STOCKDATA_H
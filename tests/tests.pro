@@ -0,0 +1,11 @@
+#-------------------------------------------------
+#
+# Unit tests, run by "make check"
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+        tst_costbasis.pro \
+        tst_screener.pro
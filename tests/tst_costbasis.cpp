@@ -0,0 +1,170 @@
+#include <QtTest>
+
+#include "costbasis.h"
+
+namespace
+{
+    const QString ISIN = "US0000000001";
+
+    sSTOCKDATA getTrade(const QDate &date, const eSTOCKEVENTTYPE &type, const int &count, const double &price)
+    {
+        sSTOCKDATA stock;
+        stock.dateTime = QDateTime(date, QTime(10, 0, 0));
+        stock.type = type;
+        stock.ticker = "TEST";
+        stock.ISIN = ISIN;
+        stock.stockName = "Test Inc.";
+        stock.currency = USD;
+        stock.count = count;
+        stock.price = (type == BUY) ? -price : price;     // the buy price is the cash movement
+        stock.balance = 0.0;
+        stock.fee = 0.0;
+        stock.source = MANUALLY;
+
+        return stock;
+    }
+
+    StockDataType getStockList(const QVector<sSTOCKDATA> &trades)
+    {
+        StockDataType stockList;
+        stockList.insert(ISIN, trades);
+
+        return stockList;
+    }
+}
+
+class TestCostBasis : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void partialSell_data();
+    void partialSell();
+    void sellOutRebuy_data();
+    void sellOutRebuy();
+    void appendAfterRebuild();
+};
+
+void TestCostBasis::partialSell_data()
+{
+    QTest::addColumn<int>("method");
+    QTest::addColumn<double>("realized");
+    QTest::addColumn<double>("openCost");
+
+    // 10 @ 10 and 10 @ 20 bought, 15 @ 30 sold
+    QTest::newRow("FIFO") << int(FIFOMETHOD) << 250.0 << 100.0;
+    QTest::newRow("LIFO") << int(LIFOMETHOD) << 200.0 << 50.0;
+    QTest::newRow("average") << int(AVERAGEMETHOD) << 225.0 << 75.0;
+}
+
+void TestCostBasis::partialSell()
+{
+    QFETCH(int, method);
+    QFETCH(double, realized);
+    QFETCH(double, openCost);
+
+    CostBasis costBasis;
+    costBasis.setMethod(static_cast<eCOSTBASIS>(method));
+    costBasis.update(getStockList({getTrade(QDate(2020, 1, 10), BUY, 10, 10.0),
+                                   getTrade(QDate(2020, 2, 10), BUY, 10, 20.0),
+                                   getTrade(QDate(2020, 3, 10), SELL, 15, 30.0)}));
+
+    const sCOSTBASISSTATE bought = costBasis.getState(ISIN, QDate(2020, 2, 10));
+    QCOMPARE(bought.openCount, 20);
+    QCOMPARE(bought.openCost, 300.0);
+    QCOMPARE(bought.realized, 0.0);
+
+    const sCOSTBASISSTATE sold = costBasis.getState(ISIN, QDate(2020, 12, 31));
+    QCOMPARE(sold.openCount, 5);
+    QCOMPARE(sold.openCost, openCost);
+    QCOMPARE(sold.realized, realized);
+
+    // The range takes the realized gain of its days only, the day of the sell included at both ends
+    QCOMPARE(costBasis.getRealized(ISIN, QDate(2020, 3, 10), QDate(2020, 3, 10)), realized);
+    QCOMPARE(costBasis.getRealized(ISIN, QDate(2020, 1, 1), QDate(2020, 3, 9)), 0.0);
+    QCOMPARE(costBasis.getRealized(ISIN, QDate(2020, 3, 11), QDate(2020, 12, 31)), 0.0);
+    QCOMPARE(costBasis.getRealized(ISIN, QDate(2019, 1, 1), QDate(2020, 12, 31)), realized);
+
+    // No trade before the date, no ISIN
+    QCOMPARE(costBasis.getState(ISIN, QDate(2020, 1, 9)).openCount, 0);
+    QCOMPARE(costBasis.getRealized("XS0000000000", QDate(2019, 1, 1), QDate(2020, 12, 31)), 0.0);
+}
+
+void TestCostBasis::sellOutRebuy_data()
+{
+    QTest::addColumn<int>("method");
+
+    QTest::newRow("FIFO") << int(FIFOMETHOD);
+    QTest::newRow("LIFO") << int(LIFOMETHOD);
+    QTest::newRow("average") << int(AVERAGEMETHOD);
+}
+
+void TestCostBasis::sellOutRebuy()
+{
+    QFETCH(int, method);
+
+    CostBasis costBasis;
+    costBasis.setMethod(static_cast<eCOSTBASIS>(method));
+    costBasis.update(getStockList({getTrade(QDate(2020, 1, 10), BUY, 10, 10.0),
+                                   getTrade(QDate(2020, 2, 10), SELL, 10, 15.0),
+                                   getTrade(QDate(2020, 3, 10), BUY, 5, 20.0),
+                                   getTrade(QDate(2020, 4, 10), SELL, 5, 22.0)}));
+
+    // The sold out position has no cost left, the new buy is not matched with the old lot
+    const sCOSTBASISSTATE soldOut = costBasis.getState(ISIN, QDate(2020, 2, 10));
+    QCOMPARE(soldOut.openCount, 0);
+    QCOMPARE(soldOut.openCost, 0.0);
+    QCOMPARE(soldOut.realized, 50.0);
+
+    const sCOSTBASISSTATE rebought = costBasis.getState(ISIN, QDate(2020, 3, 10));
+    QCOMPARE(rebought.openCount, 5);
+    QCOMPARE(rebought.openCost, 100.0);
+
+    QCOMPARE(costBasis.getRealized(ISIN, QDate(2020, 1, 1), QDate(2020, 2, 29)), 50.0);
+    QCOMPARE(costBasis.getRealized(ISIN, QDate(2020, 3, 1), QDate(2020, 4, 30)), 10.0);
+    QCOMPARE(costBasis.getState(ISIN, QDate(2020, 4, 10)).realized, 60.0);
+    QCOMPARE(costBasis.getState(ISIN, QDate(2020, 4, 10)).openCount, 0);
+}
+
+void TestCostBasis::appendAfterRebuild()
+{
+    QVector<sSTOCKDATA> trades = {getTrade(QDate(2020, 1, 10), BUY, 10, 10.0),
+                                  getTrade(QDate(2020, 2, 10), BUY, 10, 20.0)};
+
+    CostBasis costBasis;
+    costBasis.update(getStockList(trades));
+
+    // Appended sell, the lots of the first update go on
+    trades.push_back(getTrade(QDate(2020, 3, 10), SELL, 15, 30.0));
+    costBasis.update(getStockList(trades));
+    QCOMPARE(costBasis.getState(ISIN, QDate(2020, 3, 10)).realized, 250.0);
+
+    // Back-dated buy, the lots are rebuilt in the date order: 10 @ 5, 10 @ 10, 10 @ 20
+    trades.push_back(getTrade(QDate(2020, 1, 5), BUY, 10, 5.0));
+    costBasis.update(getStockList(trades));
+    QCOMPARE(costBasis.getState(ISIN, QDate(2020, 3, 10)).realized, 350.0);
+    QCOMPARE(costBasis.getState(ISIN, QDate(2020, 3, 10)).openCount, 15);
+
+    // Appended after the rebuild: 5 @ 10 and 10 @ 20 left, 5 sold @ 40
+    trades.push_back(getTrade(QDate(2020, 4, 10), SELL, 5, 40.0));
+    costBasis.update(getStockList(trades));
+    QCOMPARE(costBasis.getRealized(ISIN, QDate(2020, 4, 1), QDate(2020, 4, 30)), 150.0);
+
+    // The same as the lots built at once
+    CostBasis reference;
+    reference.update(getStockList(trades));
+
+    const sCOSTBASISSTATE state = costBasis.getState(ISIN, QDate(2020, 12, 31));
+    const sCOSTBASISSTATE expected = reference.getState(ISIN, QDate(2020, 12, 31));
+
+    QCOMPARE(state.openCount, expected.openCount);
+    QCOMPARE(state.openCost, expected.openCost);
+    QCOMPARE(state.realized, expected.realized);
+    QCOMPARE(state.realized, 500.0);
+    QCOMPARE(state.openCount, 10);
+    QCOMPARE(state.openCost, 200.0);
+}
+
+QTEST_GUILESS_MAIN(TestCostBasis)
+
+#include "tst_costbasis.moc"
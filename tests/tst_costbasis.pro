@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# Unit tests of the cost basis
+#
+#-------------------------------------------------
+
+QT += testlib
+QT -= gui
+
+TARGET = tst_costbasis
+TEMPLATE = app
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
+DEFINES += QT_NO_FOREACH
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        tst_costbasis.cpp \
+        ../costbasis.cpp \
+        ../stockdata.cpp
+
+HEADERS += \
+        ../costbasis.h \
+        ../global.h \
+        ../stockdata.h
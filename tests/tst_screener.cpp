@@ -0,0 +1,224 @@
+#include <QtTest>
+#include <QStandardPaths>
+
+#include "pagetemplate.h"
+#include "screener.h"
+
+namespace
+{
+    // Cut down quote pages, the markup the templates rely on and a few traps around it
+    const QByteArray FINVIZPAGE =
+            "<html><head><title>AAPL</title></head><body>\n"
+            "<table class=\"fullview-title\">\n"
+            "<tr><td>AAPL</td></tr>\n"
+            "<tr><td><b>Apple Inc. &amp; Co</b></td></tr>\n"
+            "<tr><td><a href=\"s\">Technology</a> | <a href=\"i\">Consumer Electronics &amp; Gadgets</a> | <a href=\"c\">USA</a></td></tr>\n"
+            "</table>\n"
+            "<table class=\"snapshot-table2\">\n"
+            "<tr><td width=\"7%\">Ignored</td><td>0</td></tr>\n"
+            "<tr class=\"table-dark-row\"><td width=\"7%\" class=\"snapshot-td2-cp\" title=\"cssbody=[delay]\">P/E</td><td class=\"snapshot-td2\"><b>30.10</b></td>"
+            "<td width=\"7%\" class=\"snapshot-td2-cp\">Employees</td><td class=\"snapshot-td2\">137000</td>"
+            "<td width=\"7%\" class=\"snapshot-td2-cp\">Beta</td><td class=\"snapshot-td2\"><b><span style=\"color:#008800;\">1.25</span></b></td></tr>\n"
+            "<tr class=\"table-light-row\"><td width=\"7%\" class=\"snapshot-td2-cp\">Earnings</td><td class=\"snapshot-td2\"><small>Jul 30 AMC</small></td></tr>\n"
+            "</table>\n"
+            "</body></html>\n";
+
+    const QByteArray YAHOOPAGE =
+            "<html><head><title>Key statistics</title></head><body><div id=\"app\">\n"
+            "<table class=\"W(100%)\"><thead><tr><th><span>Valuation</span></th></tr></thead><tbody>\n"
+            "<tr class=\"Bxz(bb)\"><td class=\"Pos(st)\"><span>Trailing P/E</span><sup>1</sup></td><td class=\"Fw(500)\"><span>30.10</span></td></tr>\n"
+            "<tr class=\"Bxz(bb)\"><td class=\"Pos(st)\"><span>Beta (5Y Monthly)</span></td><td class=\"Fw(500)\"><span>1.25</span></td></tr>\n"
+            "</tbody></table>\n"
+            "<table class=\"W(100%)\"><tbody>\n"
+            "<tr class=\"Bxz(bb)\"><td class=\"Pos(st)\"><span>Forward Annual Dividend Yield</span><sup>4</sup></td><td class=\"Fw(500)\"><span>0.60%</span></td></tr>\n"
+            "</tbody></table>\n"
+            "</div></body></html>\n";
+}
+
+class TestScreener : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void finvizQuotePage();
+    void yahooQuotePage();
+    void pageWithoutLayout();
+    void layoutDetectWindow();
+    void templateErrors();
+
+    void finvizExportColumns();
+    void finvizExportQuotedFields();
+    void finvizExportShortRows();
+    void finvizExportWithoutTicker();
+};
+
+void TestScreener::initTestCase()
+{
+    // No user template from the application data replaces the built-in ones
+    QStandardPaths::setTestMode(true);
+}
+
+void TestScreener::finvizQuotePage()
+{
+    const sONLINEDATA table = Screener::finvizParse(FINVIZPAGE);
+
+    QCOMPARE(table.info.stockName, QString("Apple Inc. & Co"));
+    QCOMPARE(table.info.sector, QString("Technology"));
+    QCOMPARE(table.info.industry, QString("Consumer Electronics & Gadgets"));
+    QCOMPARE(table.info.country, QString("USA"));
+
+    // Each value is taken by the option its own cell matches, the plain cell is not read by the span of the next one
+    QCOMPARE(table.row.value("P/E"), QString("30.10"));
+    QCOMPARE(table.row.value("Employees"), QString("137000"));
+    QCOMPARE(table.row.value("Beta"), QString("1.25"));
+    QCOMPARE(table.row.value("Earnings"), QString("Jul 30 AMC"));
+
+    // The rows without a class are not the snapshot rows
+    QVERIFY(!table.row.contains("Ignored"));
+    QCOMPARE(table.row.count(), 4);
+}
+
+void TestScreener::yahooQuotePage()
+{
+    const sONLINEDATA table = Screener::yahooParse(YAHOOPAGE);
+
+    // All tables of the page, the head rows are not read
+    QCOMPARE(table.row.value("Trailing P/E"), QString("30.10"));
+    QCOMPARE(table.row.value("Beta (5Y Monthly)"), QString("1.25"));
+    QCOMPARE(table.row.value("Forward Annual Dividend Yield"), QString("0.60%"));
+    QCOMPARE(table.row.count(), 3);
+}
+
+void TestScreener::pageWithoutLayout()
+{
+    // The finviz anchor is not in the Yahoo page and there is no body in the other one
+    const sONLINEDATA finviz = Screener::finvizParse(YAHOOPAGE);
+    QVERIFY(finviz.row.isEmpty());
+    QVERIFY(finviz.info.stockName.isEmpty());
+
+    QVERIFY(Screener::yahooParse("<html><head><title>Moved</title></head></html>").row.isEmpty());
+    QVERIFY(Screener::finvizParse(QByteArray()).row.isEmpty());
+}
+
+void TestScreener::layoutDetectWindow()
+{
+    const QByteArray json = "{ \"source\": \"test\", \"version\": 1, \"layouts\": ["
+                            "  { \"name\": \"near\", \"detect\": \"anchor\", \"detectWithin\": 16, \"steps\": ["
+                            "      { \"op\": \"skipPast\", \"text\": \"anchor \" },"
+                            "      { \"op\": \"read\", \"text\": \".\", \"into\": \"stockName\" } ] },"
+                            "  { \"name\": \"fallback\", \"detect\": \"<p>\", \"steps\": ["
+                            "      { \"op\": \"skipPast\", \"text\": \"<p>\" },"
+                            "      { \"op\": \"read\", \"text\": \"</p>\", \"into\": \"sector\" } ] } ] }";
+
+    PageTemplate pageTemplate;
+    QString error;
+
+    QVERIFY2(PageTemplate::compile(json, &pageTemplate, &error), qPrintable(error));
+    QCOMPARE(pageTemplate.getVersion(), 1);
+
+    // The anchor within the window selects the first layout and its steps go on from the anchor
+    const sONLINEDATA near = pageTemplate.extract("<p>Far</p>anchor Near.");
+    QCOMPARE(near.info.stockName, QString("Near"));
+    QVERIFY(near.info.sector.isEmpty());
+
+    // Out of the window the next layout is used
+    const sONLINEDATA far = pageTemplate.extract("<p>Far</p>0123456789anchor Near.");
+    QVERIFY(far.info.stockName.isEmpty());
+    QCOMPARE(far.info.sector, QString("Far"));
+
+    QVERIFY(pageTemplate.extract("nothing to detect").info.sector.isEmpty());
+}
+
+void TestScreener::templateErrors()
+{
+    PageTemplate pageTemplate;
+    QString error;
+
+    QVERIFY(!PageTemplate::compile("{ \"layouts\": [ { \"steps\": [ { \"op\": \"jump\", \"text\": \"<tr\" } ] } ] }", &pageTemplate, &error));
+    QVERIFY(error.contains("jump"));
+
+    QVERIFY(!PageTemplate::compile("{ \"layouts\": [ { \"steps\": [ { \"op\": \"read\", \"text\": \"<\", \"into\": \"price\" } ] } ] }", &pageTemplate, &error));
+    QVERIFY(error.contains("price"));
+
+    QVERIFY(!PageTemplate::compile("{ \"layouts\": [] }", &pageTemplate, &error));
+    QVERIFY(!PageTemplate::compile("not json", &pageTemplate, &error));
+}
+
+void TestScreener::finvizExportColumns()
+{
+    const QByteArray data = "\xEF\xBB\xBF\"No.\",\"Ticker\",\"Company\",\"Sector\",\"Industry\",\"Country\",\"Market Cap\",\"P/E\",\"Dividend Yield\",\"Shares Float\"\n"
+                            "1,AAPL,Apple Inc.,Technology,Consumer Electronics,USA,2000000.5,30.10,0.60%,456.78\n";
+
+    const QVector<sONLINEDATA> rows = Screener::finvizExportParse(data);
+
+    QCOMPARE(rows.count(), 1);
+
+    const sONLINEDATA &row = rows.first();
+
+    // The BOM does not break the first column and the info columns do not go to the row
+    QCOMPARE(row.info.ticker, QString("AAPL"));
+    QCOMPARE(row.info.stockName, QString("Apple Inc."));
+    QCOMPARE(row.info.sector, QString("Technology"));
+    QCOMPARE(row.info.industry, QString("Consumer Electronics"));
+    QCOMPARE(row.info.country, QString("USA"));
+    QVERIFY(!row.row.contains("Ticker"));
+    QVERIFY(!row.row.contains("No."));
+
+    // The export names are renamed to the quote page names, the millions are formatted as on the quote page
+    QCOMPARE(row.row.value("P/E"), QString("30.10"));
+    QCOMPARE(row.row.value("Dividend %"), QString("0.60%"));
+    QVERIFY(!row.row.contains("Dividend Yield"));
+    QCOMPARE(row.row.value("Market Cap"), QString("2000.00B"));
+    QCOMPARE(row.row.value("Shs Float"), QString("456.78M"));
+}
+
+void TestScreener::finvizExportQuotedFields()
+{
+    const QByteArray data = "Ticker,Company,P/E,Earnings Date\r\n"
+                            "BRK-B,\"Berkshire Hathaway, Inc. \"\"B\"\"\",,\"Aug 01 BMO\"\r\n"
+                            "\"KO\",\"The Coca-Cola Company\",25.2,Jul 21 BMO";
+
+    const QVector<sONLINEDATA> rows = Screener::finvizExportParse(data);
+
+    QCOMPARE(rows.count(), 2);
+
+    QCOMPARE(rows.at(0).info.ticker, QString("BRK-B"));
+    QCOMPARE(rows.at(0).info.stockName, QString("Berkshire Hathaway, Inc. \"B\""));
+    QCOMPARE(rows.at(0).row.value("P/E"), QString("-"));
+    QCOMPARE(rows.at(0).row.value("Earnings"), QString("Aug 01 BMO"));
+
+    // The last line without the line end
+    QCOMPARE(rows.at(1).info.ticker, QString("KO"));
+    QCOMPARE(rows.at(1).row.value("P/E"), QString("25.2"));
+    QCOMPARE(rows.at(1).row.value("Earnings"), QString("Jul 21 BMO"));
+}
+
+void TestScreener::finvizExportShortRows()
+{
+    const QByteArray data = "Ticker,Company,P/E\n"
+                            "MSFT,Microsoft Corporation,35.4\n"
+                            "\n"
+                            "IBM,International Business\n"
+                            ",Without ticker,10.0\n"
+                            "T,AT&T Inc.,8.1\n";
+
+    const QVector<sONLINEDATA> rows = Screener::finvizExportParse(data);
+
+    // The empty, cut and tickerless lines are skipped
+    QCOMPARE(rows.count(), 2);
+    QCOMPARE(rows.at(0).info.ticker, QString("MSFT"));
+    QCOMPARE(rows.at(1).info.ticker, QString("T"));
+    QCOMPARE(rows.at(1).row.value("P/E"), QString("8.1"));
+}
+
+void TestScreener::finvizExportWithoutTicker()
+{
+    QVERIFY(Screener::finvizExportParse("Company,P/E\nApple Inc.,30.1\n").isEmpty());
+    QVERIFY(Screener::finvizExportParse(QByteArray()).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestScreener)
+
+#include "tst_screener.moc"
@@ -0,0 +1,35 @@
+#-------------------------------------------------
+#
+# Unit tests of the parsers
+#
+#-------------------------------------------------
+
+QT += testlib
+QT -= gui
+
+TARGET = tst_screener
+TEMPLATE = app
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
+DEFINES += QT_NO_FOREACH
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        tst_screener.cpp \
+        ../htmlscanner.cpp \
+        ../pagetemplate.cpp \
+        ../screener.cpp
+
+HEADERS += \
+        ../global.h \
+        ../htmlscanner.h \
+        ../pagetemplate.h \
+        ../screener.h
+
+RESOURCES += \
+        tests.qrc